@@ -5,6 +5,7 @@
 #              and include the runtime header file.
 
 import os
+import re
 import pathlib
 import subprocess
 import platform
@@ -24,7 +25,34 @@ if platform.system() == 'Darwin':
 else:
   FPCHECKER_LIB       = FPCHECKER_PATH+'/../lib/libfpchecker_cpu.so'
 FPCHECKER_RUNTIME   = FPCHECKER_PATH+'/../src/Runtime_cpu.h'
-LLVM_PASS           = "-Xclang -load -Xclang " + FPCHECKER_LIB + " -include " + FPCHECKER_RUNTIME + ' -g '
+LLVM_PASS           = "-Xclang -load -Xclang " + FPCHECKER_LIB + " -include " + FPCHECKER_RUNTIME + ' '
+
+# LLVM version of the pass (fpc_config.py is created by CMake)
+try:
+  from fpc_config import LLVM_VERSION_MAJOR
+except ImportError:
+  LLVM_VERSION_MAJOR = None
+
+SOURCE_EXTENSIONS   = ('.c', '.cc', '.cpp', '.cxx', '.c++', '.C')
+
+# --------------------------------------------------------------------------- #
+# --- Functions ------------------------------------------------------------- #
+# --------------------------------------------------------------------------- #
+
+# Major version of LLVM, from the build of the pass. Without fpc_config.py
+# (e.g., running from the sources), the compiler is asked once per process.
+def getLLVMVersion(compiler):
+  global LLVM_VERSION_MAJOR
+  if LLVM_VERSION_MAJOR is None:
+    LLVM_VERSION_MAJOR = 0
+    try:
+      out = subprocess.check_output([compiler, '--version'], stderr=subprocess.STDOUT)
+      m = re.search(r'clang version (\d+)', out.decode('utf-8'))
+      if m:
+        LLVM_VERSION_MAJOR = int(m.group(1))
+    except Exception:
+      pass
+  return LLVM_VERSION_MAJOR
 
 # --------------------------------------------------------------------------- #
 # --- Classes --------------------------------------------------------------- #
@@ -77,22 +105,96 @@ class Command:
         return self.parameters[i+1]
     return None
 
+  # The pass only needs line tables to locate the sites, so
+  # -gline-tables-only is added unless the command has its own -g flag
+  # other than -g0 (FPC_DEBUG_INFO=full adds -g). It goes after the command
+  # flags, so it overrides a -g0. Full debug information makes objects
+  # much larger and links slower.
+  def getDebugInfoFlags(self):
+    # The last -g flag wins; -gno-* and -gz only change the debug info
+    debug = [p for p in self.parameters if p.startswith('-g') and
+      not p.startswith(('-gcc', '-gno-', '-gz'))]
+    if len(debug) > 0 and debug[-1] != '-g0':
+      return []
+    if os.environ.get('FPC_DEBUG_INFO', '') == 'full':
+      return ['-g']
+    return ['-gline-tables-only']
+
+  # clang 13 and later use the new pass manager, which only runs the pass
+  # if it is loaded with -fpass-plugin; -Xclang -load registers it with the
+  # legacy pass manager. The pass does not instrument a module twice.
+  def getPassPluginFlags(self):
+    if getLLVMVersion(self.name) >= 13:
+      return ['-fpass-plugin=' + FPCHECKER_LIB]
+    return []
+
+  # FPC_LTO=1 instruments at link time, in the ThinLTO backends, after
+  # the functions of other files are inlined (see prepareForLTO in
+  # src/Instrumentation_cpu.cpp). The compilations only prepare the runtime
+  # (FPC_LTO_PRELINK), and lld loads the pass (clang and lld 13 or later).
+  def isLTOMode(self):
+    return os.environ.get('FPC_LTO', '0') != '0'
+
+  def getLTOFlags(self, link):
+    flags = []
+    if not any(p.startswith('-flto') for p in self.parameters):
+      flags += ['-flto=thin']
+    if link:
+      if not any(p.startswith('-fuse-ld') for p in self.parameters):
+        flags += ['-fuse-ld=lld']
+      flags += ['-Wl,--load-pass-plugin=' + FPCHECKER_LIB]
+    return flags
+
+  def getSourceFiles(self):
+    return [p for p in self.parameters if p.endswith(SOURCE_EXTENSIONS)]
+
+  # FPC_FAST_MATH=<flags> adds compiler flags (e.g., -ffast-math) to the
+  # compilation of the files in FPC_FAST_MATH_FILES, a comma-separated list
+  # of paths or path suffixes (all files if it is not set). fpc-fastmath-diff
+  # uses it to build with fast-math one file at a time.
+  def addFastMathFlags(self):
+    flags = os.environ.get('FPC_FAST_MATH', '').split()
+    if len(flags) == 0 or len(self.getSourceFiles()) == 0:
+      return
+    if 'FPC_FAST_MATH_FILES' in os.environ:
+      files = [f for f in os.environ['FPC_FAST_MATH_FILES'].split(',') if f != '']
+      sources = [os.path.abspath(s) for s in self.getSourceFiles()]
+      if not any(s == os.path.abspath(f) or s.endswith('/' + f) for s in sources for f in files):
+        return
+    self.parameters = self.parameters + flags
+
   def instrumentIR(self):
-    new_cmd = [self.name] + LLVM_PASS.split() + self.parameters
+    new_cmd = [self.name] + LLVM_PASS.split() + self.getPassPluginFlags() + self.parameters + self.getDebugInfoFlags()
     for p in self.parameters:
       if '-fopenmp' in p:
         new_cmd += ['-DFPC_MULTI_THREADED']
+    env = os.environ.copy()
+    if self.isLTOMode():
+      new_cmd += self.getLTOFlags(False)
+      env['FPC_LTO_PRELINK'] = '1'
     try:
       if verbose(): print('Executing:', ' '.join(new_cmd))
-      cmdOutput = subprocess.run(' '.join(new_cmd), shell=True, check=True)
+      cmdOutput = subprocess.run(' '.join(new_cmd), shell=True, check=True, env=env)
     except Exception as e:
       prRed(e)
       raise CompileException(new_cmd) from e
 
+  # The runtime uses a thread to flush traces (FPC_FLUSH_INTERVAL)
+  def linkRuntime(self):
+    new_cmd = [self.name] + self.parameters + ['-pthread']
+    if self.isLTOMode():
+      new_cmd += self.getLTOFlags(True)
+    try:
+      if verbose(): print('Executing:', ' '.join(new_cmd))
+      cmdOutput = subprocess.run(' '.join(new_cmd), shell=True, check=True)
+    except subprocess.CalledProcessError as e:
+      prRed(e)
+
 if __name__ == '__main__':
   compiler_name = os.environ['FPC_COMPILER']
   params = os.environ['FPC_COMPILER_PARAMS']
   cmd = Command(compiler_name, params.split())
+  cmd.addFastMathFlags()
 
   if 'FPC_INSTRUMENT' not in os.environ:
     cmd.executeOriginalCommand()
@@ -100,7 +202,7 @@ if __name__ == '__main__':
 
   # Link command
   if cmd.isLinkCommand():
-    cmd.executeOriginalCommand()
+    cmd.linkRuntime()
   else:
     # Compilation command
     try:
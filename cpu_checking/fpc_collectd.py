@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+
+# Description: Collector daemon for workflows with many short processes
+#              (e.g., task farms). Processes started with
+#              FPC_COLLECTOR=<socket> send the changes of their counters
+#              (deltas) to this daemon over a Unix socket, instead of
+#              writing a trace each. The deltas are merged in memory by
+#              site and program input, and a single trace is written per
+#              campaign: <dir>/fpc_<campaign>.json. Messages are binary
+#              traces (see src/FPC_TraceFormat.h); each one is acknowledged
+#              with one byte once it is merged. Programs are built with
+#              -DFPC_COLLECTD.
+
+import os
+import sys
+import time
+import errno
+import signal
+import socket
+import struct
+import argparse
+import selectors
+from colors import prGreen, prRed
+import fpc_traces
+
+COUNTERS = fpc_traces.COUNTER_FIELDS
+
+class Collector:
+  def __init__(self, fileName):
+    self.fileName = fileName
+    self.sites = {}
+    self.changed = False
+    self.messages = 0
+    # A restarted collector continues the trace of the campaign
+    if os.path.exists(fileName):
+      for r in fpc_traces.loadTrace(fileName):
+        self.merge(r)
+      self.changed = False
+
+  def merge(self, record):
+    key = (record.get('input', ''), record['file'], int(record['line']))
+    if key not in self.sites:
+      self.sites[key] = {'input': key[0], 'file': key[1], 'line': key[2]}
+      for c in COUNTERS:
+        self.sites[key][c] = 0
+    site = self.sites[key]
+    for c in COUNTERS:
+      site[c] += int(record.get(c, 0))
+    self.changed = True
+
+  def write(self):
+    if not self.changed:
+      return
+    fpc_traces.writeJSONTrace(self.fileName + '.tmp', list(self.sites.values()))
+    os.replace(self.fileName + '.tmp', self.fileName)
+    self.changed = False
+
+class Connection:
+  def __init__(self, sock):
+    self.sock = sock
+    self.data = bytearray()
+
+  # Returns the complete messages received so far
+  def messages(self):
+    msgs = []
+    while len(self.data) >= fpc_traces.HEADER_SIZE:
+      size = fpc_traces.traceSize(bytes(self.data[:fpc_traces.HEADER_SIZE]))
+      if len(self.data) < size:
+        break
+      msgs.append(bytes(self.data[:size]))
+      del self.data[:size]
+    return msgs
+
+def defaultSocket():
+  if os.environ.get('FPC_COLLECTOR'):
+    return os.environ['FPC_COLLECTOR']
+  return '/tmp/fpc-collectd-' + str(os.getuid()) + '.sock'
+
+def listen(path):
+  # Remove the socket of a collector that is no longer running
+  if os.path.exists(path):
+    probe = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    try:
+      probe.connect(path)
+      prRed('A collector is already running at ' + path)
+      sys.exit(1)
+    except OSError:
+      os.unlink(path)
+    finally:
+      probe.close()
+
+  server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+  server.bind(path)
+  server.listen(128)
+  server.setblocking(False)
+  return server
+
+def run(server, collector, interval):
+  running = [True]
+  def stop(signum, frame):
+    running[0] = False
+  signal.signal(signal.SIGTERM, stop)
+  signal.signal(signal.SIGINT, stop)
+
+  sel = selectors.DefaultSelector()
+  sel.register(server, selectors.EVENT_READ, None)
+  last = time.time()
+  while running[0]:
+    for key, mask in sel.select(timeout=1.0):
+      if key.data is None:
+        try:
+          sock, addr = server.accept()
+        except OSError:
+          continue
+        sock.setblocking(False)
+        sel.register(sock, selectors.EVENT_READ, Connection(sock))
+        continue
+
+      conn = key.data
+      try:
+        data = conn.sock.recv(1 << 16)
+      except OSError as e:
+        if e.errno in (errno.EAGAIN, errno.EINTR):
+          continue
+        data = b''
+      conn.data.extend(data)
+      try:
+        for msg in conn.messages():
+          for r in fpc_traces.parseBinaryTrace(msg):
+            collector.merge(r)
+          collector.messages += 1
+          conn.sock.sendall(b'1')
+      except (fpc_traces.TraceError, struct.error, ValueError) as e:
+        prRed('Invalid message: ' + str(e))
+        data = b''
+      except OSError:
+        data = b''
+      if not data:
+        sel.unregister(conn.sock)
+        conn.sock.close()
+
+    if time.time() - last >= interval:
+      collector.write()
+      last = time.time()
+
+  collector.write()
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser(description='FPChecker trace collector')
+  parser.add_argument('-s', '--socket', default=defaultSocket(),
+    help='Unix socket (default: FPC_COLLECTOR or /tmp/fpc-collectd-<uid>.sock).')
+  parser.add_argument('-c', '--campaign', default=os.environ.get('FPC_RUN_ID', ''),
+    help='Campaign name (default: FPC_RUN_ID or a timestamp).')
+  parser.add_argument('-o', '--output', default='.fpc_logs',
+    help='Directory of the campaign trace (default: .fpc_logs).')
+  parser.add_argument('-i', '--interval', type=float, default=10.0,
+    help='Seconds between writes of the campaign trace (default: 10).')
+  args = parser.parse_args()
+
+  campaign = args.campaign if args.campaign else time.strftime('%Y%m%d%H%M%S')
+  os.makedirs(args.output, exist_ok=True)
+  fileName = os.path.join(args.output, 'fpc_' + campaign + fpc_traces.JSON_EXTENSION)
+  path = os.path.abspath(args.socket)
+
+  collector = Collector(fileName)
+  server = listen(path)
+  prGreen('#FPCHECKER: Collecting traces of campaign ' + campaign + ' in ' + fileName)
+  print('export FPC_COLLECTOR=' + path)
+  sys.stdout.flush()
+  try:
+    run(server, collector, args.interval)
+  finally:
+    server.close()
+    os.unlink(path)
+  prGreen('#FPCHECKER: Received ' + str(collector.messages) + ' messages')
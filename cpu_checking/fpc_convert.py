@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+
+# Description: Converts FPChecker traces between the JSON format and the
+#              binary format (FPC_TRACE_FORMAT=binary). The output trace is
+#              created next to the input trace with the other extension.
+
+import os
+import argparse
+import sys
+from colors import prGreen, prRed
+import fpc_traces
+
+def getTraceFiles(paths):
+  fileList = []
+  for p in paths:
+    if os.path.isdir(p):
+      for root, dirs, files in os.walk(p):
+        for file in files:
+          if fpc_traces.isTraceFile(file):
+            fileList.append(str(os.path.join(root, file)))
+    else:
+      fileList.append(p)
+  return fileList
+
+def convertTrace(fileName, toBinary, toJSON, remove):
+  binary = fpc_traces.isBinaryTrace(fileName)
+  if (binary and toBinary) or (not binary and toJSON):
+    return False
+
+  records = fpc_traces.loadTrace(fileName)
+  base = os.path.splitext(fileName)[0]
+  if binary:
+    outName = base + fpc_traces.JSON_EXTENSION
+    fpc_traces.writeJSONTrace(outName, records)
+  else:
+    outName = base + fpc_traces.BINARY_EXTENSION
+    fpc_traces.writeBinaryTrace(outName, records)
+
+  prGreen('Converted: ' + fileName + ' -> ' + outName)
+  if remove:
+    os.remove(fileName)
+  return True
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser(description='FPChecker trace converter')
+  group = parser.add_mutually_exclusive_group()
+  group.add_argument('-b', '--binary', action='store_true', help='Only convert JSON traces to binary.')
+  group.add_argument('-j', '--json', action='store_true', help='Only convert binary traces to JSON.')
+  parser.add_argument('-r', '--remove', action='store_true', help='Remove the input traces.')
+  parser.add_argument('paths', nargs='*', default=['.fpc_logs'], help='Trace files or directories (default: .fpc_logs).')
+  args = parser.parse_args()
+
+  converted = 0
+  for f in getTraceFiles(args.paths):
+    try:
+      if convertTrace(f, args.binary, args.json, args.remove):
+        converted += 1
+    except (fpc_traces.TraceError, ValueError, OSError) as e:
+      prRed('Could not convert ' + f + ': ' + str(e))
+      sys.exit(1)
+
+  print('Traces converted:', converted)
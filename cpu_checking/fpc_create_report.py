@@ -1,7 +1,7 @@
 #!/usr/bin/env python3
 
 # Description: This script creates an html report of all the events.
-#              It assumes that event (json) files are created by each 
+#              It assumes that event (json or binary) files are created by each 
 #              MPI process indepdently. 
 
 import os
@@ -12,6 +12,7 @@ from collections import defaultdict
 import shutil 
 from line_highlighting import createHTMLCode
 from colors import prGreen, prCyan, prRed
+import fpc_traces
 
 # -------------------------------------------------------- #
 # Insertion points
@@ -26,10 +27,16 @@ P_UNDERFLOW = '<!-- UNDERFLOW -->'
 P_LATENT_INFINITY_POS = '<!-- LATENT_INFINITY_POS -->'
 P_LATENT_INFINITY_NEG = '<!-- LATENT_INFINITY_NEG -->'
 P_LATENT_UNDERFLOW = '<!-- LATENT_UNDERFLOW -->'
+P_ABSORPTION = '<!-- ABSORPTION -->'
 P_CODE_PATHS = '<!-- CODE_PATHS -->'
 P_FILES_AFFECTED = '<!-- FILES_AFFECTED -->'
 P_LINES_AFFECTED = '<!-- LINES_AFFECTED -->'
 P_REPORT_TITLE = '<!-- REPORT_TITLE -->' 
+P_TOP_OVERHEAD_SITES = '<!-- TOP_OVERHEAD_SITES -->'
+P_OCCURRENCES = '<!-- OCCURRENCES -->'
+
+# Number of sites shown in the top overhead sites table
+TOP_OVERHEAD_SITES = 10
 
 # -------------------------------------------------------- #
 # PATHS
@@ -50,22 +57,84 @@ SOURCE_REPORT_TEMPLATE = ROOT_REPORT_TEMPLATE_DIR+'/source_report_template.html'
 report_title = ""
 events = defaultdict(lambda: defaultdict(list) )
 program_inputs = defaultdict(set)
+# (file, line) -> [executions, cycles]
+site_profile = defaultdict(lambda: [0, 0])
+# (file, line) -> [absorptions, maximum exponent gap]
+site_absorption = defaultdict(lambda: [0, 0])
+# (file, line) -> math function called at the site
+site_function = {}
+# (file, line) -> fast-math flags of the operations with events
+site_fast_math = defaultdict(set)
+# event -> file -> [(line, occurrence)] (FPC_CAPTURE_OCCURRENCES)
+occurrences = defaultdict(lambda: defaultdict(list))
+
+# (file, line) -> exponent ranges (FPC_PROFILE_RANGES)
+site_ranges = {}
+
+# (file, line) -> effect of the reduced-precision emulation (FPC_EMULATE)
+site_emulation = {}
+EMULATION_COUNTERS = ['executions', 'overflows', 'underflows', 'cancellations']
+
+# (file, line) -> errors against the shadow values (FPC_SHADOW)
+site_shadow = {}
+SHADOW_COUNTERS = ['executions', 'inaccurate', 'cancellations']
+
+# (file, line) -> subnormal numbers (FPC_PROFILE_DENORMALS)
+site_denormals = {}
+DENORMAL_COUNTERS = ['operands', 'results', 'assists']
+# (file, line) -> narrowing conversions (fptrunc, fptosi, fptoui)
+site_conversion = {}
+CONVERSION_COUNTERS = ['overflows', 'underflows', 'out_of_range']
+
+# Estimated cycles of a microcode assist for subnormal numbers (x86)
+DENORMAL_ASSIST_CYCLES = 150
+# Events expected to change when subnormals are flushed to zero
+FTZ_EXPECTED_EVENTS = ['underflow', 'latent_underflow']
+
+# Formats that sites may be demoted to: name, significand bits and the
+# exponents of the normal numbers
+DEMOTION_FORMATS = [('FP32', 24, -126, 127), ('BF16', 8, -126, 127)]
+# Binary orders of magnitude kept from the underflow and overflow limits
+RANGE_MARGIN = 8
+# Fraction of the significand that must be left after cancellations
+PRECISION_MARGIN = 0.5
+RANGE_BIN_EXPONENTS = 64
+
+# Events that an operation with a fast-math flag assumes do not happen:
+# event -> (flag, message)
+FAST_MATH_VIOLATIONS = {
+  'nan': ('nnan', 'NaN produced in an nnan-flagged instruction'),
+  'positive_infinity': ('ninf', 'infinity produced in an ninf-flagged instruction'),
+  'negative_infinity': ('ninf', 'infinity produced in an ninf-flagged instruction')
+}
+
+# Names of the events in the traces
+TRACE_EVENT_NAMES = {
+  'infinity_pos': 'positive_infinity',
+  'infinity_neg': 'negative_infinity',
+  'nan': 'nan',
+  'division_zero': 'division_by_zero',
+  'cancellation': 'cancellation',
+  'comparison': 'comparison',
+  'underflow': 'underflow',
+  'latent_infinity_pos': 'latent_positive_infinity',
+  'latent_infinity_neg': 'latent_negative_infinity',
+  'latent_underflow': 'latent_underflow',
+  'absorption': 'absorption'
+}
 
 def getEventFilePaths(p):
   fileList = []
   for root, dirs, files in os.walk(p):
     for file in files:
       fileName = os.path.split(file)[1]
-      if fileName.startswith('fpc_') and fileName.endswith(".json"):
+      if fpc_traces.isTraceFile(fileName):
         f = str(os.path.join(root, file))
         fileList.append(f)
   return fileList
 
 def loadReport(fileName):
-  f = open(fileName,'r')
-  data = json.load(f)
-  f.close()
-  return data
+  return fpc_traces.loadTrace(fileName)
 
 def loadEvents(files):
   for f in files:
@@ -84,7 +153,48 @@ def loadEvents(files):
       latent_positive_infinity = data[i]['latent_infinity_pos']
       latent_negative_infinity = data[i]['latent_infinity_neg']
       latent_underflow    = data[i]['latent_underflow']
-
+      # Not in traces of older versions
+      absorption      = data[i].get('absorption', 0)
+      # Only in traces of profiled runs (FPC_PROFILE_SITES)
+      executions      = data[i].get('executions', 0)
+      cycles          = data[i].get('cycles', 0)
+
+      # Only in sites that call a math function
+      if 'function' in data[i]:
+        site_function[(fileName, line)] = data[i]['function']
+
+      # Only in sites with events in instructions with fast-math flags
+      if 'fast_math' in data[i]:
+        site_fast_math[(fileName, line)].update(data[i]['fast_math'].split(','))
+
+      # Only in traces of runs with FPC_PROFILE_RANGES
+      if 'ranges' in data[i]:
+        mergeRanges((fileName, line), data[i]['ranges'])
+
+      # Only in traces of programs built with FPC_EMULATE
+      if 'emulation' in data[i]:
+        mergeEmulation((fileName, line), data[i]['emulation'])
+
+      # Only in traces of programs built with FPC_SHADOW
+      if 'shadow' in data[i]:
+        mergeShadow((fileName, line), data[i]['shadow'])
+
+      # Only in traces of runs with FPC_PROFILE_DENORMALS
+      if 'denormals' in data[i]:
+        mergeDenormals((fileName, line), data[i]['denormals'])
+
+      # Only in sites of narrowing conversions
+      if 'conversion' in data[i]:
+        mergeConversion((fileName, line), data[i]['conversion'])
+
+      # Only in traces of runs with FPC_CAPTURE_OCCURRENCES
+      for (e, occ) in data[i].get('occurrences', {}).items():
+        for o in occ:
+          occurrences[TRACE_EVENT_NAMES[e]][fileName].append((line, o))
+
+      if executions != int(0):
+        site_profile[(fileName, line)][0] += executions
+        site_profile[(fileName, line)][1] += cycles
       if positive_infinity != int(0):
         events['positive_infinity'][fileName].append((line,positive_infinity))
         program_inputs['positive_infinity'].add(p_input)
@@ -115,6 +225,111 @@ def loadEvents(files):
       if latent_underflow != int(0): 
         events['latent_underflow'][fileName].append((line,latent_underflow))
         program_inputs['latent_underflow'].add(p_input)
+      if absorption != int(0):
+        events['absorption'][fileName].append((line,absorption))
+        program_inputs['absorption'].add(p_input)
+        a = site_absorption[(fileName, line)]
+        a[0] += absorption
+        a[1] = max(a[1], data[i].get('absorption_gap', 0))
+
+# Merges the exponent ranges of a site from several traces
+def mergeRanges(site, r):
+  if site not in site_ranges:
+    site_ranges[site] = {'bits': r['bits'], 'result_exp': None, 'operand_exp': None,
+      'max_cancellation': 0, 'histogram': [0] * len(r['histogram'])}
+  m = site_ranges[site]
+  m['bits'] = max(m['bits'], r['bits'])
+  m['max_cancellation'] = max(m['max_cancellation'], r['max_cancellation'])
+  m['histogram'] = [a + b for (a, b) in zip(m['histogram'], r['histogram'])]
+  for k in ['result_exp', 'operand_exp']:
+    if r[k] is None:
+      continue
+    if m[k] is None:
+      m[k] = list(r[k])
+    else:
+      m[k] = [min(m[k][0], r[k][0]), max(m[k][1], r[k][1])]
+
+def mergeEmulation(site, e):
+  if site not in site_emulation:
+    site_emulation[site] = {'format': e['format'], 'max_relative_error': 0.0}
+    for c in EMULATION_COUNTERS:
+      site_emulation[site][c] = 0
+  m = site_emulation[site]
+  for c in EMULATION_COUNTERS:
+    m[c] += e[c]
+  m['max_relative_error'] = max(m['max_relative_error'], e['max_relative_error'])
+
+def mergeShadow(site, sh):
+  if site not in site_shadow:
+    site_shadow[site] = {'bits': sh['bits'], 'max_error_bits': 0,
+      'max_relative_error': 0.0, 'sum_error': 0.0}
+    for c in SHADOW_COUNTERS:
+      site_shadow[site][c] = 0
+  m = site_shadow[site]
+  for c in SHADOW_COUNTERS:
+    m[c] += sh[c]
+  m['max_error_bits'] = max(m['max_error_bits'], sh['max_error_bits'])
+  m['max_relative_error'] = max(m['max_relative_error'], sh['max_relative_error'])
+  m['sum_error'] += sh['mean_relative_error'] * sh['executions']
+
+def mergeDenormals(site, d):
+  if site not in site_denormals:
+    site_denormals[site] = {'ftz_daz': 0}
+    for c in DENORMAL_COUNTERS:
+      site_denormals[site][c] = 0
+  m = site_denormals[site]
+  for c in DENORMAL_COUNTERS:
+    m[c] += d[c]
+  m['ftz_daz'] = max(m['ftz_daz'], d.get('ftz_daz', 0))
+
+def mergeConversion(site, c):
+  if site not in site_conversion:
+    site_conversion[site] = {'from': c['from'], 'to': c['to']}
+    for n in CONVERSION_COUNTERS:
+      site_conversion[site][n] = 0
+  m = site_conversion[site]
+  for n in CONVERSION_COUNTERS:
+    m[n] += c[n]
+
+# Event counts per site of the traces in a directory: (file, line) -> event -> count
+def loadSiteEvents(p):
+  sites = defaultdict(lambda: defaultdict(int))
+  for f in getEventFilePaths(p):
+    for r in loadReport(f):
+      for e in TRACE_EVENT_NAMES.keys():
+        sites[(r['file'], int(r['line']))][e] += int(r.get(e, 0))
+  return sites
+
+# Returns True if the exponents and cancellations of a site fit in a format
+def fitsFormat(r, fmt):
+  (name, bits, emin, emax) = fmt
+  for k in ['result_exp', 'operand_exp']:
+    if r[k] is not None and (r[k][0] < emin + RANGE_MARGIN or r[k][1] > emax - RANGE_MARGIN):
+      return False
+  return r['max_cancellation'] <= bits * (1.0 - PRECISION_MARGIN)
+
+# Percentage of the results of a site in the histogram bins within the
+# normal range of a format
+def resultsInRange(r, fmt):
+  (name, bits, emin, emax) = fmt
+  total = sum(r['histogram'])
+  if total == 0:
+    return 100.0
+  n = 0
+  for i in range(len(r['histogram'])):
+    low = i * RANGE_BIN_EXPONENTS - 1023
+    high = low + RANGE_BIN_EXPONENTS - 1
+    if low >= emin - 1 and high <= emax + 1:
+      n += r['histogram'][i]
+  return 100.0 * n / total
+
+def getSourceLine(fileName, line):
+  try:
+    with open(fileName, 'r') as fd:
+      lines = fd.readlines()
+    return lines[int(line)-1].strip()
+  except (OSError, IndexError, UnicodeDecodeError):
+    return ''
 
 def getEvents(event_type):
   n = 0
@@ -123,6 +338,14 @@ def getEvents(event_type):
       n += int(l[1])
   return n
 
+# Returns the sites with the most cycles spent in checks
+def getTopOverheadSites(n):
+  sites = sorted(site_profile.items(), key=lambda s: s[1][1], reverse=True)
+  return sites[:n]
+
+def getTotalCycles():
+  return sum([p[1] for p in site_profile.values()])
+
 def getCodePaths():
   files = set([])
   for e in events:
@@ -149,6 +372,17 @@ def getLinesAffected():
 #------------------------- Text Reports ---------------------------------------
 #------------------------------------------------------------------------------
 
+# Sites with events that their fast-math flags assume do not happen; the
+# compiler may have optimized these operations incorrectly
+def getFastMathViolations():
+  violations = set()
+  for event_name, (flag, message) in FAST_MATH_VIOLATIONS.items():
+    for file_name in events[event_name]:
+      for t in events[event_name][file_name]:
+        if flag in site_fast_math.get((file_name, t[0]), set()):
+          violations.add(((file_name, t[0]), message))
+  return sorted(violations)
+
 def createRootReport_Text():
   print('\n')
   print('{:=^50}'.format(' Main Report '))
@@ -162,6 +396,160 @@ def createRootReport_Text():
   print('{:<30}'.format('latent_positive_infinity'), getEvents('latent_positive_infinity'))
   print('{:<30}'.format('latent_negative_infinity'), getEvents('latent_negative_infinity'))
   print('{:<30}'.format('latent_underflow'), getEvents('latent_underflow'))
+  print('{:<30}'.format('absorption'), getEvents('absorption'))
+
+  violations = getFastMathViolations()
+  if len(violations) != 0:
+    print('\n')
+    print('{:=^50}'.format(' Fast-Math Violations '))
+    for (site, message) in violations:
+      print(site[0]+':'+str(site[1]), message)
+
+  if len(site_profile) != 0:
+    print('\n')
+    print('{:=^50}'.format(' Top Overhead Sites '))
+    total = getTotalCycles()
+    for (site, p) in getTopOverheadSites(TOP_OVERHEAD_SITES):
+      percent = 100.0 * p[1] / total if total != 0 else 0.0
+      print(site[0]+':'+str(site[1]), 'executions:', p[0], 'cycles:', p[1], '({:.1f}%)'.format(percent))
+
+def createEmulationReport_Text():
+  print('\n')
+  print('{:=^50}'.format(' Emulated Sites '))
+  for site in sorted(site_emulation.keys()):
+    e = site_emulation[site]
+    print(site[0]+':'+str(site[1]), 'format:', e['format'], 'executions:', e['executions'],
+      'new_overflows:', e['overflows'], 'new_underflows:', e['underflows'],
+      'new_cancellations:', e['cancellations'],
+      'max_relative_error: {:.3g}'.format(e['max_relative_error']))
+
+# Sites ordered by the bits in error, measured against the shadow values
+def createShadowReport_Text():
+  print('\n')
+  print('{:=^50}'.format(' Shadow Errors '))
+  sites = sorted(site_shadow.keys(), key=lambda s: (-site_shadow[s]['max_error_bits'], s))
+  for site in sites:
+    sh = site_shadow[site]
+    mean = sh['sum_error'] / sh['executions'] if sh['executions'] > 0 else 0.0
+    print(site[0]+':'+str(site[1]), 'bits:', sh['bits'], 'executions:', sh['executions'],
+      'max_error_bits:', sh['max_error_bits'], 'inaccurate:', sh['inaccurate'],
+      'cancellations:', sh['cancellations'],
+      'max_relative_error: {:.3g}'.format(sh['max_relative_error']),
+      'mean_relative_error: {:.3g}'.format(mean))
+
+# Accumulations that lose addends need compensated summation; they cannot
+# be demoted, since a lower precision absorbs more
+def createAbsorptionReport_Text():
+  print('\n')
+  print('{:=^50}'.format(' Absorption '))
+  for site in sorted(site_absorption.keys(), key=lambda s: (-site_absorption[s][0], s)):
+    (n, gap) = site_absorption[site]
+    executions = site_profile[site][0] if site in site_profile else 0
+    percent = ' ({:.1f}% of executions)'.format(100.0 * n / executions) if executions != 0 else ''
+    print(site[0]+':'+str(site[1]), 'absorptions:', str(n)+percent, 'max_gap:', gap,
+      'suggestion: compensated summation')
+    source = getSourceLine(site[0], site[1])
+    if source != '':
+      print('    ' + source)
+
+# Conversions that lose the value: overflows and underflows of fptrunc, and
+# values out of the range of the integer type (undefined results)
+def createConversionReport_Text():
+  print('\n')
+  print('{:=^50}'.format(' Narrowing Conversions '))
+  for site in sorted(site_conversion.keys()):
+    c = site_conversion[site]
+    print(site[0]+':'+str(site[1]), c['from']+' -> '+c['to'], 'overflows:', c['overflows'],
+      'underflows:', c['underflows'], 'out_of_range:', c['out_of_range'])
+    source = getSourceLine(site[0], site[1])
+    if source != '':
+      print('    ' + source)
+
+def createPrecisionReport_Text():
+  if len(site_conversion) != 0:
+    createConversionReport_Text()
+  if len(site_emulation) != 0:
+    createEmulationReport_Text()
+  if len(site_shadow) != 0:
+    createShadowReport_Text()
+  if len(site_absorption) != 0:
+    createAbsorptionReport_Text()
+
+  print('\n')
+  print('{:=^50}'.format(' Precision Advisor '))
+  if len(site_ranges) == 0:
+    print('No exponent ranges (run with FPC_PROFILE_RANGES=1)')
+    return
+
+  fits = defaultdict(list)
+  for site in sorted(site_ranges.keys()):
+    r = site_ranges[site]
+    formats = [f for f in DEMOTION_FORMATS if f[1] < (24 if r['bits'] == 32 else 53)]
+    candidates = [f[0] for f in formats if fitsFormat(r, f) and site not in site_absorption]
+    for c in candidates:
+      fits[c].append(site)
+    print(site[0]+':'+str(site[1]), 'bits:', r['bits'], 'result_exp:', r['result_exp'],
+      'operand_exp:', r['operand_exp'], 'max_cancellation:', r['max_cancellation'],
+      'in_fp32_range: {:.1f}%'.format(resultsInRange(r, DEMOTION_FORMATS[0])),
+      'fits:', ','.join(candidates) if len(candidates) > 0 else '-')
+    source = getSourceLine(site[0], site[1])
+    if source != '':
+      print('    ' + source)
+
+  print('')
+  for f in DEMOTION_FORMATS:
+    print('Sites that fit in ' + f[0] + ':', len(fits[f[0]]), 'of', len(site_ranges))
+
+# Sites ordered by the estimated assists for subnormal numbers
+def createDenormalReport_Text():
+  print('\n')
+  print('{:=^50}'.format(' Denormal Performance Hotspots '))
+  sites = [s for s in site_denormals.keys()
+    if site_denormals[s]['operands'] + site_denormals[s]['results'] > 0]
+  if len(sites) == 0:
+    print('No subnormal numbers (run with FPC_PROFILE_DENORMALS=1)')
+    return
+
+  total = 0
+  for site in sorted(sites, key=lambda s: (-site_denormals[s]['assists'], s)):
+    d = site_denormals[site]
+    executions = site_profile[site][0] if site in site_profile else 0
+    percent = 100.0 * d['assists'] / executions if executions != 0 else 0.0
+    cycles = d['assists'] * DENORMAL_ASSIST_CYCLES
+    total += cycles
+    print(site[0]+':'+str(site[1]), 'assists:', d['assists'], '({:.1f}% of executions)'.format(percent),
+      'subnormal_operands:', d['operands'], 'subnormal_results:', d['results'],
+      'estimated_cycles:', cycles, *(['(FTZ/DAZ)'] if d['ftz_daz'] else []))
+    source = getSourceLine(site[0], site[1])
+    if source != '':
+      print('    ' + source)
+  print('')
+  print('Estimated cycles in assists:', total, '({} cycles per assist)'.format(DENORMAL_ASSIST_CYCLES))
+
+# Compares the events of a run (reports_path) with a run with FPC_FTZ_DAZ=1
+def createFTZReport_Text(reports_path, ftz_path):
+  print('\n')
+  print('{:=^50}'.format(' FTZ/DAZ Comparison '))
+  base = loadSiteEvents(reports_path)
+  ftz = loadSiteEvents(ftz_path)
+  changed = set()
+  for site in sorted(set(base.keys()) | set(ftz.keys())):
+    for e in TRACE_EVENT_NAMES.keys():
+      before = base[site][e] if site in base else 0
+      after = ftz[site][e] if site in ftz else 0
+      if before == after:
+        continue
+      expected = e in FTZ_EXPECTED_EVENTS
+      if not expected:
+        changed.add(site)
+      print(site[0]+':'+str(site[1]), TRACE_EVENT_NAMES[e]+':', before, '->', after,
+        *(['(expected)'] if expected else []))
+
+  print('')
+  if len(changed) == 0:
+    prGreen('FTZ/DAZ only changes underflows: flushing subnormals to zero looks safe for these runs')
+  else:
+    prRed('FTZ/DAZ changes the events of ' + str(len(changed)) + ' sites')
 
 def createEventReport_Text(event_name):
   report_name = (' '.join(event_name.split('_'))).title()
@@ -170,7 +558,15 @@ def createEventReport_Text(event_name):
   for file_name in events[event_name]:
     for t in events[event_name][file_name]:
       line = t[0]
-      locations.add(file_name+':'+str(line))
+      location = file_name+':'+str(line)
+      if (file_name, line) in site_function:
+        location += ' (' + site_function[(file_name, line)] + ')'
+      if (file_name, line) in site_fast_math:
+        location += ' [' + ','.join(sorted(site_fast_math[(file_name, line)])) + ']'
+        if event_name in FAST_MATH_VIOLATIONS and \
+           FAST_MATH_VIOLATIONS[event_name][0] in site_fast_math[(file_name, line)]:
+          location += ': ' + FAST_MATH_VIOLATIONS[event_name][1]
+      locations.add(location)
   for l in locations:
     print(l)
 
@@ -271,6 +667,13 @@ def createRootReport():
         createEventReport('latent_underflow')
       else: fd.write(str(e)+'\n')
 
+    elif P_ABSORPTION in templateLines[i]:
+      e = getEvents('absorption')
+      if e != 0:
+        fd.write('<a href="./absorption/absorption.html">'+str(e)+'</a>\n')
+        createEventReport('absorption')
+      else: fd.write(str(e)+'\n')
+
     elif P_CODE_PATHS in templateLines[i]:
       fd.write(getCodePaths()+'\n')
 
@@ -282,6 +685,9 @@ def createRootReport():
     
     elif P_REPORT_TITLE in templateLines[i]:
       fd.write(report_title+'\n')
+
+    elif P_TOP_OVERHEAD_SITES in templateLines[i]:
+      writeTopOverheadSites(fd)
      
     else:
         fd.write(templateLines[i])
@@ -290,6 +696,21 @@ def createRootReport():
 
   prGreen('Report created: ' + report_full_name)
 
+def writeTopOverheadSites(fd):
+  if len(site_profile) == 0:
+    fd.write('<tr><td class="td_class" colspan="4">No profiling data (run with FPC_PROFILE_SITES=1)</td></tr>\n')
+    return
+
+  total = getTotalCycles()
+  for (site, p) in getTopOverheadSites(TOP_OVERHEAD_SITES):
+    percent = 100.0 * p[1] / total if total != 0 else 0.0
+    fd.write('<tr>\n')
+    fd.write('<td class="td_class">'+site[0]+':'+str(site[1])+'</td>\n')
+    fd.write('<td class="td_class">'+str(p[0])+'</td>\n')
+    fd.write('<td class="td_class">'+str(p[1])+'</td>\n')
+    fd.write('<td class="td_class">'+'{:.1f}'.format(percent)+'</td>\n')
+    fd.write('</tr>\n')
+
 def createEventReport(event_name):
   report_name = (' '.join(event_name.split('_'))).title()
   
@@ -329,6 +750,23 @@ def createEventReport(event_name):
       fd.write(templateLines[i])
   fd.close()
 
+def writeOccurrences(fd, event_name, file_full_path):
+  occ = occurrences[event_name][file_full_path]
+  if len(occ) == 0:
+    fd.write('<tr><td class="files_class" colspan="7">No occurrences (run with FPC_CAPTURE_OCCURRENCES=K)</td></tr>\n')
+    return
+
+  for (line, o) in sorted(occ, key=lambda x: (int(x[0]), x[1]['rank'], x[1]['time_ns'])):
+    fd.write('<tr>\n')
+    fd.write('<td class="files_class">'+str(line)+'</td>\n')
+    fd.write('<td class="files_class">'+o['result']+'</td>\n')
+    fd.write('<td class="files_class">'+', '.join(o['operands'])+'</td>\n')
+    fd.write('<td class="files_class">'+str(o['bits'])+'</td>\n')
+    fd.write('<td class="files_class">'+str(o['thread'])+'</td>\n')
+    fd.write('<td class="files_class">'+(str(o['rank']) if o['rank'] >= 0 else '-')+'</td>\n')
+    fd.write('<td class="files_class">'+str(o['time_ns'])+'</td>\n')
+    fd.write('</tr>\n')
+
 def createCodeReport(event_name, file_full_path, id):
   report_name = (' '.join(event_name.split('_'))).title()
   
@@ -354,6 +792,8 @@ def createCodeReport(event_name, file_full_path, id):
       htmlCode = createHTMLCode(file_full_path, highligth_set)
       for l in htmlCode:
         fd.write(l+'\n')
+    elif P_OCCURRENCES in templateLines[i]:
+      writeOccurrences(fd, event_name, file_full_path)
     elif P_REPORT_TITLE in templateLines[i]:
       fd.write(report_title+'\n')
     else:
@@ -381,7 +821,8 @@ def removeReportDir():
 #  "underflow": 0,
 #  "latent_infinity_pos": 0,
 #  "latent_infinity_neg": 0,
-#  "latent_underflow": 0
+#  "latent_underflow": 0,
+#  "absorption": 0
 #  }
 #]
 def executeQuery(fileName):
@@ -395,24 +836,24 @@ def executeQuery(fileName):
   for root, dirs, files in os.walk(current_path):
     for file in files:
       fname = os.path.split(file)[1]
-      if fname.startswith('fpc_') and fname.endswith(".json"):
+      if fpc_traces.isTraceFile(fname):
         f = str(os.path.join(root, file))
-        with open(f, 'r') as trace_file:
-          trace_data = json.load(trace_file)
-          for i in trace_data:
-            if i["file"].endswith(data[0]["file"]):
-                if (data[0]['infinity_pos'] <= i['infinity_pos'] and
-                    data[0]['infinity_neg'] <= i['infinity_neg'] and
-                    data[0]['nan'] <= i['nan'] and
-                    data[0]['division_zero'] <= i['division_zero'] and
-                    data[0]['cancellation'] <= i['cancellation'] and
-                    data[0]['comparison'] <= i['comparison'] and
-                    data[0]['underflow'] <= i['underflow'] and
-                    data[0]['latent_infinity_pos'] <= i['latent_infinity_pos'] and
-                    data[0]['latent_infinity_neg'] <= i['latent_infinity_neg'] and
-                    data[0]['latent_underflow'] <= i['latent_underflow']
-                    ): 
-                  print('Trace:', f)
+        trace_data = fpc_traces.loadTrace(f)
+        for i in trace_data:
+          if i["file"].endswith(data[0]["file"]):
+              if (data[0]['infinity_pos'] <= i['infinity_pos'] and
+                  data[0]['infinity_neg'] <= i['infinity_neg'] and
+                  data[0]['nan'] <= i['nan'] and
+                  data[0]['division_zero'] <= i['division_zero'] and
+                  data[0]['cancellation'] <= i['cancellation'] and
+                  data[0]['comparison'] <= i['comparison'] and
+                  data[0]['underflow'] <= i['underflow'] and
+                  data[0]['latent_infinity_pos'] <= i['latent_infinity_pos'] and
+                  data[0]['latent_infinity_neg'] <= i['latent_infinity_neg'] and
+                  data[0]['latent_underflow'] <= i['latent_underflow'] and
+                  data[0].get('absorption', 0) <= i.get('absorption', 0)
+                  ): 
+                print('Trace:', f)
 
 def removeTraces():
   p = './'
@@ -433,6 +874,9 @@ if __name__ == '__main__':
   parser.add_argument('-t', '--title', nargs=1, type=str, help='Title of report.')
   parser.add_argument('-q', '--query', nargs=1, type=str, action='store', help='Query file.')
   parser.add_argument('-s', '--show', action='store', nargs='?', default=0, type=str, help='Show report on screen.')
+  parser.add_argument('-p', '--precision', action='store_true', help='Show the sites that fit in FP32 or BF16 (traces of FPC_PROFILE_RANGES=1) the effect of FPC_EMULATE, the errors measured with FPC_SHADOW, the absorptions and the narrowing conversions that lost values.')
+  parser.add_argument('-d', '--denormals', action='store_true', help='Show the denormal performance hotspots (traces of FPC_PROFILE_DENORMALS=1).')
+  parser.add_argument('--ftz', nargs=1, type=str, help='With -d, compare the events with the traces in this directory (a run with FPC_FTZ_DAZ=1).')
   parser.add_argument('dir', nargs='?', default=os.getcwd())
   args = parser.parse_args()
 
@@ -449,6 +893,24 @@ if __name__ == '__main__':
       createEventReport_Text(event_name)
     exit()
 
+  if (args.precision):
+    reports_path = args.dir
+    fileList = getEventFilePaths(reports_path)
+    print('Trace files found:', len(fileList))
+    loadEvents(fileList)
+    createPrecisionReport_Text()
+    exit()
+
+  if (args.denormals):
+    reports_path = args.dir
+    fileList = getEventFilePaths(reports_path)
+    print('Trace files found:', len(fileList))
+    loadEvents(fileList)
+    createDenormalReport_Text()
+    if (args.ftz):
+      createFTZReport_Text(reports_path, args.ftz[0])
+    exit()
+
   if (args.query):
     fileName = args.query[0]
     executeQuery(fileName)
@@ -0,0 +1,285 @@
+#!/usr/bin/env python3
+
+# Description: Fast-math safety advisor. The program is built and run once
+#              strict and once per source file with fast-math flags added to
+#              that file only (FPC_FAST_MATH and FPC_FAST_MATH_FILES, see
+#              clang_fpchecker.py). The per-site event counters and first
+#              occurrences of every run are compared with the strict run, and
+#              the files whose runs show no new events and the same event
+#              profile are ranked as safe for fast-math. Builds and runs are
+#              done in parallel, each one in its own copy of the source
+#              directory.
+
+import os
+import sys
+import json
+import time
+import queue
+import shutil
+import argparse
+import tempfile
+import subprocess
+from concurrent.futures import ThreadPoolExecutor
+from colors import prGreen, prCyan, prRed
+import fpc_traces
+
+TRACES_DIR = '.fpc_logs'
+IGNORED_FILES = shutil.ignore_patterns(TRACES_DIR, 'fpc-report', '.fpc_fastmath*')
+SOURCE_EXTENSIONS = ('.c', '.cc', '.cpp', '.cxx', '.c++', '.C')
+
+# Event counters of the traces (executions and cycles are not events)
+EVENTS = fpc_traces.EVENT_FIELDS
+
+# The runtime options that change the traces are not inherited: sampling
+# skips checks, and staging or collecting moves the traces elsewhere
+RUNTIME_OPTIONS = ['FPC_OVERHEAD_BUDGET', 'FPC_TRACE_FORMAT', 'FPC_STAGE_DIR',
+  'FPC_LOCAL_DIR', 'FPC_COLLECTOR', 'FPC_FAST_MATH', 'FPC_FAST_MATH_FILES']
+
+# Verdicts, from the safest
+SAFE = 'safe'
+CHANGED = 'changed'
+NEW_EVENTS = 'new events'
+FAILED = 'failed'
+VERDICTS = [SAFE, CHANGED, NEW_EVENTS, FAILED]
+
+class RunResult:
+  def __init__(self, ok, seconds=0.0, sites=None, first=None):
+    self.ok = ok
+    self.seconds = seconds
+    self.sites = sites if sites is not None else {}   # (file, line) -> {event: count}
+    self.first = first if first is not None else {}   # (file, line, event) -> (result, operands)
+
+def findTraceFiles(d):
+  fileList = []
+  for root, dirs, files in os.walk(d):
+    if os.path.basename(root) != TRACES_DIR:
+      continue
+    fileList += [os.path.join(root, f) for f in files if fpc_traces.isTraceFile(f)]
+  return fileList
+
+# Locations are made relative to the copy of the source directory, so that
+# the runs of different copies can be compared
+def relativeFile(fileName, d):
+  if fileName.startswith(d + os.sep):
+    return os.path.relpath(fileName, d)
+  return fileName
+
+def loadRun(d, seconds):
+  sites = {}
+  first = {}
+  for f in findTraceFiles(d):
+    for r in fpc_traces.loadTrace(f):
+      key = (relativeFile(r['file'], d), int(r['line']))
+      counters = sites.setdefault(key, dict.fromkeys(EVENTS, 0))
+      for e in EVENTS:
+        counters[e] += int(r.get(e, 0))
+      # Only in traces of runs with FPC_CAPTURE_OCCURRENCES
+      for (e, occ) in r.get('occurrences', {}).items():
+        if len(occ) > 0 and key + (e,) not in first:
+          first[key + (e,)] = (occ[0]['result'], tuple(occ[0]['operands']))
+  return RunResult(True, seconds, sites, first)
+
+class Advisor:
+  def __init__(self, args):
+    self.args = args
+    self.workdirs = queue.Queue()
+    self.root = tempfile.mkdtemp(prefix='.fpc_fastmath_', dir=args.work_dir)
+    for i in range(args.jobs):
+      d = os.path.join(self.root, 'worker_' + str(i))
+      shutil.copytree(args.source, d, symlinks=True, ignore=IGNORED_FILES)
+      self.workdirs.put(d)
+
+  def cleanup(self):
+    shutil.rmtree(self.root, ignore_errors=True)
+
+  # Builds the program with fast-math in the given files (none: strict
+  # build), runs it and loads its traces
+  def run(self, files):
+    env = os.environ.copy()
+    for o in RUNTIME_OPTIONS:
+      env.pop(o, None)
+    env['FPC_INSTRUMENT'] = '1'
+    if self.args.occurrences > 0:
+      env['FPC_CAPTURE_OCCURRENCES'] = str(self.args.occurrences)
+    if len(files) > 0:
+      env['FPC_FAST_MATH'] = self.args.flags
+      env['FPC_FAST_MATH_FILES'] = ','.join(files)
+
+    d = self.workdirs.get()
+    try:
+      for f in findTraceFiles(d):
+        os.remove(f)
+      build = subprocess.run(self.args.build, shell=True, cwd=d, env=env,
+        stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+      if build.returncode != 0:
+        return RunResult(False)
+      start = time.perf_counter()
+      try:
+        run = subprocess.run(self.args.run, shell=True, cwd=d, env=env,
+          stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, timeout=self.args.timeout)
+        if run.returncode != 0:
+          return RunResult(False)
+      except subprocess.TimeoutExpired:
+        return RunResult(False)
+      return loadRun(d, time.perf_counter() - start)
+    finally:
+      self.workdirs.put(d)
+
+  def evaluate(self, configs):
+    with ThreadPoolExecutor(max_workers=self.args.jobs) as pool:
+      return list(pool.map(self.run, configs))
+
+  def same(self, a, b):
+    return abs(a - b) <= self.args.tolerance * max(a, b)
+
+  # Differences of a run with the strict run as (kind, file, line, event,
+  # strict value, value). Kinds: "new" (the event did not happen at the
+  # site), "lost" (it does not happen anymore), "count" and "first"
+  # (another first occurrence).
+  def diff(self, strict, other):
+    differences = []
+    zeros = dict.fromkeys(EVENTS, 0)
+    for key in sorted(set(strict.sites.keys()) | set(other.sites.keys())):
+      s = strict.sites.get(key, zeros)
+      o = other.sites.get(key, zeros)
+      for e in EVENTS:
+        if s[e] == 0 and o[e] > 0:
+          differences.append(('new',) + key + (e, s[e], o[e]))
+        elif s[e] > 0 and o[e] == 0:
+          differences.append(('lost',) + key + (e, s[e], o[e]))
+        elif not self.same(s[e], o[e]):
+          differences.append(('count',) + key + (e, s[e], o[e]))
+    for key in sorted(set(strict.first.keys()) & set(other.first.keys())):
+      if strict.first[key] != other.first[key]:
+        differences.append(('first',) + key + (describe(strict.first[key]), describe(other.first[key])))
+    return differences
+
+def describe(occurrence):
+  (result, operands) = occurrence
+  return result + ' = op(' + ', '.join(operands) + ')'
+
+def verdict(result, differences):
+  if not result.ok:
+    return FAILED
+  if any(d[0] == 'new' for d in differences):
+    return NEW_EVENTS
+  if len(differences) > 0:
+    return CHANGED
+  return SAFE
+
+def findSourceFiles(source):
+  files = []
+  for root, dirs, names in os.walk(source):
+    dirs[:] = sorted([d for d in dirs if not d.startswith('.')])
+    for n in sorted(names):
+      if n.endswith(SOURCE_EXTENSIONS):
+        files.append(os.path.relpath(os.path.join(root, n), source))
+  return files
+
+def readFiles(args):
+  files = []
+  if args.files:
+    files += [f for f in args.files.split(',') if f != '']
+  if args.files_file:
+    with open(args.files_file, 'r') as fd:
+      files += [l.strip() for l in fd if l.strip() != '' and not l.startswith('#')]
+  if len(files) == 0:
+    files = findSourceFiles(args.source)
+  return list(dict.fromkeys(files))
+
+def printDifferences(differences, limit):
+  for d in differences[:limit]:
+    (kind, fileName, line, event, s, o) = d
+    print('      {}:{} {} ({}): {} -> {}'.format(fileName, line, event, kind, s, o))
+  if len(differences) > limit:
+    print('      ... {} more'.format(len(differences) - limit))
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser(description='Finds the source files where fast-math does not change the floating-point events')
+  parser.add_argument('-b', '--build', required=True,
+    help='Build command; it must rebuild the program with clang++-fpchecker (e.g., "make clean all").')
+  parser.add_argument('-r', '--run', required=True,
+    help='Run command, with the same input in every run; a non-zero exit code is a failure.')
+  parser.add_argument('-m', '--flags', default='-ffast-math',
+    help='Fast-math flags added to one file at a time (default: -ffast-math).')
+  parser.add_argument('-f', '--files',
+    help='Comma-separated source files to try, relative to the source directory (default: all C/C++ files).')
+  parser.add_argument('-F', '--files-file',
+    help='File with the source files to try, one per line.')
+  parser.add_argument('-k', '--occurrences', type=int, default=1,
+    help='Occurrences captured per site and event (FPC_CAPTURE_OCCURRENCES); the first one is compared; 0 disables it (default: 1).')
+  parser.add_argument('--tolerance', type=float, default=0.0,
+    help='Relative difference of event counts ignored, for programs with non-deterministic counts (default: 0).')
+  parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(),
+    help='Builds and runs in parallel (default: number of cores).')
+  parser.add_argument('-s', '--source', default='.',
+    help='Source directory, copied for each job (default: current directory).')
+  parser.add_argument('-w', '--work-dir', default='.',
+    help='Directory for the copies of the source directory (default: current directory).')
+  parser.add_argument('--timeout', type=float, default=None,
+    help='Seconds before a run is considered failed.')
+  parser.add_argument('-o', '--output',
+    help='Write the result to this JSON file.')
+  args = parser.parse_args()
+
+  args.jobs = max(1, args.jobs if args.jobs else 1)
+  args.source = os.path.abspath(args.source)
+  args.work_dir = os.path.abspath(args.work_dir)
+  files = readFiles(args)
+  if len(files) == 0:
+    prRed('No source files (use -f or -F)')
+    sys.exit(1)
+
+  advisor = Advisor(args)
+  try:
+    prCyan('Strict run and {} runs with {}...'.format(len(files), args.flags))
+    results = advisor.evaluate([[]] + [[f] for f in files])
+    strict = results[0]
+    if not strict.ok:
+      prRed('The strict build or run fails: ' + args.build + '; ' + args.run)
+      sys.exit(1)
+
+    report = []
+    for (f, r) in zip(files, results[1:]):
+      differences = advisor.diff(strict, r) if r.ok else []
+      report.append({'file': f, 'verdict': verdict(r, differences),
+        'seconds': r.seconds, 'differences': differences})
+
+    # Safe files, fastest first, then the others by verdict and differences
+    report.sort(key=lambda x: (VERDICTS.index(x['verdict']),
+      x['seconds'] if x['verdict'] == SAFE else len(x['differences'])))
+    safe = [x['file'] for x in report if x['verdict'] == SAFE]
+
+    # Fast-math in all the safe files at once
+    combined = None
+    if len(safe) > 1:
+      prCyan('Run with {} in the {} safe files...'.format(args.flags, len(safe)))
+      r = advisor.evaluate([safe])[0]
+      differences = advisor.diff(strict, r) if r.ok else []
+      combined = {'verdict': verdict(r, differences), 'seconds': r.seconds,
+        'differences': differences}
+  finally:
+    advisor.cleanup()
+
+  print('\n{:<6}{:<40}{:<14}{:>10}{:>8}{:>8}'.format('Rank', 'File', 'Verdict', 'Time (s)', 'New', 'Other'))
+  for (i, x) in enumerate(report):
+    new = len([d for d in x['differences'] if d[0] == 'new'])
+    print('{:<6}{:<40}{:<14}{:>10.3f}{:>8}{:>8}'.format(i + 1, x['file'], x['verdict'],
+      x['seconds'], new, len(x['differences']) - new))
+    printDifferences(x['differences'], 3)
+  print('Strict run: {:.3f} s (instrumented runs; times include the checks)'.format(strict.seconds))
+
+  prGreen('#FPCHECKER: Fast-math is safe in: ' + (', '.join(safe) if safe else '-'))
+  if combined is not None:
+    if combined['verdict'] == SAFE:
+      prGreen('#FPCHECKER: All safe files together: safe ({:.3f} s)'.format(combined['seconds']))
+    else:
+      prRed('#FPCHECKER: All safe files together: ' + combined['verdict'])
+      printDifferences(combined['differences'], 3)
+
+  if args.output:
+    with open(args.output, 'w') as fd:
+      json.dump({'flags': args.flags, 'strict_seconds': strict.seconds,
+        'files': [dict(x, differences=[list(d) for d in x['differences']]) for x in report],
+        'safe': safe, 'combined': combined}, fd, indent=2)
+      fd.write('\n')
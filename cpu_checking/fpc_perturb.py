@@ -0,0 +1,258 @@
+#!/usr/bin/env python3
+
+# Description: Finds the sites whose results depend on the rounding, and so
+#              on the order of the operations, in the style of Verrou and
+#              CESTAC. The program is built with FPC_PERTURB=1, which rounds
+#              the result of each operation up or down at random (see
+#              _FPC_PERTURB_FP64_ in src/Runtime_cpu.h), and it is run once
+#              with the rounding to nearest and several times with random
+#              rounding and different seeds. For each site, the sum of its
+#              results and its last result (e.g., the result of a reduction)
+#              are compared over the runs (number of significant digits), as
+#              well as its executions and events. The sites that lose
+#              digits, change their control flow or have other events are
+#              order-sensitive; reductions made of the other sites can be
+#              reordered (vectorization, threads, -fassociative-math).
+
+import os
+import sys
+import json
+import math
+import shutil
+import argparse
+import tempfile
+import subprocess
+from concurrent.futures import ThreadPoolExecutor
+from colors import prGreen, prCyan, prRed
+import fpc_traces
+
+# Event counters of the traces (executions and cycles are not events)
+EVENTS = fpc_traces.EVENT_FIELDS
+
+# The runtime options that change the traces or their location are not
+# inherited (see fpc-fastmath-diff)
+RUNTIME_OPTIONS = ['FPC_OVERHEAD_BUDGET', 'FPC_TRACE_FORMAT', 'FPC_STAGE_DIR',
+  'FPC_LOCAL_DIR', 'FPC_COLLECTOR', 'FPC_PERTURB_MODE', 'FPC_PERTURB_SEED']
+
+class Site:
+  def __init__(self, bits):
+    self.bits = bits
+    self.executions = 0
+    self.perturbed = 0
+    self.sum = 0.0            # None if a process saved a sum that is not finite
+    self.last = 0.0           # last result of the last process (None: not finite)
+    self.events = dict.fromkeys(EVENTS, 0)
+
+# Loads the traces of a run: (file, line) -> Site. The traces of several
+# processes are added.
+def loadRun(d):
+  sites = {}
+  for root, dirs, files in os.walk(d):
+    for f in files:
+      if not fpc_traces.isTraceFile(f):
+        continue
+      for r in fpc_traces.loadTrace(os.path.join(root, f)):
+        key = (r['file'], int(r['line']))
+        p = r.get('perturbation', None)
+        if key not in sites:
+          sites[key] = Site(p['bits'] if p is not None else 0)
+        site = sites[key]
+        for e in EVENTS:
+          site.events[e] += int(r.get(e, 0))
+        if p is None:
+          continue
+        site.bits = p['bits']
+        site.executions += p['executions']
+        site.perturbed += p['perturbed']
+        site.sum = None if (site.sum is None or p['sum'] is None) else site.sum + p['sum']
+        site.last = p['last']
+  return sites
+
+# Significant decimal digits that the values share: log10(|mean| / stddev),
+# from 0 to the digits of the format
+def significantDigits(values, bits):
+  precision = bits * math.log10(2.0)
+  if any(v is None for v in values):
+    return 0.0
+  if len(set(values)) == 1:
+    return precision
+  n = len(values)
+  mean = sum(values) / n
+  std = math.sqrt(sum((v - mean) ** 2 for v in values) / (n - 1)) if n > 1 else 0.0
+  if std == 0.0:
+    return precision
+  if mean == 0.0:
+    return 0.0
+  return max(0.0, min(precision, math.log10(abs(mean) / std)))
+
+class Perturbation:
+  def __init__(self, args):
+    self.args = args
+    self.root = tempfile.mkdtemp(prefix='.fpc_perturb_', dir=args.work_dir)
+
+  def cleanup(self):
+    shutil.rmtree(self.root, ignore_errors=True)
+
+  def environment(self):
+    env = os.environ.copy()
+    for o in RUNTIME_OPTIONS:
+      env.pop(o, None)
+    return env
+
+  def build(self):
+    env = self.environment()
+    env['FPC_INSTRUMENT'] = '1'
+    env['FPC_PERTURB'] = '1'
+    build = subprocess.run(self.args.build, shell=True, cwd=self.args.source, env=env,
+      stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    return build.returncode == 0
+
+  # Runs the program with a rounding mode and a seed; the traces are
+  # written to a directory of the run (FPC_STAGE_DIR). Returns the sites,
+  # or None if the run fails.
+  def run(self, config):
+    (i, mode, seed) = config
+    d = os.path.join(self.root, 'run_' + str(i))
+    os.makedirs(d)
+    env = self.environment()
+    env['FPC_STAGE_DIR'] = d
+    env['FPC_PERTURB_MODE'] = mode
+    env['FPC_PERTURB_SEED'] = str(seed)
+    try:
+      run = subprocess.run(self.args.run, shell=True, cwd=self.args.source, env=env,
+        stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, timeout=self.args.timeout)
+      if run.returncode != 0:
+        return None
+    except subprocess.TimeoutExpired:
+      return None
+    return loadRun(d)
+
+  def evaluate(self):
+    configs = [(0, 'off', 0)]
+    configs += [(i + 1, self.args.mode, self.args.seed + i) for i in range(self.args.runs)]
+    with ThreadPoolExecutor(max_workers=self.args.jobs) as pool:
+      results = list(pool.map(self.run, configs))
+    return (results[0], results[1:])
+
+  # Compares the sites over the runs
+  def analyze(self, reference, runs):
+    sites = []
+    keys = set(reference.keys())
+    for r in runs:
+      keys |= set(r.keys())
+    for key in sorted(keys):
+      present = [r[key] for r in runs if key in r]
+      bits = max([s.bits for s in present] + [0])
+      reasons = []
+
+      digits = None
+      lost = 0.0
+      perturbed = [s for s in present if s.bits > 0]
+      if len(perturbed) > 0:
+        digits = min(significantDigits([s.sum for s in perturbed], bits),
+                     significantDigits([s.last for s in perturbed], bits))
+        lost = bits * math.log10(2.0) - digits
+        if lost >= self.args.lost:
+          reasons.append('lost digits')
+
+      executions = set([s.executions for s in present])
+      if key in reference:
+        executions.add(reference[key].executions)
+      if len(present) < len(runs) or len(executions) > 1:
+        reasons.append('control flow')
+
+      new_events = []
+      changed_events = []
+      for e in EVENTS:
+        base = reference[key].events[e] if key in reference else 0
+        counts = [r[key].events[e] if key in r else 0 for r in runs]
+        if base == 0 and max(counts) > 0:
+          new_events.append(e)
+        elif any(c != base for c in counts):
+          changed_events.append(e)
+      if len(new_events) > 0:
+        reasons.append('new events')
+      if len(changed_events) > 0:
+        reasons.append('changed events')
+
+      sites.append({'file': key[0], 'line': key[1], 'bits': bits,
+        'digits': digits, 'lost_digits': lost,
+        'executions': max(executions) if len(executions) > 0 else 0,
+        'perturbed': max([s.perturbed for s in present] + [0]),
+        'new_events': new_events, 'changed_events': changed_events,
+        'reasons': reasons})
+
+    # Order-sensitive sites first, the most digits lost first
+    sites.sort(key=lambda s: (len(s['reasons']) == 0, -s['lost_digits'], s['file'], s['line']))
+    return sites
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser(description='Finds the sites whose results are sensitive to the rounding and the order of the operations')
+  parser.add_argument('-b', '--build',
+    help='Build command; it must rebuild the program with clang++-fpchecker (e.g., "make clean all"). '
+    'Without it, the program must be built with FPC_PERTURB=1.')
+  parser.add_argument('-r', '--run', required=True,
+    help='Run command, with the same input in every run.')
+  parser.add_argument('-n', '--runs', type=int, default=8,
+    help='Runs with random rounding (default: 8).')
+  parser.add_argument('-m', '--mode', default='random', choices=['random', 'average'],
+    help='random: rounding up or down with probability 1/2 (CESTAC); average: stochastic rounding (default: random).')
+  parser.add_argument('--seed', type=int, default=1,
+    help='Seed of the first run; run i uses seed + i (default: 1).')
+  parser.add_argument('-l', '--lost', type=float, default=3.0,
+    help='Decimal digits lost before a site is order-sensitive (default: 3).')
+  parser.add_argument('-j', '--jobs', type=int, default=1,
+    help='Runs in parallel, in the same directory (default: 1).')
+  parser.add_argument('-s', '--source', default='.',
+    help='Directory where the commands run (default: current directory).')
+  parser.add_argument('-w', '--work-dir', default='.',
+    help='Directory for the traces of the runs (default: current directory).')
+  parser.add_argument('--timeout', type=float, default=None,
+    help='Seconds before a run is considered failed.')
+  parser.add_argument('-o', '--output',
+    help='Write the result to this JSON file.')
+  args = parser.parse_args()
+
+  if args.runs < 2:
+    prRed('At least 2 runs are needed')
+    sys.exit(1)
+  args.jobs = max(1, args.jobs)
+  args.source = os.path.abspath(args.source)
+  args.work_dir = os.path.abspath(args.work_dir)
+
+  perturbation = Perturbation(args)
+  try:
+    if args.build:
+      prCyan('Building with FPC_PERTURB=1...')
+      if not perturbation.build():
+        prRed('The build fails: ' + args.build)
+        sys.exit(1)
+    prCyan('Reference run and {} runs with {} rounding...'.format(args.runs, args.mode))
+    (reference, runs) = perturbation.evaluate()
+  finally:
+    perturbation.cleanup()
+  if reference is None or any(r is None for r in runs):
+    prRed('The program fails: ' + args.run)
+    sys.exit(1)
+  if not any(s.bits > 0 for r in runs for s in r.values()):
+    prRed('No perturbed sites; build the program with FPC_PERTURB=1')
+    sys.exit(1)
+
+  sites = perturbation.analyze(reference, runs)
+  sensitive = [s for s in sites if len(s['reasons']) > 0]
+  print('\n{:<50}{:>8}{:>8}{:>12}  {}'.format('Site', 'Digits', 'Lost', 'Executions', 'Reasons'))
+  for s in sensitive:
+    digits = '-' if s['digits'] is None else '{:.1f}'.format(s['digits'])
+    reasons = ', '.join(s['reasons'])
+    if len(s['new_events']) > 0:
+      reasons += ' (' + ', '.join(s['new_events']) + ')'
+    print('{:<50}{:>8}{:>8.1f}{:>12}  {}'.format(s['file'] + ':' + str(s['line']), digits,
+      s['lost_digits'], s['executions'], reasons))
+
+  prGreen('#FPCHECKER: Order-sensitive sites: {} of {}'.format(len(sensitive), len(sites)))
+  if args.output:
+    with open(args.output, 'w') as fd:
+      json.dump({'mode': args.mode, 'runs': args.runs, 'lost_digits': args.lost,
+        'sites': sites, 'sensitive': [s['file'] + ':' + str(s['line']) for s in sensitive]},
+        fd, indent=2)
+      fd.write('\n')
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+
+# Description: Runs a program (or a job launcher, e.g., srun or mpirun) with
+#              node-local trace staging. Processes write their traces to
+#              node-local storage (FPC_LOCAL_DIR) and the last process of
+#              each node merges them into a single trace per node in the
+#              shared directory (see src/Runtime_cpu.h). When the command
+#              finishes, the traces left on this node by processes that did
+#              not finish (e.g., they crashed) are merged and staged too.
+#              Programs are built with -DFPC_STAGING.
+
+import os
+import sys
+import time
+import fcntl
+import shutil
+import socket
+import argparse
+import subprocess
+from colors import prGreen, prRed
+import fpc_traces
+
+# Job IDs of common schedulers
+JOB_ID_VARIABLES = ['SLURM_JOB_ID', 'LSB_JOBID', 'PBS_JOBID', 'FLUX_JOB_ID']
+
+def getRunID(runID):
+  if runID:
+    return runID
+  if os.environ.get('FPC_RUN_ID'):
+    return os.environ['FPC_RUN_ID']
+  for v in JOB_ID_VARIABLES:
+    if os.environ.get(v):
+      return os.environ[v].split('.')[0]
+  return time.strftime('%Y%m%d%H%M%S') + '-' + str(os.getpid())
+
+def stageTraces(runDir, destDir, runID):
+  if not os.path.isdir(runDir):
+    return 0
+
+  # Processes of the run on this node take this lock to stage the traces
+  with open(os.path.join(runDir, '.processes'), 'a+') as lock:
+    fcntl.flock(lock, fcntl.LOCK_EX)
+    files = [os.path.join(runDir, f) for f in sorted(os.listdir(runDir))
+      if fpc_traces.isTraceFile(f) and fpc_traces.isBinaryTrace(f)]
+    fileName = os.path.join(destDir, 'fpc_' + runID + '_' + socket.gethostname() +
+      fpc_traces.JSON_EXTENSION)
+
+    # The last process of the node already staged the traces
+    staged = os.path.exists(fileName) and all(
+      os.path.getmtime(f) <= os.path.getmtime(fileName) for f in files)
+    traces = []
+    for f in ([] if staged else files):
+      try:
+        traces.append(fpc_traces.readBinaryTrace(f))
+      except (fpc_traces.TraceError, OSError) as e:
+        prRed('Could not read ' + f + ': ' + str(e))
+
+    if len(traces) > 0:
+      os.makedirs(destDir, exist_ok=True)
+      fpc_traces.writeJSONTrace(fileName + '.tmp', fpc_traces.mergeTraces(traces))
+      os.replace(fileName + '.tmp', fileName)
+      prGreen('#FPCHECKER: Staged ' + str(len(traces)) + ' traces to ' + fileName)
+  shutil.rmtree(runDir, ignore_errors=True)
+  return len(traces)
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser(description='Runs a program with node-local trace staging')
+  parser.add_argument('-l', '--local-dir', default=os.environ.get('FPC_LOCAL_DIR', '/tmp'),
+    help='Node-local directory for the traces (default: FPC_LOCAL_DIR or /tmp).')
+  parser.add_argument('-d', '--dest', default=os.environ.get('FPC_STAGE_DIR', '.fpc_logs'),
+    help='Shared directory for the node traces (default: .fpc_logs).')
+  parser.add_argument('-i', '--run-id',
+    help='Run ID (default: FPC_RUN_ID, the job ID, or a timestamp).')
+  parser.add_argument('-k', '--keep', action='store_true',
+    help='Do not stage the traces left on this node.')
+  parser.add_argument('command', nargs=argparse.REMAINDER, help='Command to run.')
+  args = parser.parse_args()
+
+  command = args.command
+  if len(command) > 0 and command[0] == '--':
+    command = command[1:]
+  if len(command) == 0:
+    parser.print_usage()
+    sys.exit(1)
+
+  runID = getRunID(args.run_id)
+  dest = os.path.abspath(args.dest)
+  env = os.environ.copy()
+  env['FPC_RUN_ID'] = runID
+  env['FPC_LOCAL_DIR'] = os.path.abspath(args.local_dir)
+  env['FPC_STAGE_DIR'] = dest
+
+  try:
+    ret = subprocess.call(command, env=env)
+  except OSError as e:
+    prRed('Could not run ' + command[0] + ': ' + str(e))
+    sys.exit(1)
+
+  if not args.keep:
+    stageTraces(os.path.join(env['FPC_LOCAL_DIR'], 'fpc_' + runID), dest, runID)
+  sys.exit(ret)
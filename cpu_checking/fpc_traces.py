@@ -0,0 +1,200 @@
+# Description: Reads and writes FPChecker traces. Traces are either JSON
+#              files (fpc_<node>_<pid>.json) or binary files
+#              (fpc_<node>_<pid>.fpcb, FPC_TRACE_FORMAT=binary). The binary
+#              layout is described in src/FPC_TraceFormat.h.
+
+import json
+import struct
+
+JSON_EXTENSION = '.json'
+BINARY_EXTENSION = '.fpcb'
+
+TRACE_MAGIC = b'FPCTRACE'
+TRACE_VERSION = 2
+# Version 1 traces do not have function, fast_math, extensions and absorption_gap
+READABLE_VERSIONS = [1, 2]
+# magic, version, num_fields, num_string_fields, reserved, num_records,
+# fields_offset, records_offset, strings_offset, strings_size, file_size
+HEADER_FORMAT = '<8sIIIIQQQQQQ'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+
+# Fields of the traces written by the runtime
+STRING_FIELDS = ['input', 'file', 'function', 'fast_math', 'extensions']
+EVENT_FIELDS = ['infinity_pos', 'infinity_neg', 'nan', 'division_zero',
+  'cancellation', 'comparison', 'underflow', 'latent_infinity_pos',
+  'latent_infinity_neg', 'latent_underflow', 'absorption']
+COUNTER_FIELDS = EVENT_FIELDS + ['executions', 'cycles']
+TRACE_FIELDS = STRING_FIELDS + ['line'] + COUNTER_FIELDS + ['absorption_gap']
+
+# Optional members of the JSON traces: written when they are not empty
+# (absorption_gap, when there are absorptions)
+OPTIONAL_FIELDS = ['function', 'fast_math']
+
+class TraceError(Exception):
+  pass
+
+def isTraceFile(fileName):
+  return fileName.startswith('fpc_') and (fileName.endswith(JSON_EXTENSION) or
+    fileName.endswith(BINARY_EXTENSION))
+
+def isBinaryTrace(fileName):
+  return fileName.endswith(BINARY_EXTENSION)
+
+def getString(strings, offset):
+  end = strings.index(b'\0', offset)
+  return strings[offset:end].decode('utf-8', errors='replace')
+
+def traceSize(header):
+  # Size of the binary trace that starts with header (HEADER_SIZE bytes)
+  (magic, version, num_fields, num_string_fields, reserved, num_records,
+    fields_offset, records_offset, strings_offset, strings_size,
+    file_size) = struct.unpack_from(HEADER_FORMAT, header, 0)
+  if magic != TRACE_MAGIC or version not in READABLE_VERSIONS or file_size < HEADER_SIZE:
+    raise TraceError('invalid trace header')
+  return file_size
+
+def readBinaryTrace(fileName):
+  with open(fileName, 'rb') as f:
+    data = f.read()
+  return parseBinaryTrace(data, fileName)
+
+def parseBinaryTrace(data, fileName='<memory>'):
+  if len(data) < HEADER_SIZE:
+    raise TraceError('invalid trace: ' + fileName)
+  (magic, version, num_fields, num_string_fields, reserved, num_records,
+    fields_offset, records_offset, strings_offset, strings_size,
+    file_size) = struct.unpack_from(HEADER_FORMAT, data, 0)
+  if magic != TRACE_MAGIC or version not in READABLE_VERSIONS or file_size != len(data):
+    raise TraceError('invalid trace: ' + fileName)
+
+  strings = data[strings_offset:strings_offset+strings_size]
+  offsets = struct.unpack_from('<'+str(num_fields)+'Q', data, fields_offset)
+  fields = [getString(strings, o) for o in offsets]
+
+  records = []
+  words = struct.unpack_from('<'+str(num_fields*num_records)+'Q', data, records_offset)
+  for i in range(num_records):
+    record = {}
+    for f in range(num_fields):
+      value = words[i*num_fields + f]
+      if f < num_string_fields:
+        value = getString(strings, value)
+      record[fields[f]] = value
+
+    # Members that the JSON trace of the location would not have
+    for f in OPTIONAL_FIELDS:
+      if record.get(f) == '':
+        del record[f]
+    if 'absorption_gap' in record and record.get('absorption', 0) == 0:
+      del record['absorption_gap']
+    extensions = record.pop('extensions', '')
+    if extensions != '':
+      record.update(json.loads(extensions))
+    records.append(record)
+  return records
+
+def writeBinaryTrace(fileName, records):
+  # Counters that the runtime does not write are kept after the known
+  # fields, and the other members in the extensions
+  fields = list(TRACE_FIELDS)
+  for r in records:
+    for k in r.keys():
+      if k not in fields and isinstance(r[k], int) and not isinstance(r[k], bool):
+        fields.append(k)
+
+  strings = bytearray()
+  string_offsets = {}
+  def addString(s):
+    if s not in string_offsets:
+      string_offsets[s] = len(strings)
+      strings.extend(s.encode('utf-8') + b'\0')
+    return string_offsets[s]
+
+  field_offsets = [addString(f) for f in fields]
+  words = []
+  for r in records:
+    extensions = {k: v for k, v in r.items() if k not in fields}
+    for f in fields:
+      if f == 'extensions':
+        words.append(addString(json.dumps(extensions) if extensions else ''))
+      elif f in STRING_FIELDS:
+        words.append(addString(r.get(f, '')))
+      else:
+        words.append(int(r.get(f, 0)))
+
+  num_fields = len(fields)
+  fields_offset = HEADER_SIZE
+  records_offset = fields_offset + 8 * num_fields
+  strings_offset = records_offset + 8 * len(words)
+  file_size = strings_offset + len(strings)
+  header = struct.pack(HEADER_FORMAT, TRACE_MAGIC, TRACE_VERSION, num_fields,
+    len(STRING_FIELDS), 0, len(records), fields_offset, records_offset,
+    strings_offset, len(strings), file_size)
+
+  with open(fileName, 'wb') as f:
+    f.write(header)
+    f.write(struct.pack('<'+str(num_fields)+'Q', *field_offsets))
+    f.write(struct.pack('<'+str(len(words))+'Q', *words))
+    f.write(strings)
+
+def readJSONTrace(fileName):
+  with open(fileName, 'r') as f:
+    return json.load(f)
+
+def writeJSONTrace(fileName, records):
+  with open(fileName, 'w') as f:
+    json.dump(records, f, indent=2)
+    f.write('\n')
+
+def loadTrace(fileName):
+  if isBinaryTrace(fileName):
+    return readBinaryTrace(fileName)
+  return readJSONTrace(fileName)
+
+def mergeSiteInfo(site, record):
+  if 'function' in record:
+    site['function'] = record['function']
+  if 'fast_math' in record:
+    flags = set(site.get('fast_math', '').split(',')) | set(record['fast_math'].split(','))
+    site['fast_math'] = ','.join(sorted(f for f in flags if f != ''))
+  if 'absorption_gap' in record:
+    site['absorption_gap'] = max(site.get('absorption_gap', 0), int(record['absorption_gap']))
+
+def mergeTraces(traces):
+  # Merges the traces of several processes by (file, line), like the
+  # runtime does (src/FPC_MergeTable.h): counters are added, and "min" and
+  # "max" keep the minimum and maximum over the processes that saved the
+  # location. Merged traces (with "min" and "max") can be merged again.
+  # The function and fast-math flags of the location are kept, and
+  # absorption_gap is the maximum gap.
+  counters = COUNTER_FIELDS
+  sites = {}
+  for records in traces:
+    # A process may have several records for a location
+    local = {}
+    for r in records:
+      key = (r['file'], int(r['line']))
+      if key not in local:
+        local[key] = {'input': r.get('input', ''), 'file': r['file'], 'line': int(r['line']),
+          'min': {}, 'max': {}}
+        for c in counters:
+          local[key][c] = 0
+      site = local[key]
+      mergeSiteInfo(site, r)
+      for c in counters:
+        value = int(r.get(c, 0))
+        site[c] += value
+        site['min'][c] = site['min'].get(c, 0) + int(r.get('min', {}).get(c, value))
+        site['max'][c] = site['max'].get(c, 0) + int(r.get('max', {}).get(c, value))
+
+    for key, other in local.items():
+      if key not in sites:
+        sites[key] = other
+        continue
+      site = sites[key]
+      mergeSiteInfo(site, other)
+      for c in counters:
+        site[c] += other[c]
+        site['min'][c] = min(site['min'][c], other['min'][c])
+        site['max'][c] = max(site['max'][c], other['max'][c])
+  return list(sites.values())
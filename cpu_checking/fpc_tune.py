@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+
+# Description: Mixed-precision search in the style of Precimonious. The
+#              program is rebuilt with sets of functions demoted from double
+#              to a lower precision (FPC_EMULATE and FPC_EMULATE_FUNCTIONS,
+#              see src/Instrumentation_cpu.cpp), and the user's test command
+#              decides if the output is still accurate (exit code 0). Delta
+#              debugging finds a 1-minimal set of functions that must stay
+#              in double; the other functions are demoted. Candidates are
+#              built and tested in parallel, each one in its own copy of
+#              the source directory.
+
+import os
+import sys
+import json
+import time
+import queue
+import shutil
+import argparse
+import tempfile
+import subprocess
+from concurrent.futures import ThreadPoolExecutor
+from colors import prGreen, prCyan, prRed
+
+IGNORED_FILES = shutil.ignore_patterns('.fpc_logs', 'fpc-report', '.fpc_tune*')
+
+class Tuner:
+  def __init__(self, args, functions):
+    self.args = args
+    self.functions = functions
+    self.results = {}
+    self.workdirs = queue.Queue()
+    self.root = tempfile.mkdtemp(prefix='.fpc_tune_', dir=args.work_dir)
+    for i in range(args.jobs):
+      d = os.path.join(self.root, 'worker_' + str(i))
+      shutil.copytree(args.source, d, symlinks=True, ignore=IGNORED_FILES)
+      self.workdirs.put(d)
+
+  def cleanup(self):
+    shutil.rmtree(self.root, ignore_errors=True)
+
+  # Builds and tests the program with the functions that are not in keep
+  # demoted. Returns (passed, seconds).
+  def run(self, keep):
+    demoted = [f for f in self.functions if f not in keep]
+    env = os.environ.copy()
+    env.pop('FPC_EMULATE_FILES', None)
+    env.pop('FPC_EMULATE_SITES', None)
+    if len(demoted) > 0:
+      env['FPC_EMULATE'] = self.args.format
+      env['FPC_EMULATE_FUNCTIONS'] = ','.join(demoted)
+    else:
+      env.pop('FPC_EMULATE', None)
+      env.pop('FPC_EMULATE_FUNCTIONS', None)
+
+    d = self.workdirs.get()
+    try:
+      build = subprocess.run(self.args.build, shell=True, cwd=d, env=env,
+        stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+      if build.returncode != 0:
+        return (False, 0.0)
+      start = time.perf_counter()
+      try:
+        test = subprocess.run(self.args.test, shell=True, cwd=d, env=env,
+          stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, timeout=self.args.timeout)
+        passed = (test.returncode == 0)
+      except subprocess.TimeoutExpired:
+        passed = False
+      return (passed, time.perf_counter() - start)
+    finally:
+      self.workdirs.put(d)
+
+  # Evaluates the configurations in parallel; results are cached
+  def evaluate(self, configs):
+    configs = [frozenset(c) for c in configs]
+    pending = list(set([c for c in configs if c not in self.results]))
+    with ThreadPoolExecutor(max_workers=self.args.jobs) as pool:
+      for (c, r) in zip(pending, pool.map(self.run, pending)):
+        self.results[c] = r
+        demoted = len(self.functions) - len(c)
+        status = 'pass' if r[0] else 'fail'
+        print('  demoted {}/{}: {} ({:.3f} s)'.format(demoted, len(self.functions), status, r[1]))
+    return [self.results[c] for c in configs]
+
+  # Among the configurations that pass, the one with the fewest functions
+  # in double, then the fastest
+  def best(self, configs):
+    candidates = [c for (c, r) in zip(configs, self.evaluate(configs)) if r[0]]
+    if len(candidates) == 0:
+      return None
+    return min(candidates, key=lambda c: (len(c), self.results[frozenset(c)][1]))
+
+  # Delta debugging on the functions kept in double
+  def search(self):
+    everything = list(self.functions)
+    prCyan('Baseline (no demotion) and all functions demoted...')
+    (base, demote_all) = self.evaluate([everything, []])
+    if not base[0]:
+      prRed('The test fails without demotion: ' + self.args.test)
+      return None
+    if demote_all[0]:
+      return []
+
+    keep = everything
+    n = 2
+    while len(keep) >= 2:
+      n = min(n, len(keep))
+      chunks = [keep[i*len(keep)//n:(i+1)*len(keep)//n] for i in range(n)]
+      prCyan('Keeping {} functions in double, {} partitions...'.format(len(keep), n))
+      subset = self.best(chunks)
+      if subset is not None:
+        keep = subset
+        n = 2
+        continue
+      complements = [[f for f in keep if f not in c] for c in chunks]
+      complement = self.best(complements) if n > 2 else None
+      if complement is not None:
+        keep = complement
+        n = max(n - 1, 2)
+        continue
+      if n >= len(keep):
+        break
+      n = min(len(keep), 2 * n)
+    return keep
+
+def readFunctions(args):
+  functions = []
+  if args.functions:
+    functions += [f for f in args.functions.split(',') if f != '']
+  if args.functions_file:
+    with open(args.functions_file, 'r') as fd:
+      functions += [l.strip() for l in fd if l.strip() != '' and not l.startswith('#')]
+  return list(dict.fromkeys(functions))
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser(description='Searches the functions that can be demoted to a lower precision')
+  parser.add_argument('-b', '--build', required=True,
+    help='Build command; it must rebuild the program with clang++-fpchecker (e.g., "make clean all").')
+  parser.add_argument('-t', '--test', required=True,
+    help='Test command; exit code 0 if the output is accurate enough.')
+  parser.add_argument('-f', '--functions',
+    help='Comma-separated functions to demote.')
+  parser.add_argument('-F', '--functions-file',
+    help='File with the functions to demote, one per line.')
+  parser.add_argument('-p', '--format', default='fp32', choices=['fp32', 'bf16', 'fp16'],
+    help='Precision of the demoted functions (default: fp32).')
+  parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(),
+    help='Candidates built and tested in parallel (default: number of cores).')
+  parser.add_argument('-s', '--source', default='.',
+    help='Source directory, copied for each job (default: current directory).')
+  parser.add_argument('-w', '--work-dir', default='.',
+    help='Directory for the copies of the source directory (default: current directory).')
+  parser.add_argument('--timeout', type=float, default=None,
+    help='Seconds before a test is considered failed.')
+  parser.add_argument('-o', '--output',
+    help='Write the result to this JSON file.')
+  args = parser.parse_args()
+
+  functions = readFunctions(args)
+  if len(functions) == 0:
+    prRed('No functions to demote (use -f or -F)')
+    sys.exit(1)
+  args.jobs = max(1, args.jobs if args.jobs else 1)
+  args.source = os.path.abspath(args.source)
+  args.work_dir = os.path.abspath(args.work_dir)
+
+  tuner = Tuner(args, functions)
+  try:
+    keep = tuner.search()
+  finally:
+    tuner.cleanup()
+  if keep is None:
+    sys.exit(1)
+
+  demoted = [f for f in functions if f not in keep]
+  (passed, seconds) = tuner.results[frozenset(keep)]
+  (passed, base_seconds) = tuner.results[frozenset(functions)]
+  prGreen('#FPCHECKER: Configurations evaluated: ' + str(len(tuner.results)))
+  prGreen('#FPCHECKER: Demoted to ' + args.format + ': ' + (', '.join(demoted) if demoted else '-'))
+  prGreen('#FPCHECKER: Kept in double: ' + (', '.join(keep) if keep else '-'))
+  print('Test time: {:.3f} s (baseline: {:.3f} s)'.format(seconds, base_seconds))
+
+  if args.output:
+    with open(args.output, 'w') as fd:
+      json.dump({'format': args.format, 'demoted': demoted, 'double': keep,
+        'seconds': seconds, 'baseline_seconds': base_seconds,
+        'evaluated': len(tuner.results)}, fd, indent=2)
+      fd.write('\n')
@@ -1,6 +1,7 @@
 #!/usr/bin/env python3
 
 import os
+import re
 import pathlib
 import subprocess
 import platform
@@ -20,7 +21,13 @@ if platform.system() == 'Darwin':
 else:
   FPCHECKER_LIB       = FPCHECKER_PATH+'/../lib/libfpchecker_cpu.so'
 FPCHECKER_RUNTIME   = FPCHECKER_PATH+'/../src/Runtime_cpu.h'
-LLVM_PASS           = "-Xclang -load -Xclang " + FPCHECKER_LIB + " -include " + FPCHECKER_RUNTIME + ' -g '
+LLVM_PASS           = "-Xclang -load -Xclang " + FPCHECKER_LIB + " -include " + FPCHECKER_RUNTIME + ' '
+
+# LLVM version of the pass (see clang_fpchecker.py)
+try:
+  from fpc_config import LLVM_VERSION_MAJOR
+except ImportError:
+  LLVM_VERSION_MAJOR = None
 
 # --------------------------------------------------------------------------- #
 # --- Global variables ------------------------------------------------------ #
@@ -29,6 +36,25 @@ LLVM_PASS           = "-Xclang -load -Xclang " + FPCHECKER_LIB + " -include " +
 C_WRAPPER_NAMES   = ['mpicc', 'mpiclang', 'mpigcc']
 CXX_WRAPPER_NAMES = ['mpiCC', 'mpic++', 'mpicxx', 'mpiclang++', 'mpig++']
 
+# --------------------------------------------------------------------------- #
+# --- Functions ------------------------------------------------------------- #
+# --------------------------------------------------------------------------- #
+
+# Major version of LLVM, from the build of the pass. Without fpc_config.py
+# (e.g., running from the sources), the compiler is asked once per process.
+def getLLVMVersion(compiler):
+  global LLVM_VERSION_MAJOR
+  if LLVM_VERSION_MAJOR is None:
+    LLVM_VERSION_MAJOR = 0
+    try:
+      out = subprocess.check_output([compiler, '--version'], stderr=subprocess.STDOUT)
+      m = re.search(r'clang version (\d+)', out.decode('utf-8'))
+      if m:
+        LLVM_VERSION_MAJOR = int(m.group(1))
+    except Exception:
+      pass
+  return LLVM_VERSION_MAJOR
+
 # --------------------------------------------------------------------------- #
 # --- Classes --------------------------------------------------------------- #
 # --------------------------------------------------------------------------- #
@@ -101,19 +127,60 @@ class Command:
       return True
     return False
 
+  # -gline-tables-only unless the command has a -g flag (see
+  # clang_fpchecker.py)
+  def getDebugInfoFlags(self):
+    # The last -g flag wins; -gno-* and -gz only change the debug info
+    debug = [p for p in self.parameters if p.startswith('-g') and
+      not p.startswith(('-gcc', '-gno-', '-gz'))]
+    if len(debug) > 0 and debug[-1] != '-g0':
+      return []
+    if os.environ.get('FPC_DEBUG_INFO', '') == 'full':
+      return ['-g']
+    return ['-gline-tables-only']
+
+  # -fpass-plugin for the new pass manager (see clang_fpchecker.py)
+  def getPassPluginFlags(self):
+    if getLLVMVersion(self.name) >= 13:
+      return ['-fpass-plugin=' + FPCHECKER_LIB]
+    return []
+
+  # FPC_LTO=1: instrumentation at link time (see clang_fpchecker.py)
+  def isLTOMode(self):
+    return os.environ.get('FPC_LTO', '0') != '0'
+
+  def getLTOFlags(self, link):
+    flags = []
+    if not any(p.startswith('-flto') for p in self.parameters):
+      flags += ['-flto=thin']
+    if link:
+      if not any(p.startswith('-fuse-ld') for p in self.parameters):
+        flags += ['-fuse-ld=lld']
+      flags += ['-Wl,--load-pass-plugin=' + FPCHECKER_LIB]
+    return flags
+
   def instrumentIR(self):
-    new_cmd = [self.name] + self.mpi_params + LLVM_PASS.split() + self.parameters
+    # FPC_MPI: MPI_Finalize reduces the traces of all ranks (FPC_MPI_REDUCE)
+    new_cmd = ([self.name] + self.mpi_params + LLVM_PASS.split() + self.getPassPluginFlags() +
+               ['-DFPC_MPI'] + self.parameters + self.getDebugInfoFlags())
     for p in self.parameters:
       if '-fopenmp' in p:
         new_cmd += ['-DFPC_FPC_MULTI_THREADED']
+    env = os.environ.copy()
+    if self.isLTOMode():
+      new_cmd += self.getLTOFlags(False)
+      env['FPC_LTO_PRELINK'] = '1'
     try:
-      cmdOutput = subprocess.run(' '.join(new_cmd), shell=True, check=True)
+      cmdOutput = subprocess.run(' '.join(new_cmd), shell=True, check=True, env=env)
     except Exception as e:
       prRed(e)
       raise CompileException(new_cmd) from e
 
   def linkMPI(self):
-    new_cmd = [self.name] + self.mpi_link_params + self.parameters
+    # The runtime uses a thread to flush traces (FPC_FLUSH_INTERVAL)
+    new_cmd = [self.name] + self.mpi_link_params + self.parameters + ['-pthread']
+    if self.isLTOMode():
+      new_cmd += self.getLTOFlags(True)
     try:
       cmdOutput = subprocess.run(' '.join(new_cmd), shell=True, check=True)
     except Exception as e:
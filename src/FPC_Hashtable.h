@@ -11,15 +11,119 @@
 #include <string.h>
 #include <stdint.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+
+#include "FPC_TraceFormat.h"
 
 /*----------------------------------------------------------------------------*/
 /* Hash table item                                                            */
 /*----------------------------------------------------------------------------*/
 
+/** First occurrence of an event at a location (see _FPC_CAPTURE_RECORD_) **/
+typedef struct _FPC_OCCURRENCE_S_ {
+  double result;
+  double operands[3];
+  uint64_t thread;      // pthread_self() of the thread
+  uint64_t time;        // nanoseconds since the program started
+  int32_t rank;         // MPI rank, or -1
+  uint16_t bits;        // precision of the operation; values are widened to double
+  uint8_t num_operands; // 2, or 3 for fused multiply-adds
+  uint8_t ready;        // the occurrence is complete
+} _FPC_OCCURRENCE_T_;
+
+#define _FPC_NUM_EVENTS_  11    // events of _FPC_ITEM_T_, in order
+
+/** First k occurrences of each event at a location. Blocks are allocated
+ * when the location is inserted, so recording an occurrence does not
+ * allocate. **/
+typedef struct _FPC_CAPTURE_S_ {
+  uint64_t k;
+  uint64_t count[_FPC_NUM_EVENTS_];     // occurrences seen (slots claimed)
+  _FPC_OCCURRENCE_T_ occurrences[1];    // _FPC_NUM_EVENTS_ x k
+} _FPC_CAPTURE_T_;
+
+#define _FPC_RANGE_BINS_  32    // bins of 64 binary exponents (double)
+
+/** Exponent ranges of a location (see _FPC_RANGE_UPDATE_). Exponents are
+ * the binary exponents of the finite, nonzero values as doubles. **/
+typedef struct _FPC_RANGE_S_ {
+  int32_t bits;                 // precision of the operation
+  int32_t max_cancellation;     // bits cancelled in additions and subtractions
+  int32_t result_min;
+  int32_t result_max;
+  int32_t operand_min;
+  int32_t operand_max;
+  uint64_t histogram[_FPC_RANGE_BINS_];   // results by biased exponent / 64
+} _FPC_RANGE_T_;
+
+#define _FPC_FORMAT_NAMES_  "fp32", "bf16", "fp16"
+
+/** Fast-math flags of LLVM instructions: bit i is flag i **/
+#define _FPC_FAST_MATH_NAMES_ "reassoc", "nnan", "ninf", "nsz", "arcp", "contract", "afn"
+#define _FPC_NUM_FAST_MATH_FLAGS_ 7
+
+/** Effect of rounding the results of a location to a lower precision
+ * (see _FPC_EMULATE_OP_), relative to the results in full precision **/
+typedef struct _FPC_EMULATION_S_ {
+  int32_t format;               // index in _FPC_FORMAT_NAMES_
+  uint64_t executions;
+  uint64_t overflows;           // finite results that overflow in the format
+  uint64_t underflows;          // results that are subnormal or zero in the format
+  uint64_t cancellations;       // results that lose all the bits of the format
+  double max_error;             // maximum relative error of the results
+} _FPC_EMULATION_T_;
+
+/** Error of the results of a location measured against a shadow
+ * computation in higher precision (see _FPC_SHADOW_RECORD_) **/
+typedef struct _FPC_SHADOW_S_ {
+  int32_t bits;                 // significand bits of the operation
+  int32_t max_error_bits;       // maximum number of incorrect bits
+  uint64_t executions;
+  uint64_t inaccurate;          // results with more than half of the bits incorrect
+  uint64_t cancellations;       // inaccurate results of additions and subtractions
+  double max_error;             // maximum relative error
+  double sum_error;             // sum of the relative errors
+} _FPC_SHADOW_T_;
+
+/** Results of a location with random rounding (see _FPC_PERTURB_FP64_).
+ * The sum and the last result are compared across runs by fpc-perturb;
+ * the last result of an accumulation is the result of the reduction. **/
+typedef struct _FPC_PERTURBATION_S_ {
+  int32_t bits;                 // significand bits of the operation
+  int32_t mode;                 // 0: off, 1: random, 2: average (FPC_PERTURB_MODE)
+  uint64_t executions;
+  uint64_t perturbed;           // results rounded away from the nearest value
+  double sum;                   // sum of the finite results
+  double last;                  // last result
+} _FPC_PERTURBATION_T_;
+
+/** Subnormal numbers of a location (see _FPC_DENORMAL_UPDATE_) **/
+typedef struct _FPC_DENORMAL_S_ {
+  uint64_t operands;            // operations with a subnormal operand
+  uint64_t results;             // operations with a subnormal result
+  uint64_t assists;             // operations with a subnormal operand or result
+  int ftz_daz;                  // the process flushes subnormals to zero (FPC_FTZ_DAZ)
+} _FPC_DENORMAL_T_;
+
+/** Narrowing conversions of a location that lost the value (see
+ * _FPC_CONVERSION_UPDATE_) **/
+typedef struct _FPC_CONVERSION_S_ {
+  int32_t from_bits;            // precision of the converted values
+  int32_t from_type;            // 0: floating point, 3: bfloat
+  int32_t to_bits;              // precision of the results, or bits of the integer
+  int32_t to_type;              // 0: floating point, 1: signed, 2: unsigned integer,
+                                // 3: bfloat
+  uint64_t overflows;           // finite values converted to infinity
+  uint64_t underflows;          // nonzero values converted to zero or a subnormal
+  uint64_t out_of_range;        // values (or NaN) out of the range of the integer
+} _FPC_CONVERSION_T_;
+
 /** This structure defines different events and the location **/
 typedef struct _FPC_ITEM_S_ {
   char *file_name;
   uint64_t line;
+  char *function;      // math function called at the location, or NULL
+  uint32_t fast_math;  // fast-math flags of the operations with events
   uint64_t infinity_pos;
   uint64_t infinity_neg;
   uint64_t nan;
@@ -30,11 +134,34 @@ typedef struct _FPC_ITEM_S_ {
   uint64_t latent_infinity_pos;
   uint64_t latent_infinity_neg;
   uint64_t latent_underflow;
+  uint64_t absorption;
+  uint64_t absorption_gap; // maximum exponent gap of the absorptions
+  uint64_t executions; // dynamic executions (FPC_PROFILE_SITES or FPC_OVERHEAD_BUDGET)
+  uint64_t cycles;     // estimated cycles spent checking the location
+  _FPC_CAPTURE_T_ *captures; // first occurrences (FPC_CAPTURE_OCCURRENCES) or NULL
+  _FPC_RANGE_T_ *ranges;     // exponent ranges (FPC_PROFILE_RANGES) or NULL
+  _FPC_EMULATION_T_ *emulation; // reduced-precision emulation (FPC_EMULATE) or NULL
+  _FPC_SHADOW_T_ *shadow;    // errors against the shadow values (FPC_SHADOW) or NULL
+  _FPC_PERTURBATION_T_ *perturbation; // results with random rounding (FPC_PERTURB) or NULL
+  _FPC_DENORMAL_T_ *denormals; // subnormal operands and results (FPC_PROFILE_DENORMALS) or NULL
+  _FPC_CONVERSION_T_ *conversion; // lossy narrowing conversions or NULL
   struct _FPC_ITEM_S_ *next;
 } _FPC_ITEM_T_;
 
 //typedef struct _FPC_ITEM_S_ _FPC_ITEM_T_;
 
+/** Adds to a counter that may be updated by several threads outside of
+ * the lock. Returns the previous value. **/
+uint64_t _FPC_FETCH_ADD_(uint64_t *ptr, uint64_t val) {
+#ifdef FPC_MULTI_THREADED
+  return __atomic_fetch_add(ptr, val, __ATOMIC_RELAXED);
+#else
+  uint64_t old = *ptr;
+  *ptr = old + val;
+  return old;
+#endif
+}
+
 /** Program name and input **/
 extern int _FPC_PROG_INPUTS;
 extern char ** _FPC_PROG_ARGS;
@@ -92,13 +219,18 @@ _FPC_HTABLE_T *_FPC_HT_CREATE_(int64_t size)
 /* Hash function                                                              */
 /*----------------------------------------------------------------------------*/
 
-int _FPC_HT_HASH_( _FPC_HTABLE_T *hashtable, _FPC_ITEM_T_ *val)
+int _FPC_HT_HASH_KEY_(_FPC_HTABLE_T *hashtable, char *file_name, uint64_t line)
 {
-  uint64_t key = (uint64_t)(val->file_name);
-  key += val->line;
+  uint64_t key = (uint64_t)(file_name);
+  key += line;
   return (int)(key % hashtable->size);
 }
 
+int _FPC_HT_HASH_( _FPC_HTABLE_T *hashtable, _FPC_ITEM_T_ *val)
+{
+  return _FPC_HT_HASH_KEY_(hashtable, val->file_name, val->line);
+}
+
 /*----------------------------------------------------------------------------*/
 /* Key-value pair creation                                                    */
 /*----------------------------------------------------------------------------*/
@@ -114,6 +246,8 @@ _FPC_ITEM_T_ *_FPC_HT_NEWPAIR_(_FPC_ITEM_T_ *val)
 
   newpair->file_name            = val->file_name;
   newpair->line                 = val->line;
+  newpair->function             = val->function;
+  newpair->fast_math            = val->fast_math;
   newpair->infinity_pos         = val->infinity_pos;
   newpair->infinity_neg         = val->infinity_neg;
   newpair->nan                  = val->nan;
@@ -124,6 +258,17 @@ _FPC_ITEM_T_ *_FPC_HT_NEWPAIR_(_FPC_ITEM_T_ *val)
   newpair->latent_infinity_pos  = val->latent_infinity_pos;
   newpair->latent_infinity_neg  = val->latent_infinity_neg;
   newpair->latent_underflow     = val->latent_underflow;
+  newpair->absorption           = val->absorption;
+  newpair->absorption_gap       = val->absorption_gap;
+  newpair->executions           = val->executions;
+  newpair->cycles               = val->cycles;
+  newpair->captures             = val->captures;
+  newpair->ranges               = val->ranges;
+  newpair->emulation            = val->emulation;
+  newpair->shadow               = val->shadow;
+  newpair->perturbation         = val->perturbation;
+  newpair->denormals            = val->denormals;
+  newpair->conversion           = val->conversion;
 
   newpair->next = NULL;
 
@@ -141,11 +286,28 @@ int _FPC_ITEMS_EQUAL_(_FPC_ITEM_T_ *x, _FPC_ITEM_T_ *y)
   return 0;
 }
 
+int _FPC_EVENT_OCURRED(_FPC_ITEM_T_ *item) {
+  return (
+      item->infinity_pos ||
+      item->infinity_neg ||
+      item->nan ||
+      item->division_zero ||
+      item->cancellation ||
+      item->comparison ||
+      item->underflow ||
+      item->latent_infinity_pos ||
+      item->latent_infinity_neg ||
+      item->latent_underflow ||
+      item->absorption
+      );
+}
+
 /*----------------------------------------------------------------------------*/
 /* Insert a key-value pair into a hash table                                  */
 /*----------------------------------------------------------------------------*/
 
-void _FPC_HT_SET_(_FPC_HTABLE_T *hashtable, _FPC_ITEM_T_ *newVal)
+/** Returns the item of the location **/
+_FPC_ITEM_T_ *_FPC_HT_SET_(_FPC_HTABLE_T *hashtable, _FPC_ITEM_T_ *newVal)
 {
   int bin = 0;
   _FPC_ITEM_T_ *newpair = NULL;
@@ -173,47 +335,161 @@ void _FPC_HT_SET_(_FPC_HTABLE_T *hashtable, _FPC_ITEM_T_ *newVal)
     next->latent_infinity_pos  += newVal->latent_infinity_pos;
     next->latent_infinity_neg  += newVal->latent_infinity_neg;
     next->latent_underflow     += newVal->latent_underflow;
+    next->absorption           += newVal->absorption;
+    if (next->function == NULL && newVal->function != NULL)
+      __atomic_store_n(&(next->function), newVal->function, __ATOMIC_RELAXED);
+    if (newVal->absorption_gap > next->absorption_gap)
+      next->absorption_gap = newVal->absorption_gap;
+    next->fast_math            |= newVal->fast_math;
+    // Counted by _FPC_SITE_ENTER_ and _FPC_SITE_EXIT_ without the lock
+    _FPC_FETCH_ADD_(&(next->executions), newVal->executions);
+    _FPC_FETCH_ADD_(&(next->cycles), newVal->cycles);
+    return next;
 
   } else  { // Nope, could't find it
     newpair = _FPC_HT_NEWPAIR_(newVal);
     (hashtable->n)++;
 
+    // Links are published with release stores because _FPC_HT_GET_
+    // walks the lists without taking the lock
     if (next == hashtable->table[bin]) {
       // We're at the start of the linked list in this bin
       newpair->next = next;
-      hashtable->table[bin] = newpair;
+      __atomic_store_n(&(hashtable->table[bin]), newpair, __ATOMIC_RELEASE);
     } else if ( next == NULL ) {
       // We're at the end of the linked list in this bin
-      last->next = newpair;
+      __atomic_store_n(&(last->next), newpair, __ATOMIC_RELEASE);
     } else {
       // We're in the middle of the list.
       newpair->next = next;
-      last->next = newpair;
+      __atomic_store_n(&(last->next), newpair, __ATOMIC_RELEASE);
     }
+    return newpair;
   }
 }
 
+/*----------------------------------------------------------------------------*/
+/* Find a location in a hash table                                            */
+/*----------------------------------------------------------------------------*/
+
+/** Returns the item of a location or NULL. It does not need the lock. **/
+_FPC_ITEM_T_ *_FPC_HT_FIND_(_FPC_HTABLE_T *hashtable, char *file_name, uint64_t line)
+{
+  int bin = _FPC_HT_HASH_KEY_(hashtable, file_name, line);
+  _FPC_ITEM_T_ *next = __atomic_load_n(&(hashtable->table[bin]), __ATOMIC_ACQUIRE);
+  while (next != NULL) {
+    if (next->file_name == file_name && next->line == line)
+      return next;
+    next = __atomic_load_n(&(next->next), __ATOMIC_ACQUIRE);
+  }
+  return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Snapshot of a hash table                                                   */
+/*----------------------------------------------------------------------------*/
+
+/** Copies the locations that are saved in the traces (locations with events,
+ * or profiled locations) to a buffer that grows as needed. It does not need
+ * the lock, so a snapshot can be taken while other threads update the
+ * table. Returns the number of locations. **/
+uint64_t _FPC_HT_SNAPSHOT_(_FPC_HTABLE_T *hashtable, _FPC_ITEM_T_ **buffer, uint64_t *capacity)
+{
+  uint64_t n = 0;
+  for (uint64_t i=0; i < hashtable->size; ++i) {
+    _FPC_ITEM_T_ *next = __atomic_load_n(&(hashtable->table[i]), __ATOMIC_ACQUIRE);
+    while (next != NULL) {
+      // The padding is zeroed: flushes compare snapshots with memcmp
+      _FPC_ITEM_T_ item;
+      memset((void *)&item, 0, sizeof(item));
+      item.file_name           = next->file_name;
+      item.line                = next->line;
+      item.function            = __atomic_load_n(&(next->function), __ATOMIC_RELAXED);
+      item.fast_math           = __atomic_load_n(&(next->fast_math), __ATOMIC_RELAXED);
+      item.infinity_pos        = __atomic_load_n(&(next->infinity_pos), __ATOMIC_RELAXED);
+      item.infinity_neg        = __atomic_load_n(&(next->infinity_neg), __ATOMIC_RELAXED);
+      item.nan                 = __atomic_load_n(&(next->nan), __ATOMIC_RELAXED);
+      item.division_zero       = __atomic_load_n(&(next->division_zero), __ATOMIC_RELAXED);
+      item.cancellation        = __atomic_load_n(&(next->cancellation), __ATOMIC_RELAXED);
+      item.comparison          = __atomic_load_n(&(next->comparison), __ATOMIC_RELAXED);
+      item.underflow           = __atomic_load_n(&(next->underflow), __ATOMIC_RELAXED);
+      item.latent_infinity_pos = __atomic_load_n(&(next->latent_infinity_pos), __ATOMIC_RELAXED);
+      item.latent_infinity_neg = __atomic_load_n(&(next->latent_infinity_neg), __ATOMIC_RELAXED);
+      item.latent_underflow    = __atomic_load_n(&(next->latent_underflow), __ATOMIC_RELAXED);
+      item.absorption          = __atomic_load_n(&(next->absorption), __ATOMIC_RELAXED);
+      item.absorption_gap      = __atomic_load_n(&(next->absorption_gap), __ATOMIC_RELAXED);
+      item.executions          = __atomic_load_n(&(next->executions), __ATOMIC_RELAXED);
+      item.cycles              = __atomic_load_n(&(next->cycles), __ATOMIC_RELAXED);
+      item.captures            = __atomic_load_n(&(next->captures), __ATOMIC_ACQUIRE);
+      item.ranges              = __atomic_load_n(&(next->ranges), __ATOMIC_ACQUIRE);
+      item.emulation           = __atomic_load_n(&(next->emulation), __ATOMIC_ACQUIRE);
+      item.shadow              = __atomic_load_n(&(next->shadow), __ATOMIC_ACQUIRE);
+      item.perturbation        = __atomic_load_n(&(next->perturbation), __ATOMIC_ACQUIRE);
+      item.denormals           = __atomic_load_n(&(next->denormals), __ATOMIC_ACQUIRE);
+      item.conversion          = __atomic_load_n(&(next->conversion), __ATOMIC_ACQUIRE);
+      item.next                = NULL;
+      next = __atomic_load_n(&(next->next), __ATOMIC_ACQUIRE);
+
+      // Locations without events are only saved when they were profiled
+      // (executions), emulated, shadowed, perturbed or lost values in
+      // conversions
+      if (!_FPC_EVENT_OCURRED(&item) && item.executions == 0 &&
+          item.emulation == NULL && item.shadow == NULL &&
+          item.perturbation == NULL && item.conversion == NULL)
+        continue;
+
+      if (n == *capacity) {
+        *capacity = (*capacity == 0) ? 256 : (*capacity * 2);
+        *buffer = (_FPC_ITEM_T_ *)realloc(*buffer, sizeof(_FPC_ITEM_T_) * (*capacity));
+        if (*buffer == NULL) {
+          printf("#FPCHECKER: hash table out of memory error!");
+          exit(EXIT_FAILURE);
+        }
+      }
+      memcpy((void *)&((*buffer)[n++]), (void *)&item, sizeof(item));
+    }
+  }
+  return n;
+}
+
 /*----------------------------------------------------------------------------*/
 /* Print hash table                                                           */
 /*----------------------------------------------------------------------------*/
 
-void _FPC_PRINT_HASH_TABLE_(_FPC_HTABLE_T *hashtable)
+/** Sets and creates the directory of the traces. The shared directory is
+ * .fpc_logs, or FPC_STAGE_DIR if it is set. With FPC_LOCAL_DIR (see
+ * fpc-run) and -DFPC_STAGING, processes write their traces to the
+ * node-local directory of the run, $FPC_LOCAL_DIR/fpc_<run id>, and the
+ * traces of a node are merged into a single trace in the shared directory
+ * (see _FPC_STAGE_TRACES_). **/
+void _FPC_TRACE_DIR_(char *dirName, int local)
 {
+  char *local_dir = NULL;
+#ifdef FPC_STAGING
+  local_dir = getenv("FPC_LOCAL_DIR");
+#endif
+  char *stage_dir = getenv("FPC_STAGE_DIR");
+  char *run_id = getenv("FPC_RUN_ID");
+  if (local && local_dir != NULL && local_dir[0] != '\0') {
+    mkdir(local_dir, 0775);
+    snprintf(dirName, 4096, "%s/fpc_%s", local_dir,
+             (run_id != NULL && run_id[0] != '\0') ? run_id : "default");
+  } else if (stage_dir != NULL && stage_dir[0] != '\0')
+    snprintf(dirName, 4096, "%s", stage_dir);
+  else
+    strcpy(dirName, ".fpc_logs");
+
   // Create directory
-  //struct stat st = {0};
   struct stat st;
-  char dir_name[] = ".fpc_logs";
-  if (stat(dir_name, &st) == -1) { // dir doesn't exists
-    //printf("#FPCHECKER: overwriting traces...\n");
-    //char p[64];
-    //p[0] = '\0';
-    //sprintf(p, "rm -rf %s", dir_name);
-    //system(p);
-    mkdir(dir_name, 0775);
-  }
+  if (stat(dirName, &st) == -1) // dir doesn't exists
+    mkdir(dirName, 0775);
+}
 
-  // Set filename
-  //size_t len=256;
+/** Sets the name of a trace in the local or shared directory:
+ *   <dir>/fpc_[<run id>_]<node>[_<pid>]<extension>
+ * FPC_RUN_ID tags the traces of a run (e.g., the job ID). **/
+void _FPC_TRACE_PATH_(char *fileName, int local, int with_pid, const char *extension)
+{
   // According to Linux manual:
   // Each element of the hostname must be from 1 to 63 characters long
   // and the entire hostname, including the dots, can be at most 253
@@ -223,24 +499,36 @@ void _FPC_PRINT_HASH_TABLE_(_FPC_HTABLE_T *hashtable)
   if(gethostname(nodeName, 256) != 0)
     strcpy(nodeName, "node-unknown");
 
-  // On Linux: The maximum length for a file name is 255 bytes. 
+  // On Linux: The maximum length for a file name is 255 bytes.
   // The maximum combined length of both the file name and path name is 4096 bytes.
-  char fileName[5000];
-  fileName[0] = '\0';
-  strcpy(fileName, ".fpc_logs/fpc_");
-  //strcpy(fileName, "fpc_");
+  _FPC_TRACE_DIR_(fileName, local);
+  strcat(fileName, "/fpc_");
+  char *run_id = getenv("FPC_RUN_ID");
+  if (run_id != NULL && run_id[0] != '\0' && strlen(run_id) < 128) {
+    strcat(fileName, run_id);
+    strcat(fileName, "_");
+  }
   strcat(fileName, nodeName);
 
   // Maximum size for PID: we assume 2,000,000,000
-  int pid = (int)getpid();
-  char pidStr[11];
-  pidStr[0] = '\0';
-  sprintf(pidStr, "%d", pid);
-  strcat(fileName, "_");
-  strcat(fileName, pidStr);
-  strcat(fileName, ".json");
+  if (with_pid) {
+    char pidStr[16];
+    sprintf(pidStr, "_%d", (int)getpid());
+    strcat(fileName, pidStr);
+  }
+  strcat(fileName, extension);
+}
 
-  // Get program name and input
+/** Sets the name of the trace file of this process:
+ * .fpc_logs/fpc_<node>_<pid><extension> by default **/
+void _FPC_TRACE_FILE_NAME_(char *fileName, const char *extension)
+{
+  _FPC_TRACE_PATH_(fileName, 1, 1, extension);
+}
+
+/** Returns the program name and input. The caller frees the string. **/
+char *_FPC_PROG_INPUT_STRING_()
+{
   int str_size = 0;
   for (int i=0; i < _FPC_PROG_INPUTS; ++i)
     str_size += strlen(_FPC_PROG_ARGS[i]) + 1;
@@ -250,49 +538,552 @@ void _FPC_PRINT_HASH_TABLE_(_FPC_HTABLE_T *hashtable)
     strcat(prog_input, _FPC_PROG_ARGS[i]);
     strcat(prog_input, " ");
   }
+  return prog_input;
+}
+
+/** Writes the first occurrences of the events of a location as
+ *   "occurrences": {"nan": [{"result": "nan", "operands": ["0", "0"],
+ *     "bits": 64, "thread": 1234, "rank": -1, "time_ns": 5678}], ...}
+ * Values are strings, since JSON numbers cannot be NaN or infinity. **/
+void _FPC_WRITE_OCCURRENCES_(FILE *fp, _FPC_CAPTURE_T_ *captures)
+{
+  const char *names[] = { _FPC_TRACE_FIELDS_ };
+  fprintf(fp, ",\n\t\"occurrences\": {");
+  int first = 1;
+  for (int e = 0; e < _FPC_NUM_EVENTS_; ++e) {
+    uint64_t n = __atomic_load_n(&(captures->count[e]), __ATOMIC_RELAXED);
+    if (n > captures->k)
+      n = captures->k;
+    int written = 0;
+    for (uint64_t i = 0; i < n; ++i) {
+      _FPC_OCCURRENCE_T_ *o = &(captures->occurrences[e * captures->k + i]);
+      if (!__atomic_load_n(&(o->ready), __ATOMIC_ACQUIRE))
+        continue;
+      int digits = (o->bits == 32) ? 9 : 17;
+      if (written == 0)
+        fprintf(fp, "%s\n\t  \"%s\": [", (first ? "" : ","), names[e + _FPC_TRACE_FIRST_EVENT_]);
+      fprintf(fp, "%s{\"result\": \"%.*g\", \"operands\": [",
+              (written > 0 ? ", " : ""), digits, o->result);
+      for (int j = 0; j < o->num_operands; ++j)
+        fprintf(fp, "%s\"%.*g\"", (j > 0 ? ", " : ""), digits, o->operands[j]);
+      fprintf(fp, "], \"bits\": %d, \"thread\": %lu, \"rank\": %d, \"time_ns\": %lu}",
+              (int)o->bits, o->thread, (int)o->rank, o->time);
+      written++;
+      first = 0;
+    }
+    if (written > 0)
+      fprintf(fp, "]");
+  }
+  fprintf(fp, "\n\t}");
+}
+
+/** Writes an exponent range as [min, max], or null if it is empty **/
+void _FPC_WRITE_EXPONENTS_(FILE *fp, int32_t min, int32_t max)
+{
+  if (min > max)
+    fprintf(fp, "null");
+  else
+    fprintf(fp, "[%d, %d]", (int)min, (int)max);
+}
+
+/** Writes the exponent ranges of a location as
+ *   "ranges": {"bits": 64, "result_exp": [-3, 5], "operand_exp": [-2, 5],
+ *     "max_cancellation": 4, "histogram": [0, ..., 0]}
+ * Bin i of the histogram counts the results with biased exponents
+ * 64*i to 64*i+63. **/
+void _FPC_WRITE_RANGES_(FILE *fp, _FPC_RANGE_T_ *r)
+{
+  fprintf(fp, ",\n\t\"ranges\": {\"bits\": %d, \"result_exp\": ", (int)r->bits);
+  _FPC_WRITE_EXPONENTS_(fp, __atomic_load_n(&(r->result_min), __ATOMIC_RELAXED),
+                        __atomic_load_n(&(r->result_max), __ATOMIC_RELAXED));
+  fprintf(fp, ", \"operand_exp\": ");
+  _FPC_WRITE_EXPONENTS_(fp, __atomic_load_n(&(r->operand_min), __ATOMIC_RELAXED),
+                        __atomic_load_n(&(r->operand_max), __ATOMIC_RELAXED));
+  fprintf(fp, ", \"max_cancellation\": %d, \"histogram\": [",
+          (int)__atomic_load_n(&(r->max_cancellation), __ATOMIC_RELAXED));
+  for (int i = 0; i < _FPC_RANGE_BINS_; ++i)
+    fprintf(fp, "%s%lu", (i ? ", " : ""), __atomic_load_n(&(r->histogram[i]), __ATOMIC_RELAXED));
+  fprintf(fp, "]}");
+}
+
+/** Writes the effect of the reduced-precision emulation of a location as
+ *   "emulation": {"format": "bf16", "executions": 100, "overflows": 0,
+ *     "underflows": 0, "cancellations": 2, "max_relative_error": 0.0039}
+ **/
+void _FPC_WRITE_EMULATION_(FILE *fp, _FPC_EMULATION_T_ *e)
+{
+  const char *formats[] = { _FPC_FORMAT_NAMES_ };
+  double error;
+  __atomic_load(&(e->max_error), &error, __ATOMIC_RELAXED);
+  fprintf(fp, ",\n\t\"emulation\": {\"format\": \"%s\", \"executions\": %lu, "
+          "\"overflows\": %lu, \"underflows\": %lu, \"cancellations\": %lu, "
+          "\"max_relative_error\": %.6g}", formats[e->format],
+          __atomic_load_n(&(e->executions), __ATOMIC_RELAXED),
+          __atomic_load_n(&(e->overflows), __ATOMIC_RELAXED),
+          __atomic_load_n(&(e->underflows), __ATOMIC_RELAXED),
+          __atomic_load_n(&(e->cancellations), __ATOMIC_RELAXED), error);
+}
 
-  // Prepare to print table
-  uint64_t n = hashtable->n;
-  uint64_t printed = 0;
+/** Writes the errors of a location against the shadow values as
+ *   "shadow": {"bits": 53, "executions": 100, "max_relative_error": 0.5,
+ *     "mean_relative_error": 0.01, "max_error_bits": 52, "inaccurate": 2,
+ *     "cancellations": 2}
+ **/
+void _FPC_WRITE_SHADOW_(FILE *fp, _FPC_SHADOW_T_ *sh)
+{
+  double max_error, sum_error;
+  __atomic_load(&(sh->max_error), &max_error, __ATOMIC_RELAXED);
+  __atomic_load(&(sh->sum_error), &sum_error, __ATOMIC_RELAXED);
+  uint64_t executions = __atomic_load_n(&(sh->executions), __ATOMIC_RELAXED);
+  fprintf(fp, ",\n\t\"shadow\": {\"bits\": %d, \"executions\": %lu, "
+          "\"max_relative_error\": %.6g, \"mean_relative_error\": %.6g, "
+          "\"max_error_bits\": %d, \"inaccurate\": %lu, \"cancellations\": %lu}",
+          (int)sh->bits, executions, max_error,
+          (executions > 0) ? sum_error / (double)executions : 0.0,
+          (int)__atomic_load_n(&(sh->max_error_bits), __ATOMIC_RELAXED),
+          __atomic_load_n(&(sh->inaccurate), __ATOMIC_RELAXED),
+          __atomic_load_n(&(sh->cancellations), __ATOMIC_RELAXED));
+}
+
+/** Writes a double that may not be finite, as null (tested on the bits,
+ * since the program may be built with -ffinite-math-only) **/
+void _FPC_WRITE_DOUBLE_(FILE *fp, double v)
+{
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  if (((bits >> 52) & 0x7ff) != 0x7ff)
+    fprintf(fp, "%.17g", v);
+  else
+    fprintf(fp, "null");
+}
+
+/** Writes the results of a location with random rounding as
+ *   "perturbation": {"mode": "random", "bits": 53, "executions": 100,
+ *     "perturbed": 48, "sum": 1234.5678901234567, "last": 12.5}
+ **/
+void _FPC_WRITE_PERTURBATION_(FILE *fp, _FPC_PERTURBATION_T_ *p)
+{
+  const char *modes[] = {"off", "random", "average"};
+  double sum, last;
+  __atomic_load(&(p->sum), &sum, __ATOMIC_RELAXED);
+  __atomic_load(&(p->last), &last, __ATOMIC_RELAXED);
+  fprintf(fp, ",\n\t\"perturbation\": {\"mode\": \"%s\", \"bits\": %d, "
+          "\"executions\": %lu, \"perturbed\": %lu, \"sum\": ", modes[p->mode],
+          (int)p->bits, __atomic_load_n(&(p->executions), __ATOMIC_RELAXED),
+          __atomic_load_n(&(p->perturbed), __ATOMIC_RELAXED));
+  _FPC_WRITE_DOUBLE_(fp, sum);
+  fprintf(fp, ", \"last\": ");
+  _FPC_WRITE_DOUBLE_(fp, last);
+  fprintf(fp, "}");
+}
+
+/** Sets str (at least 128 chars) to the fast-math flags, e.g., "nnan,ninf" **/
+void _FPC_FAST_MATH_STRING_(char *str, uint32_t flags)
+{
+  const char *names[] = { _FPC_FAST_MATH_NAMES_ };
+  str[0] = '\0';
+  for (int i = 0; i < _FPC_NUM_FAST_MATH_FLAGS_; ++i) {
+    if (flags & (1u << i)) {
+      if (str[0] != '\0')
+        strcat(str, ",");
+      strcat(str, names[i]);
+    }
+  }
+}
+
+/** Writes the fast-math flags of a location as
+ *   "fast_math": "nnan,ninf",
+ **/
+void _FPC_WRITE_FAST_MATH_(FILE *fp, uint32_t flags)
+{
+  char str[128];
+  _FPC_FAST_MATH_STRING_(str, flags);
+  fprintf(fp, "\t\"fast_math\": \"%s\",\n", str);
+}
+
+/** Writes the lossy conversions of a location as
+ *   "conversion": {"from": "fp64", "to": "fp32", "overflows": 2,
+ *     "underflows": 0, "out_of_range": 0}
+ * Integers are "i32", "u64", etc., and bfloat is "bf16". **/
+void _FPC_WRITE_CONVERSION_(FILE *fp, _FPC_CONVERSION_T_ *c)
+{
+  const char *types[] = { "fp", "i", "u", "bf" };
+  fprintf(fp, ",\n\t\"conversion\": {\"from\": \"%s%d\", \"to\": \"%s%d\", "
+          "\"overflows\": %lu, \"underflows\": %lu, \"out_of_range\": %lu}",
+          types[c->from_type], (int)c->from_bits, types[c->to_type],
+          (int)c->to_bits, __atomic_load_n(&(c->overflows), __ATOMIC_RELAXED),
+          __atomic_load_n(&(c->underflows), __ATOMIC_RELAXED),
+          __atomic_load_n(&(c->out_of_range), __ATOMIC_RELAXED));
+}
+
+/** Writes the subnormal numbers of a location as
+ *   "denormals": {"operands": 10, "results": 2, "assists": 11, "ftz_daz": 0}
+ **/
+void _FPC_WRITE_DENORMALS_(FILE *fp, _FPC_DENORMAL_T_ *d)
+{
+  fprintf(fp, ",\n\t\"denormals\": {\"operands\": %lu, \"results\": %lu, "
+          "\"assists\": %lu, \"ftz_daz\": %d}",
+          __atomic_load_n(&(d->operands), __ATOMIC_RELAXED),
+          __atomic_load_n(&(d->results), __ATOMIC_RELAXED),
+          __atomic_load_n(&(d->assists), __ATOMIC_RELAXED), d->ftz_daz);
+}
+
+/** Returns 1 if the location has optional objects (see _FPC_WRITE_EXTENSIONS_) **/
+int _FPC_ITEM_HAS_EXTENSIONS_(_FPC_ITEM_T_ *item)
+{
+  return (item->captures != NULL || item->ranges != NULL || item->emulation != NULL ||
+          item->shadow != NULL || item->perturbation != NULL || item->denormals != NULL ||
+          item->conversion != NULL);
+}
+
+/** Writes the optional objects of a location, each preceded by ",\n\t" **/
+void _FPC_WRITE_EXTENSIONS_(FILE *fp, _FPC_ITEM_T_ *item)
+{
+  if (item->captures != NULL)
+    _FPC_WRITE_OCCURRENCES_(fp, item->captures);
+  if (item->ranges != NULL)
+    _FPC_WRITE_RANGES_(fp, item->ranges);
+  if (item->emulation != NULL)
+    _FPC_WRITE_EMULATION_(fp, item->emulation);
+  if (item->shadow != NULL)
+    _FPC_WRITE_SHADOW_(fp, item->shadow);
+  if (item->perturbation != NULL)
+    _FPC_WRITE_PERTURBATION_(fp, item->perturbation);
+  if (item->denormals != NULL)
+    _FPC_WRITE_DENORMALS_(fp, item->denormals);
+  if (item->conversion != NULL)
+    _FPC_WRITE_CONVERSION_(fp, item->conversion);
+}
+
+/** Writes the locations to the JSON trace of this process. The trace is
+ * written to a temporary file that replaces the trace, so the trace on
+ * disk is always complete. **/
+void _FPC_WRITE_JSON_TRACE_(_FPC_ITEM_T_ *items, uint64_t n)
+{
+  char fileName[5000];
+  char tmpName[5010];
+  _FPC_TRACE_FILE_NAME_(fileName, ".json");
+  sprintf(tmpName, "%s.tmp", fileName);
+
+  // Get program name and input
+  char *prog_input = _FPC_PROG_INPUT_STRING_();
 
   FILE *fp;
-  fp = fopen(fileName, "w");
+  fp = fopen(tmpName, "w");
+  if (fp == NULL) {
+    printf("#FPCHECKER: could not create trace: %s\n", fileName);
+    free(prog_input);
+    return;
+  }
 
   fprintf(fp, "[\n");
 
-  for (int i=0; (uint64_t)i < hashtable->size; ++i) {
-    _FPC_ITEM_T_ *next;
-    next = hashtable->table[i];
-
-    while(next != NULL) {
-      fprintf(fp, "  {\n");
-      fprintf(fp, "\t\"input\": \"%s\",\n", prog_input);
-      fprintf(fp, "\t\"file\": \"%s\",\n", next->file_name);
-      fprintf(fp, "\t\"line\": %lu,\n", next->line);
-
-      fprintf(fp, "\t\"infinity_pos\": %lu,\n", next->infinity_pos);
-      fprintf(fp, "\t\"infinity_neg\": %lu,\n", next->infinity_neg);
-      fprintf(fp, "\t\"nan\": %lu,\n", next->nan);
-      fprintf(fp, "\t\"division_zero\": %lu,\n", next->division_zero);
-      fprintf(fp, "\t\"cancellation\": %lu,\n", next->cancellation);
-      fprintf(fp, "\t\"comparison\": %lu,\n", next->comparison);
-      fprintf(fp, "\t\"underflow\": %lu,\n", next->underflow);
-      fprintf(fp, "\t\"latent_infinity_pos\": %lu,\n", next->latent_infinity_pos);
-      fprintf(fp, "\t\"latent_infinity_neg\": %lu,\n", next->latent_infinity_neg);
-      fprintf(fp, "\t\"latent_underflow\": %lu\n", next->latent_underflow);
-
-      next = next->next;
-      printed++;
-
-      if (printed == n)
-        fprintf(fp, "  }\n");
-      else
-        fprintf(fp, "  },\n");
-    }
+  for (uint64_t i=0; i < n; ++i) {
+    _FPC_ITEM_T_ *next = &(items[i]);
+
+    if (i > 0)
+      fprintf(fp, ",\n");
+    fprintf(fp, "  {\n");
+    fprintf(fp, "\t\"input\": \"%s\",\n", prog_input);
+    fprintf(fp, "\t\"file\": \"%s\",\n", next->file_name);
+    fprintf(fp, "\t\"line\": %lu,\n", next->line);
+    if (next->function != NULL)
+      fprintf(fp, "\t\"function\": \"%s\",\n", next->function);
+    if (next->fast_math != 0)
+      _FPC_WRITE_FAST_MATH_(fp, next->fast_math);
+
+    fprintf(fp, "\t\"infinity_pos\": %lu,\n", next->infinity_pos);
+    fprintf(fp, "\t\"infinity_neg\": %lu,\n", next->infinity_neg);
+    fprintf(fp, "\t\"nan\": %lu,\n", next->nan);
+    fprintf(fp, "\t\"division_zero\": %lu,\n", next->division_zero);
+    fprintf(fp, "\t\"cancellation\": %lu,\n", next->cancellation);
+    fprintf(fp, "\t\"comparison\": %lu,\n", next->comparison);
+    fprintf(fp, "\t\"underflow\": %lu,\n", next->underflow);
+    fprintf(fp, "\t\"latent_infinity_pos\": %lu,\n", next->latent_infinity_pos);
+    fprintf(fp, "\t\"latent_infinity_neg\": %lu,\n", next->latent_infinity_neg);
+    fprintf(fp, "\t\"latent_underflow\": %lu,\n", next->latent_underflow);
+    fprintf(fp, "\t\"absorption\": %lu,\n", next->absorption);
+    if (next->absorption > 0)
+      fprintf(fp, "\t\"absorption_gap\": %lu,\n", next->absorption_gap);
+    fprintf(fp, "\t\"executions\": %lu,\n", next->executions);
+    fprintf(fp, "\t\"cycles\": %lu", next->cycles);
+    _FPC_WRITE_EXTENSIONS_(fp, next);
+    fprintf(fp, "\n");
+
+    fprintf(fp, "  }");
   }
 
+  if (n > 0)
+    fprintf(fp, "\n");
   fprintf(fp, "]\n");
   fclose(fp);
+  free(prog_input);
+
+  rename(tmpName, fileName);
+}
+
+void _FPC_PRINT_HASH_TABLE_(_FPC_HTABLE_T *hashtable)
+{
+  _FPC_ITEM_T_ *items = NULL;
+  uint64_t capacity = 0;
+  uint64_t n = _FPC_HT_SNAPSHOT_(hashtable, &items, &capacity);
+  _FPC_WRITE_JSON_TRACE_(items, n);
+  free(items);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Print hash table (binary format)                                           */
+/*----------------------------------------------------------------------------*/
+
+/** String table of a binary trace. Strings are deduplicated by content,
+ * since the same file name may be stored at several addresses. **/
+typedef struct _FPC_TRACE_STRINGS_S_ {
+  char *data;
+  uint64_t size;
+  uint64_t capacity;
+  uint64_t count;       // number of strings
+  uint64_t *slots;      // open addressing: string offset + 1, or 0 if empty
+  uint64_t num_slots;
+} _FPC_TRACE_STRINGS_T_;
+
+uint64_t _FPC_TRACE_HASH_STRING_(const char *str)
+{
+  uint64_t hash = 14695981039346656037ULL; // FNV-1a
+  for (const char *c = str; *c != '\0'; ++c) {
+    hash ^= (uint64_t)(unsigned char)(*c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/** Allocates the slots of a string table. The table always has at least
+ * twice as many slots as strings, so a free slot is always found. **/
+void _FPC_TRACE_STRINGS_SLOTS_(_FPC_TRACE_STRINGS_T_ *strings, uint64_t num_slots)
+{
+  free(strings->slots);
+  strings->num_slots = num_slots;
+  strings->slots = (uint64_t *)calloc(num_slots, sizeof(uint64_t));
+  if (strings->slots == NULL) {
+    printf("#FPCHECKER: trace out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+
+  // Re-insert the strings in the table
+  uint64_t offset = 0;
+  while (offset < strings->size) {
+    uint64_t i = _FPC_TRACE_HASH_STRING_(strings->data + offset) % num_slots;
+    while (strings->slots[i] != 0)
+      i = (i + 1) % num_slots;
+    strings->slots[i] = offset + 1;
+    offset += strlen(strings->data + offset) + 1;
+  }
+}
+
+void _FPC_TRACE_STRINGS_INIT_(_FPC_TRACE_STRINGS_T_ *strings, uint64_t expected)
+{
+  strings->size = 0;
+  strings->count = 0;
+  strings->capacity = 4096;
+  strings->data = (char *)malloc(strings->capacity);
+  strings->slots = NULL;
+  if (strings->data == NULL) {
+    printf("#FPCHECKER: trace out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  _FPC_TRACE_STRINGS_SLOTS_(strings, 2 * (expected + 1) + 1);
+}
+
+/** Adds a string to the table and returns its offset **/
+uint64_t _FPC_TRACE_ADD_STRING_(_FPC_TRACE_STRINGS_T_ *strings, const char *str)
+{
+  if (2 * (strings->count + 1) >= strings->num_slots)
+    _FPC_TRACE_STRINGS_SLOTS_(strings, 2 * strings->num_slots + 1);
+
+  uint64_t i = _FPC_TRACE_HASH_STRING_(str) % strings->num_slots;
+  while (strings->slots[i] != 0) {
+    uint64_t offset = strings->slots[i] - 1;
+    if (strcmp(strings->data + offset, str) == 0)
+      return offset;
+    i = (i + 1) % strings->num_slots;
+  }
+
+  uint64_t len = strlen(str) + 1;
+  if (strings->size + len > strings->capacity) {
+    while (strings->size + len > strings->capacity)
+      strings->capacity *= 2;
+    strings->data = (char *)realloc(strings->data, strings->capacity);
+    if (strings->data == NULL) {
+      printf("#FPCHECKER: trace out of memory error!");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  uint64_t offset = strings->size;
+  memcpy(strings->data + offset, str, len);
+  strings->size += len;
+  strings->count++;
+  strings->slots[i] = offset + 1;
+  return offset;
+}
+
+/** Adds the optional objects of a location to the string table as a JSON
+ * object (the "extensions" field). Returns the offset of the empty string
+ * if the location has none. **/
+uint64_t _FPC_TRACE_ADD_EXTENSIONS_(_FPC_TRACE_STRINGS_T_ *strings, _FPC_ITEM_T_ *item)
+{
+  if (!_FPC_ITEM_HAS_EXTENSIONS_(item))
+    return _FPC_TRACE_ADD_STRING_(strings, "");
+
+  char *json = NULL;
+  size_t size = 0;
+  FILE *fp = open_memstream(&json, &size);
+  if (fp == NULL) {
+    printf("#FPCHECKER: trace out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  fprintf(fp, "{");
+  _FPC_WRITE_EXTENSIONS_(fp, item);
+  fprintf(fp, "}");
+  fclose(fp);
+
+  // Drop the comma before the first object
+  json[1] = ' ';
+  uint64_t offset = _FPC_TRACE_ADD_STRING_(strings, json);
+  free(json);
+  return offset;
+}
+
+/** Builds a binary trace with the locations in memory (see
+ * FPC_TraceFormat.h). Returns the trace; the caller frees it. **/
+char *_FPC_BUILD_BINARY_TRACE_(_FPC_ITEM_T_ *items, uint64_t n, uint64_t *size)
+{
+  const char *field_names[] = { _FPC_TRACE_FIELDS_ };
+  const uint64_t num_fields = _FPC_TRACE_NUM_FIELDS_;
+
+  _FPC_TRACE_STRINGS_T_ strings;
+  _FPC_TRACE_STRINGS_INIT_(&strings, n + num_fields + 1);
+  uint64_t *words = (uint64_t *)malloc(sizeof(uint64_t) * num_fields * (n + 1));
+  if (words == NULL) {
+    printf("#FPCHECKER: trace out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+
+  // Field names go first, followed by the records
+  uint64_t *fields = words;
+  for (uint64_t f=0; f < num_fields; ++f)
+    fields[f] = _FPC_TRACE_ADD_STRING_(&strings, field_names[f]);
+
+  char *prog_input = _FPC_PROG_INPUT_STRING_();
+  uint64_t input = _FPC_TRACE_ADD_STRING_(&strings, prog_input);
+  free(prog_input);
+
+  uint64_t *record = words + num_fields;
+  for (uint64_t i=0; i < n; ++i) {
+    _FPC_ITEM_T_ *next = &(items[i]);
+    char fast_math[128];
+    _FPC_FAST_MATH_STRING_(fast_math, next->fast_math);
+    record[0]  = input;
+    record[1]  = _FPC_TRACE_ADD_STRING_(&strings, next->file_name);
+    record[2]  = _FPC_TRACE_ADD_STRING_(&strings, (next->function != NULL) ? next->function : "");
+    record[3]  = _FPC_TRACE_ADD_STRING_(&strings, fast_math);
+    record[4]  = _FPC_TRACE_ADD_EXTENSIONS_(&strings, next);
+    record[5]  = next->line;
+    record[6]  = next->infinity_pos;
+    record[7]  = next->infinity_neg;
+    record[8]  = next->nan;
+    record[9]  = next->division_zero;
+    record[10] = next->cancellation;
+    record[11] = next->comparison;
+    record[12] = next->underflow;
+    record[13] = next->latent_infinity_pos;
+    record[14] = next->latent_infinity_neg;
+    record[15] = next->latent_underflow;
+    record[16] = next->absorption;
+    record[17] = next->executions;
+    record[18] = next->cycles;
+    record[19] = next->absorption_gap;
+    record += num_fields;
+  }
+
+  // Build the file in memory: header, fields, records, strings
+  _FPC_TRACE_HEADER_T_ header;
+  memset((void *)&header, 0, sizeof(header));
+  memcpy(header.magic, _FPC_TRACE_MAGIC_, sizeof(header.magic));
+  header.version = _FPC_TRACE_VERSION_;
+  header.num_fields = (uint32_t)num_fields;
+  header.num_string_fields = _FPC_TRACE_NUM_STRING_FIELDS_;
+  header.num_records = n;
+  header.fields_offset = sizeof(header);
+  header.records_offset = header.fields_offset + sizeof(uint64_t) * num_fields;
+  header.strings_offset = header.records_offset + sizeof(uint64_t) * num_fields * n;
+  header.strings_size = strings.size;
+  header.file_size = header.strings_offset + strings.size;
+
+  char *buffer = (char *)malloc(header.file_size);
+  if (buffer == NULL) {
+    printf("#FPCHECKER: trace out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  memcpy(buffer, &header, sizeof(header));
+  memcpy(buffer + header.fields_offset, words, header.strings_offset - header.fields_offset);
+  memcpy(buffer + header.strings_offset, strings.data, strings.size);
+  free(words);
+  free(strings.data);
+  free(strings.slots);
+
+  *size = header.file_size;
+  return buffer;
+}
+
+/** Writes size bytes to a file or socket. Returns 0 on errors. **/
+int _FPC_WRITE_ALL_(int fd, const char *buffer, uint64_t size)
+{
+  uint64_t written = 0;
+  while (written < size) {
+    ssize_t ret = write(fd, buffer + written, size - written);
+    if (ret <= 0)
+      return 0;
+    written += (uint64_t)ret;
+  }
+  return 1;
+}
+
+/** Writes the locations to the binary trace of this process. The trace is
+ * built in memory and saved with a single write to a temporary file that
+ * replaces the trace. **/
+void _FPC_WRITE_BINARY_TRACE_(_FPC_ITEM_T_ *items, uint64_t n)
+{
+  char fileName[5000];
+  char tmpName[5010];
+  _FPC_TRACE_FILE_NAME_(fileName, _FPC_TRACE_EXTENSION_);
+  sprintf(tmpName, "%s.tmp", fileName);
+
+  uint64_t size = 0;
+  char *buffer = _FPC_BUILD_BINARY_TRACE_(items, n, &size);
+
+  int fd = open(tmpName, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+  if (fd == -1) {
+    printf("#FPCHECKER: could not create trace: %s\n", fileName);
+    free(buffer);
+    return;
+  }
+  int ok = _FPC_WRITE_ALL_(fd, buffer, size);
+  if (!ok)
+    printf("#FPCHECKER: could not write trace: %s\n", fileName);
+  close(fd);
+  free(buffer);
+
+  if (ok)
+    rename(tmpName, fileName);
+}
+
+void _FPC_PRINT_HASH_TABLE_BINARY_(_FPC_HTABLE_T *hashtable)
+{
+  _FPC_ITEM_T_ *items = NULL;
+  uint64_t capacity = 0;
+  uint64_t n = _FPC_HT_SNAPSHOT_(hashtable, &items, &capacity);
+  _FPC_WRITE_BINARY_TRACE_(items, n);
+  free(items);
 }
 
 #endif /* SRC_FPC_HASHTABLE_H_ */
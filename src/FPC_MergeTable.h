@@ -0,0 +1,363 @@
+#ifndef SRC_FPC_MERGETABLE_H_
+#define SRC_FPC_MERGETABLE_H_
+
+#include "FPC_Hashtable.h"
+
+/*----------------------------------------------------------------------------*/
+/* Merged tables                                                              */
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Tables of several processes merged by (file, line). They are used to
+ * reduce the tables of MPI ranks (Runtime_mpi.h) and to merge the traces
+ * of the processes of a node (FPC_LOCAL_DIR).
+ *
+ * Each location has the sum of the counters of all the processes, plus
+ * the minimum and maximum over the processes that saved the location and,
+ * for MPI ranks, the set of ranks that saved it.
+ **/
+
+#define _FPC_MERGE_COUNTERS_  13    // events, executions, cycles
+
+#define _FPC_MERGE_COUNTER_NAMES_ \
+  "infinity_pos", "infinity_neg", "nan", "division_zero", "cancellation", \
+  "comparison", "underflow", "latent_infinity_pos", "latent_infinity_neg", \
+  "latent_underflow", "absorption", "executions", "cycles"
+
+/** Each location is stored in site_words words:
+ *   file (offset in strings), line, sum[13], min[13], max[13], ranks bitset **/
+typedef struct _FPC_MERGE_TABLE_S_ {
+  _FPC_TRACE_STRINGS_T_ strings;
+  uint64_t *words;
+  uint64_t n;               // number of locations
+  uint64_t capacity;
+  uint64_t rank_words;      // words of the ranks bitset (0 without ranks)
+  uint64_t site_words;
+  uint64_t *slots;          // open addressing: location index + 1, or 0 if empty
+  uint64_t num_slots;
+} _FPC_MERGE_TABLE_T_;
+
+#define _FPC_MERGE_SITE_(t, i)  ((t)->words + (i) * (t)->site_words)
+#define _FPC_MERGE_SUM_(s)      ((s) + 2)
+#define _FPC_MERGE_MIN_(s)      ((s) + 2 + _FPC_MERGE_COUNTERS_)
+#define _FPC_MERGE_MAX_(s)      ((s) + 2 + 2 * _FPC_MERGE_COUNTERS_)
+#define _FPC_MERGE_RANKS_(s)    ((s) + 2 + 3 * _FPC_MERGE_COUNTERS_)
+
+void _FPC_MERGE_INIT_(_FPC_MERGE_TABLE_T_ *table, int num_ranks) {
+  _FPC_TRACE_STRINGS_INIT_(&(table->strings), 64);
+  table->n = 0;
+  table->capacity = 0;
+  table->words = NULL;
+  table->rank_words = ((uint64_t)num_ranks + 63) / 64;
+  table->site_words = 2 + 3 * _FPC_MERGE_COUNTERS_ + table->rank_words;
+  table->num_slots = 0;
+  table->slots = NULL;
+}
+
+void _FPC_MERGE_FREE_(_FPC_MERGE_TABLE_T_ *table) {
+  free(table->strings.data);
+  free(table->strings.slots);
+  free(table->words);
+  free(table->slots);
+}
+
+uint64_t _FPC_MERGE_HASH_(uint64_t file, uint64_t line) {
+  uint64_t key = file * 0x9E3779B97F4A7C15ULL + line;
+  return key ^ (key >> 29);
+}
+
+/** Returns the location (file, line), inserting an empty one if needed **/
+uint64_t *_FPC_MERGE_GET_SITE_(_FPC_MERGE_TABLE_T_ *table, const char *file_name, uint64_t line) {
+  uint64_t file = _FPC_TRACE_ADD_STRING_(&(table->strings), file_name);
+
+  // Grow: at least twice as many slots as locations
+  if (2 * (table->n + 1) >= table->num_slots) {
+    free(table->slots);
+    table->num_slots = 2 * table->num_slots + 64;
+    table->slots = (uint64_t *)calloc(table->num_slots, sizeof(uint64_t));
+    if (table->slots == NULL) {
+      printf("#FPCHECKER: merge table out of memory error!");
+      exit(EXIT_FAILURE);
+    }
+    for (uint64_t k = 0; k < table->n; ++k) {
+      uint64_t *site = _FPC_MERGE_SITE_(table, k);
+      uint64_t i = _FPC_MERGE_HASH_(site[0], site[1]) % table->num_slots;
+      while (table->slots[i] != 0)
+        i = (i + 1) % table->num_slots;
+      table->slots[i] = k + 1;
+    }
+  }
+
+  uint64_t i = _FPC_MERGE_HASH_(file, line) % table->num_slots;
+  while (table->slots[i] != 0) {
+    uint64_t *site = _FPC_MERGE_SITE_(table, table->slots[i] - 1);
+    if (site[0] == file && site[1] == line)
+      return site;
+    i = (i + 1) % table->num_slots;
+  }
+
+  if (table->n == table->capacity) {
+    table->capacity = (table->capacity == 0) ? 256 : (2 * table->capacity);
+    table->words = (uint64_t *)realloc(table->words,
+        sizeof(uint64_t) * table->site_words * table->capacity);
+    if (table->words == NULL) {
+      printf("#FPCHECKER: merge table out of memory error!");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  uint64_t *site = _FPC_MERGE_SITE_(table, table->n);
+  memset((void *)site, 0, sizeof(uint64_t) * table->site_words);
+  site[0] = file;
+  site[1] = line;
+  for (int c = 0; c < _FPC_MERGE_COUNTERS_; ++c)
+    _FPC_MERGE_MIN_(site)[c] = UINT64_MAX;
+  table->slots[i] = table->n + 1;
+  table->n++;
+  return site;
+}
+
+/** Merges the locations of src into table. Both have the same ranks. **/
+void _FPC_MERGE_TABLES_(_FPC_MERGE_TABLE_T_ *table, _FPC_MERGE_TABLE_T_ *src) {
+  for (uint64_t k = 0; k < src->n; ++k) {
+    uint64_t *other = _FPC_MERGE_SITE_(src, k);
+    uint64_t *site = _FPC_MERGE_GET_SITE_(table, src->strings.data + other[0], other[1]);
+    for (int c = 0; c < _FPC_MERGE_COUNTERS_; ++c) {
+      _FPC_MERGE_SUM_(site)[c] += _FPC_MERGE_SUM_(other)[c];
+      if (_FPC_MERGE_MIN_(other)[c] < _FPC_MERGE_MIN_(site)[c])
+        _FPC_MERGE_MIN_(site)[c] = _FPC_MERGE_MIN_(other)[c];
+      if (_FPC_MERGE_MAX_(other)[c] > _FPC_MERGE_MAX_(site)[c])
+        _FPC_MERGE_MAX_(site)[c] = _FPC_MERGE_MAX_(other)[c];
+    }
+    for (uint64_t w = 0; w < table->rank_words; ++w)
+      _FPC_MERGE_RANKS_(site)[w] |= _FPC_MERGE_RANKS_(other)[w];
+  }
+}
+
+/** Merges the counters of the locations of one process. A process may
+ * have several items for a location (e.g., with different file name
+ * addresses); they are added before the minimum and maximum are taken.
+ * values has _FPC_MERGE_COUNTERS_ counters per location. **/
+void _FPC_MERGE_PROCESS_(_FPC_MERGE_TABLE_T_ *table, const char **files,
+                         uint64_t *lines, uint64_t *values, uint64_t n, int rank) {
+  _FPC_MERGE_TABLE_T_ local;
+  _FPC_MERGE_INIT_(&local, (int)(table->rank_words * 64));
+  for (uint64_t k = 0; k < n; ++k) {
+    uint64_t *site = _FPC_MERGE_GET_SITE_(&local, files[k], lines[k]);
+    for (int c = 0; c < _FPC_MERGE_COUNTERS_; ++c) {
+      _FPC_MERGE_SUM_(site)[c] += values[k * _FPC_MERGE_COUNTERS_ + c];
+      _FPC_MERGE_MIN_(site)[c] = _FPC_MERGE_SUM_(site)[c];
+      _FPC_MERGE_MAX_(site)[c] = _FPC_MERGE_SUM_(site)[c];
+    }
+    if (local.rank_words > 0)
+      _FPC_MERGE_RANKS_(site)[rank / 64] |= (1ULL << (rank % 64));
+  }
+  _FPC_MERGE_TABLES_(table, &local);
+  _FPC_MERGE_FREE_(&local);
+}
+
+/** Merges the locations of this process **/
+void _FPC_MERGE_ITEMS_(_FPC_MERGE_TABLE_T_ *table, _FPC_ITEM_T_ *items, uint64_t n, int rank) {
+  const char **files = (const char **)malloc(sizeof(char *) * (n + 1));
+  uint64_t *lines = (uint64_t *)malloc(sizeof(uint64_t) * (n + 1));
+  uint64_t *values = (uint64_t *)malloc(sizeof(uint64_t) * _FPC_MERGE_COUNTERS_ * (n + 1));
+  if (files == NULL || lines == NULL || values == NULL) {
+    printf("#FPCHECKER: merge table out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+
+  for (uint64_t k = 0; k < n; ++k) {
+    _FPC_ITEM_T_ *item = &(items[k]);
+    uint64_t *v = values + k * _FPC_MERGE_COUNTERS_;
+    files[k] = item->file_name;
+    lines[k] = item->line;
+    v[0] = item->infinity_pos;
+    v[1] = item->infinity_neg;
+    v[2] = item->nan;
+    v[3] = item->division_zero;
+    v[4] = item->cancellation;
+    v[5] = item->comparison;
+    v[6] = item->underflow;
+    v[7] = item->latent_infinity_pos;
+    v[8] = item->latent_infinity_neg;
+    v[9] = item->latent_underflow;
+    v[10] = item->absorption;
+    v[11] = item->executions;
+    v[12] = item->cycles;
+  }
+  _FPC_MERGE_PROCESS_(table, files, lines, values, n, rank);
+
+  free(files);
+  free(lines);
+  free(values);
+}
+
+/** Merges the binary trace of a process (see FPC_TraceFormat.h).
+ * Returns 0 if the file is not a valid trace. **/
+int _FPC_MERGE_BINARY_TRACE_(_FPC_MERGE_TABLE_T_ *table, const char *fileName) {
+  FILE *fp = fopen(fileName, "rb");
+  if (fp == NULL)
+    return 0;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (size < (long)sizeof(_FPC_TRACE_HEADER_T_)) {
+    fclose(fp);
+    return 0;
+  }
+  char *data = (char *)malloc((size_t)size);
+  if (data == NULL || fread(data, 1, (size_t)size, fp) != (size_t)size) {
+    free(data);
+    fclose(fp);
+    return 0;
+  }
+  fclose(fp);
+
+  // Traces written by this runtime: the counters follow the line
+  _FPC_TRACE_HEADER_T_ *h = (_FPC_TRACE_HEADER_T_ *)data;
+  if (memcmp(h->magic, _FPC_TRACE_MAGIC_, sizeof(h->magic)) != 0 ||
+      h->version != _FPC_TRACE_VERSION_ || h->file_size != (uint64_t)size ||
+      h->num_fields != _FPC_TRACE_NUM_FIELDS_ ||
+      h->strings_offset + h->strings_size != (uint64_t)size || data[size - 1] != '\0' ||
+      h->num_records > (uint64_t)size / (sizeof(uint64_t) * h->num_fields) ||
+      h->records_offset + sizeof(uint64_t) * h->num_fields * h->num_records > h->strings_offset) {
+    free(data);
+    return 0;
+  }
+
+  uint64_t n = h->num_records;
+  const char *strings = data + h->strings_offset;
+  uint64_t *records = (uint64_t *)(data + h->records_offset);
+  const char **files = (const char **)malloc(sizeof(char *) * (n + 1));
+  uint64_t *lines = (uint64_t *)malloc(sizeof(uint64_t) * (n + 1));
+  uint64_t *values = (uint64_t *)malloc(sizeof(uint64_t) * _FPC_MERGE_COUNTERS_ * (n + 1));
+  if (files == NULL || lines == NULL || values == NULL) {
+    printf("#FPCHECKER: merge table out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  for (uint64_t k = 0; k < n; ++k) {
+    uint64_t *record = records + k * h->num_fields;
+    uint64_t file = record[_FPC_TRACE_FILE_FIELD_];
+    files[k] = (file < h->strings_size) ? (strings + file) : "";
+    lines[k] = record[_FPC_TRACE_LINE_FIELD_];
+    memcpy((void *)(values + k * _FPC_MERGE_COUNTERS_), (void *)(record + _FPC_TRACE_FIRST_EVENT_),
+           sizeof(uint64_t) * _FPC_MERGE_COUNTERS_);
+  }
+  _FPC_MERGE_PROCESS_(table, files, lines, values, n, 0);
+
+  free(files);
+  free(lines);
+  free(values);
+  free(data);
+  return 1;
+}
+
+/** Message with a table: n, strings size, locations, strings (padded to
+ * words). Returns the number of words. **/
+uint64_t _FPC_MERGE_PACK_(_FPC_MERGE_TABLE_T_ *table, uint64_t **msg) {
+  uint64_t site_words = table->n * table->site_words;
+  uint64_t string_words = (table->strings.size + 7) / 8;
+  uint64_t size = 2 + site_words + string_words;
+  *msg = (uint64_t *)calloc(size, sizeof(uint64_t));
+  if (*msg == NULL) {
+    printf("#FPCHECKER: merge table out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  (*msg)[0] = table->n;
+  (*msg)[1] = table->strings.size;
+  if (site_words > 0)
+    memcpy((void *)(*msg + 2), (void *)table->words, sizeof(uint64_t) * site_words);
+  memcpy((void *)(*msg + 2 + site_words), (void *)table->strings.data, table->strings.size);
+  return size;
+}
+
+/** Merges a message of _FPC_MERGE_PACK_ with the same ranks **/
+void _FPC_MERGE_UNPACK_(_FPC_MERGE_TABLE_T_ *table, uint64_t *msg) {
+  _FPC_MERGE_TABLE_T_ src;
+  memset((void *)&src, 0, sizeof(src));
+  src.n = msg[0];
+  src.rank_words = table->rank_words;
+  src.site_words = table->site_words;
+  src.words = msg + 2;
+  src.strings.data = (char *)(msg + 2 + src.n * src.site_words);
+  src.strings.size = msg[1];
+  _FPC_MERGE_TABLES_(table, &src);
+}
+
+/** Writes the ranks bitset as ranges, e.g., "0-3,6" **/
+void _FPC_MERGE_PRINT_RANKS_(FILE *fp, uint64_t *ranks, int num_ranks) {
+  int first = 1;
+  int r = 0;
+  while (r < num_ranks) {
+    if (!(ranks[r / 64] & (1ULL << (r % 64)))) {
+      r++;
+      continue;
+    }
+    int end = r;
+    while (end + 1 < num_ranks && (ranks[(end + 1) / 64] & (1ULL << ((end + 1) % 64))))
+      end++;
+    if (!first)
+      fprintf(fp, ",");
+    if (end == r)
+      fprintf(fp, "%d", r);
+    else
+      fprintf(fp, "%d-%d", r, end);
+    first = 0;
+    r = end + 1;
+  }
+}
+
+/** Writes a JSON trace with the merged locations. The ranks are only
+ * written when the table has ranks (num_ranks > 0). **/
+void _FPC_MERGE_WRITE_TRACE_(_FPC_MERGE_TABLE_T_ *table, const char *fileName, int num_ranks) {
+  const char *names[_FPC_MERGE_COUNTERS_] = { _FPC_MERGE_COUNTER_NAMES_ };
+
+  char tmpName[5010];
+  sprintf(tmpName, "%s.tmp", fileName);
+  char *prog_input = _FPC_PROG_INPUT_STRING_();
+
+  FILE *fp = fopen(tmpName, "w");
+  if (fp == NULL) {
+    printf("#FPCHECKER: could not create trace: %s\n", fileName);
+    free(prog_input);
+    return;
+  }
+
+  fprintf(fp, "[\n");
+  for (uint64_t k = 0; k < table->n; ++k) {
+    uint64_t *site = _FPC_MERGE_SITE_(table, k);
+    if (k > 0)
+      fprintf(fp, ",\n");
+    fprintf(fp, "  {\n");
+    fprintf(fp, "\t\"input\": \"%s\",\n", prog_input);
+    fprintf(fp, "\t\"file\": \"%s\",\n", table->strings.data + site[0]);
+    fprintf(fp, "\t\"line\": %lu,\n", site[1]);
+    for (int c = 0; c < _FPC_MERGE_COUNTERS_; ++c)
+      fprintf(fp, "\t\"%s\": %lu,\n", names[c], _FPC_MERGE_SUM_(site)[c]);
+
+    if (num_ranks > 0) {
+      fprintf(fp, "\t\"ranks\": \"");
+      _FPC_MERGE_PRINT_RANKS_(fp, _FPC_MERGE_RANKS_(site), num_ranks);
+      fprintf(fp, "\",\n");
+    }
+
+    fprintf(fp, "\t\"min\": {");
+    for (int c = 0; c < _FPC_MERGE_COUNTERS_; ++c)
+      fprintf(fp, "%s\"%s\": %lu", (c > 0 ? ", " : ""), names[c], _FPC_MERGE_MIN_(site)[c]);
+    fprintf(fp, "},\n");
+    fprintf(fp, "\t\"max\": {");
+    for (int c = 0; c < _FPC_MERGE_COUNTERS_; ++c)
+      fprintf(fp, "%s\"%s\": %lu", (c > 0 ? ", " : ""), names[c], _FPC_MERGE_MAX_(site)[c]);
+    fprintf(fp, "}\n");
+    fprintf(fp, "  }");
+  }
+  if (table->n > 0)
+    fprintf(fp, "\n");
+  fprintf(fp, "]\n");
+  fclose(fp);
+  free(prog_input);
+
+  rename(tmpName, fileName);
+}
+
+#endif /* SRC_FPC_MERGETABLE_H_ */
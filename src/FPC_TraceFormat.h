@@ -0,0 +1,72 @@
+#ifndef SRC_FPC_TRACEFORMAT_H_
+#define SRC_FPC_TRACEFORMAT_H_
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------*/
+/* Binary trace format                                                        */
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Layout of a binary trace (FPC_TRACE_FORMAT=binary). All values are in the
+ * byte order of the machine that wrote the trace (little-endian on the
+ * platforms we support).
+ *
+ *   header    _FPC_TRACE_HEADER_T_ (72 bytes)
+ *   fields    num_fields x uint64_t: offset of each field name in the
+ *             string table
+ *   records   num_records x num_fields x uint64_t
+ *   strings   NUL-terminated strings (field names, program input, files)
+ *
+ * The first num_string_fields fields of a record are offsets in the string
+ * table; the remaining fields are counters. Field names follow the JSON
+ * traces, so readers can convert a binary trace to JSON without knowing the
+ * fields in advance. The optional members of the JSON traces are stored as
+ * strings, empty when the JSON trace does not have them:
+ *   function    math function called at the location
+ *   fast_math   fast-math flags, e.g., "nnan,ninf"
+ *   extensions  JSON object with the other members (occurrences, ranges,
+ *               emulation, shadow, perturbation, denormals, conversion)
+ * absorption_gap is only meaningful when absorption is not 0.
+ *
+ * Version 1 traces did not have function, fast_math, extensions and
+ * absorption_gap.
+ **/
+
+#define _FPC_TRACE_MAGIC_         "FPCTRACE"
+#define _FPC_TRACE_VERSION_       2
+#define _FPC_TRACE_EXTENSION_     ".fpcb"
+
+#define _FPC_TRACE_FIELDS_ \
+  "input", "file", "function", "fast_math", "extensions", "line", \
+  "infinity_pos", "infinity_neg", "nan", "division_zero", "cancellation", \
+  "comparison", "underflow", "latent_infinity_pos", "latent_infinity_neg", \
+  "latent_underflow", "absorption", "executions", "cycles", "absorption_gap"
+
+#define _FPC_TRACE_NUM_FIELDS_         20
+#define _FPC_TRACE_NUM_STRING_FIELDS_  5
+
+// Indices of the fields written by the runtime
+#define _FPC_TRACE_INPUT_FIELD_        0
+#define _FPC_TRACE_FILE_FIELD_         1
+#define _FPC_TRACE_FUNCTION_FIELD_     2
+#define _FPC_TRACE_FAST_MATH_FIELD_    3
+#define _FPC_TRACE_EXTENSIONS_FIELD_   4
+#define _FPC_TRACE_LINE_FIELD_         5
+#define _FPC_TRACE_FIRST_EVENT_        6   // events, executions, cycles follow
+
+typedef struct _FPC_TRACE_HEADER_S_ {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_fields;          // 64-bit words per record
+  uint32_t num_string_fields;   // leading fields that are string offsets
+  uint32_t reserved;
+  uint64_t num_records;
+  uint64_t fields_offset;       // offsets are from the beginning of the file
+  uint64_t records_offset;
+  uint64_t strings_offset;
+  uint64_t strings_size;
+  uint64_t file_size;
+} _FPC_TRACE_HEADER_T_;
+
+#endif /* SRC_FPC_TRACEFORMAT_H_ */
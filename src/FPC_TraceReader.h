@@ -0,0 +1,195 @@
+#ifndef SRC_FPC_TRACEREADER_H_
+#define SRC_FPC_TRACEREADER_H_
+
+/**
+ * Header-only reader of binary traces (FPC_TRACE_FORMAT=binary).
+ *
+ * The trace is memory-mapped and records are read in place:
+ *
+ *   FPChecker::TraceReader trace(".fpc_logs/fpc_node_1234.fpcb");
+ *   int nan = trace.fieldIndex("nan");
+ *   for (auto record : trace)
+ *     if (record[nan] != 0)
+ *       printf("%s:%lu\n", record.file(), record.line());
+ *
+ * Errors (missing file, invalid trace) throw std::runtime_error.
+ **/
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FPC_TraceFormat.h"
+
+namespace FPChecker {
+
+class TraceReader {
+public:
+
+  /** View of a record in the mapped trace **/
+  class Record {
+  public:
+    Record(const TraceReader *r, const uint64_t *w) : reader(r), words(w) {}
+
+    uint64_t operator[](uint32_t field) const { return words[field]; }
+    /// Value of a field by name; 0 if the trace does not have the field
+    uint64_t get(const char *name) const {
+      int field = reader->fieldIndex(name);
+      return field < 0 ? 0 : words[field];
+    }
+    /// String of a string field (see TraceReader::isStringField)
+    const char *string(uint32_t field) const { return reader->string(words[field]); }
+
+    const char *input() const { return string(_FPC_TRACE_INPUT_FIELD_); }
+    const char *file() const { return string(_FPC_TRACE_FILE_FIELD_); }
+    uint64_t line() const { return words[_FPC_TRACE_LINE_FIELD_]; }
+    /// Math function, fast-math flags and JSON object with the other
+    /// members; empty strings if the location does not have them
+    const char *function() const { return string(_FPC_TRACE_FUNCTION_FIELD_); }
+    const char *fastMath() const { return string(_FPC_TRACE_FAST_MATH_FIELD_); }
+    const char *extensions() const { return string(_FPC_TRACE_EXTENSIONS_FIELD_); }
+
+  private:
+    const TraceReader *reader;
+    const uint64_t *words;
+  };
+
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Record;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Record;
+
+    iterator(const TraceReader *r, const uint64_t *w) : reader(r), words(w) {}
+    Record operator*() const { return Record(reader, words); }
+    iterator &operator++() { words += reader->numFields(); return *this; }
+    iterator operator++(int) { iterator old = *this; ++(*this); return old; }
+    bool operator==(const iterator &other) const { return words == other.words; }
+    bool operator!=(const iterator &other) const { return words != other.words; }
+
+  private:
+    const TraceReader *reader;
+    const uint64_t *words;
+  };
+
+  explicit TraceReader(const std::string &fileName) : data(nullptr), length(0) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd == -1)
+      throw std::runtime_error("cannot open trace: " + fileName);
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(_FPC_TRACE_HEADER_T_)) {
+      close(fd);
+      throw std::runtime_error("invalid trace: " + fileName);
+    }
+
+    length = (size_t)st.st_size;
+    void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+      throw std::runtime_error("cannot map trace: " + fileName);
+    data = (const char *)addr;
+
+    if (!isValid()) {
+      munmap((void *)data, length);
+      throw std::runtime_error("invalid trace: " + fileName);
+    }
+  }
+
+  ~TraceReader() {
+    if (data != nullptr)
+      munmap((void *)data, length);
+  }
+
+  TraceReader(const TraceReader &) = delete;
+  TraceReader &operator=(const TraceReader &) = delete;
+
+  TraceReader(TraceReader &&other) : data(other.data), length(other.length) {
+    other.data = nullptr;
+    other.length = 0;
+  }
+
+  const _FPC_TRACE_HEADER_T_ &header() const {
+    return *(const _FPC_TRACE_HEADER_T_ *)data;
+  }
+
+  uint64_t size() const { return header().num_records; }
+  uint32_t numFields() const { return header().num_fields; }
+  bool isStringField(uint32_t field) const { return field < header().num_string_fields; }
+
+  const char *fieldName(uint32_t field) const {
+    const uint64_t *fields = (const uint64_t *)(data + header().fields_offset);
+    return string(fields[field]);
+  }
+
+  /// Index of a field, or -1 if the trace does not have it
+  int fieldIndex(const char *name) const {
+    for (uint32_t f = 0; f < numFields(); ++f)
+      if (strcmp(fieldName(f), name) == 0)
+        return (int)f;
+    return -1;
+  }
+
+  const char *string(uint64_t offset) const {
+    return data + header().strings_offset + offset;
+  }
+
+  Record operator[](uint64_t i) const {
+    return Record(this, records() + i * numFields());
+  }
+
+  iterator begin() const { return iterator(this, records()); }
+  iterator end() const { return iterator(this, records() + size() * numFields()); }
+
+private:
+  const char *data;
+  size_t length;
+
+  const uint64_t *records() const {
+    return (const uint64_t *)(data + header().records_offset);
+  }
+
+  bool isValid() const {
+    const _FPC_TRACE_HEADER_T_ &h = header();
+    if (memcmp(h.magic, _FPC_TRACE_MAGIC_, sizeof(h.magic)) != 0 ||
+        h.version != _FPC_TRACE_VERSION_ || h.file_size != length ||
+        h.num_fields <= _FPC_TRACE_LINE_FIELD_ ||
+        h.num_string_fields != _FPC_TRACE_NUM_STRING_FIELDS_)
+      return false;
+
+    // Sections must be in order, aligned, and inside the file
+    uint64_t fieldsSize = sizeof(uint64_t) * h.num_fields;
+    if (h.num_records > (length / fieldsSize))
+      return false;
+    if (h.fields_offset < sizeof(h) || h.fields_offset % 8 != 0 ||
+        h.records_offset != h.fields_offset + fieldsSize ||
+        h.strings_offset != h.records_offset + fieldsSize * h.num_records ||
+        h.strings_offset + h.strings_size != length || h.strings_size == 0 ||
+        data[length - 1] != '\0')
+      return false;
+
+    // String offsets must be inside the string table
+    const uint64_t *fields = (const uint64_t *)(data + h.fields_offset);
+    for (uint32_t f = 0; f < h.num_fields; ++f)
+      if (fields[f] >= h.strings_size)
+        return false;
+    for (uint64_t i = 0; i < h.num_records; ++i)
+      for (uint32_t f = 0; f < h.num_string_fields; ++f)
+        if (records()[i * h.num_fields + f] >= h.strings_size)
+          return false;
+    return true;
+  }
+};
+
+} // namespace FPChecker
+
+#endif /* SRC_FPC_TRACEREADER_H_ */
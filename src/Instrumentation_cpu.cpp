@@ -11,12 +11,21 @@
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/GlobalValue.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/Demangle/Demangle.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
 
 #include <list>
 #include <string>
@@ -25,6 +34,17 @@ using namespace CPUAnalysis;
 //using namespace CUDAAnalysis;
 using namespace llvm;
 
+/* Sets the linkage of a runtime function or global, which is defined in
+every translation unit. Declarations (in a ThinLTO backend, the runtime of
+the other modules) are not changed. */
+static void setRuntimeLinkage(GlobalValue *gv, GlobalValue::LinkageTypes linkage)
+{
+  if (gv->isDeclaration())
+    return;
+  if (gv->getLinkage() != linkage)
+    gv->setLinkage(linkage);
+}
+
 /* This function configures the function found (e.g., calling conventions) and
 saves pointer if needed. We also do logging. */
 void confFunction(Function *found, Function **saveHere,
@@ -37,8 +57,7 @@ void confFunction(Function *found, Function **saveHere,
 
   if (saveHere != nullptr) // if we want to save the function pointer
   	*saveHere = found;
-  if (found->getLinkage() != linkage)
-  	found->setLinkage(linkage);
+  setRuntimeLinkage(found, linkage);
 }
 
 /** Set linkage as ODR **/
@@ -49,17 +68,47 @@ void confFunction(Function *found, Function **saveHere,
 //}
 #define SET_ODR_LIKAGE(name) \
     if (f->getName().str().find(name) != std::string::npos) { \
-      f->setLinkage(GlobalValue::LinkageTypes::LinkOnceODRLinkage); \
+      setRuntimeLinkage(f, GlobalValue::LinkageTypes::LinkOnceODRLinkage); \
     }
 
 CPUFPInstrumentation::CPUFPInstrumentation(Module *M) :
 		mod(M),
 		fp32_check_function(nullptr),
 		fp64_check_function(nullptr),
+		fp32_fma_check_function(nullptr),
+		fp64_fma_check_function(nullptr),
+		fp32_call_check_function(nullptr),
+		fp64_call_check_function(nullptr),
+		fp64_trunc_check_function(nullptr),
+		fp32_toint_check_function(nullptr),
+		fp64_toint_check_function(nullptr),
+		fp16_check_function(nullptr),
+		bf16_check_function(nullptr),
+		fp80_check_function(nullptr),
+		fp128_check_function(nullptr),
+		fp16_trunc_check_function(nullptr),
+		bf16_trunc_check_function(nullptr),
+		fp16_toint_check_function(nullptr),
+		bf16_toint_check_function(nullptr),
 		//fpc_init_htable(nullptr),
 		fpc_init(nullptr),
 		fpc_init_args(nullptr),
-		fpc_print_locations(nullptr) {
+		fpc_print_locations(nullptr),
+		fp32_emulate_function(nullptr),
+		fp64_emulate_function(nullptr),
+		fp32_shadow_function(nullptr),
+		fp64_shadow_function(nullptr),
+		fp32_perturb_function(nullptr),
+		fp64_perturb_function(nullptr),
+		emulatedFormat(-1),
+		emulatedOps(0),
+		shadowMode(false),
+		shadowedOps(0),
+		perturbMode(false),
+		perturbedOps(0), unlocatedOps(0) {
+
+  const char *lto = getenv("FPC_LTO");
+  ltoMode = (lto != NULL && std::string(lto) != "0");
 
 #ifdef FPC_DEBUG
   CUDAAnalysis::Logging::info("Initializing instrumentation");
@@ -79,6 +128,81 @@ CPUFPInstrumentation::CPUFPInstrumentation(Module *M) :
       confFunction(f, &fp64_check_function,
       GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP64_CHECK_");
     }
+    if (f->getName().str().find("_FPC_FP32_FMA_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp32_fma_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP32_FMA_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_FP64_FMA_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp64_fma_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP64_FMA_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_FP32_CALL_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp32_call_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP32_CALL_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_FP64_CALL_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp64_call_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP64_CALL_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_FP64_TRUNC_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp64_trunc_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP64_TRUNC_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_FP32_TOINT_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp32_toint_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP32_TOINT_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_FP64_TOINT_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp64_toint_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP64_TOINT_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_FP16_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp16_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP16_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_BF16_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &bf16_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_BF16_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_FP80_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp80_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP80_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_FP128_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp128_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP128_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_FP16_TRUNC_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp16_trunc_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP16_TRUNC_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_BF16_TRUNC_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &bf16_trunc_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_BF16_TRUNC_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_FP16_TOINT_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &fp16_toint_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_FP16_TOINT_CHECK_");
+    }
+    if (f->getName().str().find("_FPC_BF16_TOINT_CHECK_") != std::string::npos)
+    {
+      confFunction(f, &bf16_toint_check_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_BF16_TOINT_CHECK_");
+    }
     if (f->getName().str().find("_FPC_INIT_FPCHECKER") != std::string::npos)
     {
       confFunction(f, &fpc_init,
@@ -94,6 +218,36 @@ CPUFPInstrumentation::CPUFPInstrumentation(Module *M) :
       confFunction(f, &fpc_print_locations,
       GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_PRINT_LOCATIONS_");
     }
+    if (f->getName().str().find("_FPC_EMULATE_FP32_") != std::string::npos)
+    {
+      confFunction(f, &fp32_emulate_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_EMULATE_FP32_");
+    }
+    if (f->getName().str().find("_FPC_EMULATE_FP64_") != std::string::npos)
+    {
+      confFunction(f, &fp64_emulate_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_EMULATE_FP64_");
+    }
+    if (f->getName().str().find("_FPC_SHADOW_FP32_") != std::string::npos)
+    {
+      confFunction(f, &fp32_shadow_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_SHADOW_FP32_");
+    }
+    if (f->getName().str().find("_FPC_SHADOW_FP64_") != std::string::npos)
+    {
+      confFunction(f, &fp64_shadow_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_SHADOW_FP64_");
+    }
+    if (f->getName().str().find("_FPC_PERTURB_FP32_") != std::string::npos)
+    {
+      confFunction(f, &fp32_perturb_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_PERTURB_FP32_");
+    }
+    if (f->getName().str().find("_FPC_PERTURB_FP64_") != std::string::npos)
+    {
+      confFunction(f, &fp64_perturb_function,
+      GlobalValue::LinkageTypes::LinkOnceODRLinkage, "_FPC_PERTURB_FP64_");
+    }
 
     SET_ODR_LIKAGE("_FPC_FP32_IS_INF")
     SET_ODR_LIKAGE("_FPC_FP32_GET_MANTISSA")
@@ -109,7 +263,14 @@ CPUFPInstrumentation::CPUFPInstrumentation(Module *M) :
     SET_ODR_LIKAGE("_FPC_FP32_IS_LATENT_INFINITY_POS")
     SET_ODR_LIKAGE("_FPC_FP32_IS_LATENT_INFINITY_NEG")
     SET_ODR_LIKAGE("_FPC_FP32_IS_LATENT_SUBNORMAL")
+    SET_ODR_LIKAGE("_FPC_FP32_IS_ABSORPTION")
+    SET_ODR_LIKAGE("_FPC_FP32_IS_ZERO_")
+    SET_ODR_LIKAGE("_FPC_FP32_IS_NEGATIVE_")
+    SET_ODR_LIKAGE("_FPC_FP32_IS_FINITE_")
     SET_ODR_LIKAGE("_FPC_FP64_IS_INF")
+    SET_ODR_LIKAGE("_FPC_FP64_IS_ZERO_")
+    SET_ODR_LIKAGE("_FPC_FP64_IS_NEGATIVE_")
+    SET_ODR_LIKAGE("_FPC_FP64_IS_FINITE_")
     SET_ODR_LIKAGE("_FPC_FP64_GET_MANTISSA")
     SET_ODR_LIKAGE("_FPC_FP64_GET_EXPONENT")
     SET_ODR_LIKAGE("_FPC_FP64_IS_INFINITY_POS")
@@ -123,47 +284,474 @@ CPUFPInstrumentation::CPUFPInstrumentation(Module *M) :
     SET_ODR_LIKAGE("_FPC_FP64_IS_LATENT_INFINITY_POS")
     SET_ODR_LIKAGE("_FPC_FP64_IS_LATENT_INFINITY_NEG")
     SET_ODR_LIKAGE("_FPC_FP64_IS_LATENT_SUBNORMAL")
+    SET_ODR_LIKAGE("_FPC_FP64_IS_ABSORPTION")
     SET_ODR_LIKAGE("_FPC_EVENT_OCURRED")
     SET_ODR_LIKAGE("_FPC_FP32_CHECK_")
     SET_ODR_LIKAGE("_FPC_FP64_CHECK_")
     SET_ODR_LIKAGE("_FPC_TRAP_HERE")
     SET_ODR_LIKAGE("_FPC_STRING_ENDS_WITH")
     SET_ODR_LIKAGE("_FPC_CHECK_AND_TRAP")
+    SET_ODR_LIKAGE("_FPC_FP32_FAST_PATH_")
+    SET_ODR_LIKAGE("_FPC_FP64_FAST_PATH_")
+    SET_ODR_LIKAGE("_FPC_FP32_SLOW_PATH_")
+    SET_ODR_LIKAGE("_FPC_FP64_SLOW_PATH_")
+    SET_ODR_LIKAGE("_FPC_FP32_SET_EVENTS_")
+    SET_ODR_LIKAGE("_FPC_FP64_SET_EVENTS_")
+    // Fused multiply-adds
+    SET_ODR_LIKAGE("_FPC_FP32_FMA_SLOW_PATH_")
+    SET_ODR_LIKAGE("_FPC_FP64_FMA_SLOW_PATH_")
+    // Math function calls
+    SET_ODR_LIKAGE("_FPC_FP32_CALL_SLOW_PATH_")
+    SET_ODR_LIKAGE("_FPC_FP64_CALL_SLOW_PATH_")
+    // Narrowing conversions
+    SET_ODR_LIKAGE("_FPC_WRITE_CONVERSION_")
+    SET_ODR_LIKAGE("_FPC_WRITE_FAST_MATH_")
+    SET_ODR_LIKAGE("_FPC_FAST_MATH_STRING_")
+    SET_ODR_LIKAGE("_FPC_WRITE_EXTENSIONS_")
+    SET_ODR_LIKAGE("_FPC_ITEM_HAS_EXTENSIONS_")
+    SET_ODR_LIKAGE("_FPC_CONVERSION_CREATE_")
+    SET_ODR_LIKAGE("_FPC_CONVERSION_UPDATE_")
+    SET_ODR_LIKAGE("_FPC_FP64_TRUNC_SLOW_PATH_")
+    SET_ODR_LIKAGE("_FPC_IS_OUT_OF_RANGE_")
+    SET_ODR_LIKAGE("_FPC_TOINT_CHECK_")
+    // Other formats (all the functions of _FPC_DEFINE_FORMAT_CHECKS_)
+    SET_ODR_LIKAGE("_FPC_FORMAT_EXPONENTS_")
+    SET_ODR_LIKAGE("_FPC_FORMAT_ZONE_")
+    SET_ODR_LIKAGE("_FPC_FORMAT_CANCELLATION_")
+    SET_ODR_LIKAGE("_FPC_FORMAT_FAST_PATH_")
+    SET_ODR_LIKAGE("_FPC_FORMAT_SET_EVENTS_")
+    SET_ODR_LIKAGE("_FPC_FLOAT_DECODE_IN_")
+    SET_ODR_LIKAGE("_FPC_SMALL_TRUNC_CHECK_")
+    SET_ODR_LIKAGE("_FPC_FP16_")
+    SET_ODR_LIKAGE("_FPC_BF16_")
+    SET_ODR_LIKAGE("_FPC_FP80_")
+    SET_ODR_LIKAGE("_FPC_FP128_")
+    SET_ODR_LIKAGE("_FPC_READ_CYCLES_")
+    // Overhead budget
+    SET_ODR_LIKAGE("_FPC_BUDGET_INIT_")
+    SET_ODR_LIKAGE("_FPC_BUDGET_PRINT_SUMMARY_")
+    SET_ODR_LIKAGE("_FPC_BUDGET_ADJUST_")
+    SET_ODR_LIKAGE("_FPC_BUDGET_ACCOUNT_")
+    // Per-site profiling
+    SET_ODR_LIKAGE("_FPC_INIT_OPTIONS_")
+    SET_ODR_LIKAGE("_FPC_SITE_ENTER_")
+    SET_ODR_LIKAGE("_FPC_SITE_EXIT_")
     // Hash table
     SET_ODR_LIKAGE("_FPC_HT_CREATE_")
     SET_ODR_LIKAGE("_FPC_HT_HASH_")
+    SET_ODR_LIKAGE("_FPC_HT_HASH_KEY_")
+    SET_ODR_LIKAGE("_FPC_HT_FIND_")
+    SET_ODR_LIKAGE("_FPC_HT_GET_")
+    SET_ODR_LIKAGE("_FPC_FETCH_ADD_")
     SET_ODR_LIKAGE("_FPC_HT_NEWPAIR_")
     SET_ODR_LIKAGE("_FPC_ITEMS_EQUAL_")
     SET_ODR_LIKAGE("_FPC_HT_SET_")
     SET_ODR_LIKAGE("_FPC_PRINT_HASH_TABLE_")
+    SET_ODR_LIKAGE("_FPC_TRACE_FILE_NAME_")
+    SET_ODR_LIKAGE("_FPC_PROG_INPUT_STRING_")
+    // Binary traces
+    SET_ODR_LIKAGE("_FPC_TRACE_ADD_STRING_")
+    SET_ODR_LIKAGE("_FPC_TRACE_ADD_EXTENSIONS_")
+    SET_ODR_LIKAGE("_FPC_PRINT_HASH_TABLE_BINARY_")
+    // Trace flushing
+    SET_ODR_LIKAGE("_FPC_HT_SNAPSHOT_")
+    SET_ODR_LIKAGE("_FPC_TRACE_HASH_STRING_")
+    SET_ODR_LIKAGE("_FPC_TRACE_STRINGS_SLOTS_")
+    SET_ODR_LIKAGE("_FPC_TRACE_STRINGS_INIT_")
+    SET_ODR_LIKAGE("_FPC_WRITE_JSON_TRACE_")
+    SET_ODR_LIKAGE("_FPC_WRITE_BINARY_TRACE_")
+    SET_ODR_LIKAGE("_FPC_WRITE_TRACE_")
+    SET_ODR_LIKAGE("_FPC_FLUSH_TRACES_")
+    SET_ODR_LIKAGE("_FPC_FLUSH_THREAD_")
+    SET_ODR_LIKAGE("_FPC_FLUSH_STOP_")
+    SET_ODR_LIKAGE("_FPC_FLUSH_AT_EXIT_")
+    SET_ODR_LIKAGE("_FPC_FLUSH_SIGNAL_HANDLER_")
+    SET_ODR_LIKAGE("_FPC_FLUSH_INIT_")
+    // Merge tables (FPC_MergeTable.h)
+    SET_ODR_LIKAGE("_FPC_MERGE_INIT_")
+    SET_ODR_LIKAGE("_FPC_MERGE_FREE_")
+    SET_ODR_LIKAGE("_FPC_MERGE_HASH_")
+    SET_ODR_LIKAGE("_FPC_MERGE_GET_SITE_")
+    SET_ODR_LIKAGE("_FPC_MERGE_TABLES_")
+    SET_ODR_LIKAGE("_FPC_MERGE_PROCESS_")
+    SET_ODR_LIKAGE("_FPC_MERGE_ITEMS_")
+    SET_ODR_LIKAGE("_FPC_MERGE_BINARY_TRACE_")
+    SET_ODR_LIKAGE("_FPC_MERGE_PACK_")
+    SET_ODR_LIKAGE("_FPC_MERGE_UNPACK_")
+    SET_ODR_LIKAGE("_FPC_MERGE_PRINT_RANKS_")
+    SET_ODR_LIKAGE("_FPC_MERGE_WRITE_TRACE_")
+    // Node-local staging
+    SET_ODR_LIKAGE("_FPC_TRACE_DIR_")
+    SET_ODR_LIKAGE("_FPC_TRACE_PATH_")
+    SET_ODR_LIKAGE("_FPC_STAGE_PROCESSES_")
+    SET_ODR_LIKAGE("_FPC_STAGE_INIT_")
+    SET_ODR_LIKAGE("_FPC_STAGE_MERGE_")
+    SET_ODR_LIKAGE("_FPC_STAGE_TRACES_")
+    // Collector (fpc-collectd)
+    SET_ODR_LIKAGE("_FPC_BUILD_BINARY_TRACE_")
+    SET_ODR_LIKAGE("_FPC_WRITE_ALL_")
+    SET_ODR_LIKAGE("_FPC_COLLECTOR_INIT_")
+    SET_ODR_LIKAGE("_FPC_COLLECTOR_DELTAS_")
+    SET_ODR_LIKAGE("_FPC_COLLECTOR_SEND_")
+    SET_ODR_LIKAGE("_FPC_COLLECTOR_WRITE_")
+    // First occurrences (FPC_CAPTURE_OCCURRENCES)
+    SET_ODR_LIKAGE("_FPC_TIME_NS_")
+    SET_ODR_LIKAGE("_FPC_PROCESS_RANK_")
+    SET_ODR_LIKAGE("_FPC_CAPTURE_CREATE_")
+    SET_ODR_LIKAGE("_FPC_CAPTURE_RECORD_")
+    SET_ODR_LIKAGE("_FPC_SAVE_EVENTS_")
+    SET_ODR_LIKAGE("_FPC_WRITE_OCCURRENCES_")
+    // Exponent ranges (FPC_PROFILE_RANGES)
+    SET_ODR_LIKAGE("_FPC_WRITE_EXPONENTS_")
+    SET_ODR_LIKAGE("_FPC_WRITE_RANGES_")
+    SET_ODR_LIKAGE("_FPC_RANGE_CREATE_")
+    SET_ODR_LIKAGE("_FPC_ATOMIC_MIN_")
+    SET_ODR_LIKAGE("_FPC_ATOMIC_MAX_")
+    SET_ODR_LIKAGE("_FPC_RANGE_EXPONENT_")
+    SET_ODR_LIKAGE("_FPC_RANGE_OPERAND_")
+    SET_ODR_LIKAGE("_FPC_RANGE_UPDATE_")
+    // Reduced-precision emulation (FPC_EMULATE)
+    SET_ODR_LIKAGE("_FPC_WRITE_EMULATION_")
+    SET_ODR_LIKAGE("_FPC_ROUND_TO_FORMAT_")
+    SET_ODR_LIKAGE("_FPC_EMULATION_CREATE_")
+    SET_ODR_LIKAGE("_FPC_EMULATION_COUNT_")
+    SET_ODR_LIKAGE("_FPC_EMULATE_OP_")
+    // Shadow computation (FPC_SHADOW)
+    SET_ODR_LIKAGE("_FPC_WRITE_SHADOW_")
+    SET_ODR_LIKAGE("_FPC_SHADOW_CREATE_")
+    SET_ODR_LIKAGE("_FPC_ATOMIC_ADD_DOUBLE_")
+    SET_ODR_LIKAGE("_FPC_SHADOW_RECORD_")
+    // Rounding perturbation (FPC_PERTURB)
+    SET_ODR_LIKAGE("_FPC_WRITE_DOUBLE_")
+    SET_ODR_LIKAGE("_FPC_WRITE_PERTURBATION_")
+    SET_ODR_LIKAGE("_FPC_PERTURB_RANDOM_")
+    SET_ODR_LIKAGE("_FPC_PERTURB_CREATE_")
+    SET_ODR_LIKAGE("_FPC_PERTURB_RECORD_")
+    SET_ODR_LIKAGE("_FPC_PERTURB_ERROR_")
+    SET_ODR_LIKAGE("_FPC_PERTURB_ROUND_")
+    // Subnormal numbers (FPC_PROFILE_DENORMALS, FPC_FTZ_DAZ)
+    SET_ODR_LIKAGE("_FPC_WRITE_DENORMALS_")
+    SET_ODR_LIKAGE("_FPC_FP32_IS_DENORMAL_")
+    SET_ODR_LIKAGE("_FPC_FP64_IS_DENORMAL_")
+    SET_ODR_LIKAGE("_FPC_SET_FTZ_DAZ_")
+    SET_ODR_LIKAGE("_FPC_DENORMAL_CREATE_")
+    SET_ODR_LIKAGE("_FPC_DENORMAL_UPDATE_")
+    // Flight recorder
+    SET_ODR_LIKAGE("_FPC_RECORDER_CREATE_")
+    SET_ODR_LIKAGE("_FPC_RECORDER_ADD_")
+    SET_ODR_LIKAGE("_FPC_RECORDER_FORMAT_")
+    SET_ODR_LIKAGE("_FPC_RECORDER_FLUSH_")
+    SET_ODR_LIKAGE("_FPC_RECORDER_WRITE_")
+    SET_ODR_LIKAGE("_FPC_RECORDER_WRITE_NUMBER_")
+    SET_ODR_LIKAGE("_FPC_RECORDER_DUMP_")
+    SET_ODR_LIKAGE("_FPC_RECORDER_SIGNAL_HANDLER_")
+    SET_ODR_LIKAGE("_FPC_RECORDER_INIT_")
+    // MPI reduction (Runtime_mpi.h)
+    SET_ODR_LIKAGE("_FPC_MPI_REDUCE_TRACES_")
+    // The MPI_Finalize wrapper (not PMPI_Finalize)
+    if (f->getName().str() == "MPI_Finalize")
+      setRuntimeLinkage(f, GlobalValue::LinkageTypes::LinkOnceODRLinkage);
     SET_ODR_LIKAGE("_FPC_INIT_HASH_TABLE_")
   }
 
-  // Globals initialization
-  GlobalVariable *table = nullptr;
-  table = mod->getGlobalVariable ("_FPC_HTABLE_", true);
-  assert(table && "Invalid table!");
-  table->setLinkage(GlobalValue::LinkageTypes::LinkOnceODRLinkage);
-  //table->setLinkage(GlobalValue::LinkageTypes::LinkOnceAnyLinkage);
-  
-  GlobalVariable *prog_inputs = nullptr;
-  prog_inputs = mod->getGlobalVariable ("_FPC_PROG_INPUTS", true);
-  assert(prog_inputs && "Invalid table!");
-  prog_inputs->setLinkage(GlobalValue::LinkageTypes::LinkOnceODRLinkage);
-
-  GlobalVariable *prog_args = nullptr;
-  prog_args = mod->getGlobalVariable ("_FPC_PROG_ARGS", true);
-  assert(prog_args && "Invalid table!");
-  prog_args->setLinkage(GlobalValue::LinkageTypes::LinkOnceODRLinkage);
+  // Globals initialization. In a ThinLTO backend (FPC_LTO), the globals
+  // that the module does not use are not in the module.
+  const char *globals[] = {"_FPC_HTABLE_", "_FPC_PROG_INPUTS", "_FPC_PROG_ARGS",
+      "_FPC_OPTIONS_", "_FPC_BUDGET_", "_FPC_FLUSH_", "_FPC_COLLECTOR_",
+      "_FPC_RECORDERS_", "_FPC_THREAD_RECORDER_", "_FPC_PERTURB_STATE_",
+      "_FPC_PERTURB_THREADS_"};
+  for (const char *name : globals) {
+    GlobalVariable *g = mod->getGlobalVariable(name, true);
+    assert((g || ltoMode) && "Runtime global not found!");
+    if (g)
+      setRuntimeLinkage(g, GlobalValue::LinkageTypes::LinkOnceODRLinkage);
+  }
 
   GlobalVariable *fpc_lock = nullptr;
   fpc_lock = mod->getGlobalVariable ("fpc_lock", true);
-  if (fpc_lock) {
-    assert(fpc_lock && "Invalid lock!");
-    fpc_lock->setLinkage(GlobalValue::LinkageTypes::LinkOnceODRLinkage);
-  }
+  if (fpc_lock)
+    setRuntimeLinkage(fpc_lock, GlobalValue::LinkageTypes::LinkOnceODRLinkage);
+
+  readEmulationOptions();
+  readMathFunctions();
+  const char *shadow = getenv("FPC_SHADOW");
+  shadowMode = (shadow != NULL && std::string(shadow) != "0");
+  const char *perturb = getenv("FPC_PERTURB");
+  perturbMode = (perturb != NULL && std::string(perturb) != "0");
  }
 
+/**
+ * LTO-time instrumentation
+ * -------------------------
+ * With FPC_LTO=1, the wrappers build with -flto=thin and the operations
+ * are instrumented in the ThinLTO backends, at link time, after the
+ * functions of other modules are imported and inlined: inlining decisions
+ * are made without the check calls, and an inlined copy of a line is
+ * checked with the line (and file) of the source. At compile time
+ * (FPC_LTO_PRELINK), the pass only keeps the runtime of the module (its
+ * linkonce_odr functions and globals): nothing calls it yet, so it is
+ * added to llvm.compiler.used, which the optimizations and the dead symbol
+ * elimination of ThinLTO preserve. The linker keeps one copy. Every
+ * module still compiles and optimizes the whole runtime, as without LTO,
+ * and the pinned copies are also kept until the link, which adds to the
+ * build time. Full LTO (-flto) runs the pass with LLVM 15 or later.
+ **/
+void CPUFPInstrumentation::prepareForLTO()
+{
+  std::vector<GlobalValue *> runtime;
+  for (Function &f : *mod)
+    if (f.hasLinkOnceODRLinkage() && (f.getName().contains("_FPC_") ||
+        f.getName() == "MPI_Finalize"))
+      runtime.push_back(&f);
+  for (GlobalVariable &g : mod->globals())
+    if (g.hasLinkOnceODRLinkage() && (g.getName().contains("_FPC_") ||
+        g.getName() == "fpc_lock"))
+      runtime.push_back(&g);
+  appendToCompilerUsed(*mod, runtime);
+}
+
+/**
+ * Math function calls
+ * --------------------
+ * The results of calls to math functions are checked (operation CALL of
+ * the runtime), with the name of the function saved in the site. A
+ * function name matches the double and float versions (log, logf), the
+ * llvm intrinsics (llvm.log.f64) and the vector variants of -fveclib:
+ * libmvec (_ZGVdN4v_log) and SVML (__svml_log4). FPC_MATH_FUNCTIONS (at
+ * compile time) replaces the default list with comma-separated names;
+ * FPC_MATH_FUNCTIONS=none does not check calls.
+ **/
+void CPUFPInstrumentation::readMathFunctions()
+{
+  static const char *defaults[] = {
+    "exp", "exp2", "exp10", "expm1", "log", "log2", "log10", "log1p", "pow",
+    "sqrt", "cbrt", "hypot", "sin", "cos", "tan", "asin", "acos", "atan",
+    "atan2", "sinh", "cosh", "tanh", "asinh", "acosh", "atanh", "erf",
+    "erfc", "tgamma", "lgamma", "fmod", "remainder" };
+
+  std::vector<std::string> names;
+  if (const char *list = getenv("FPC_MATH_FUNCTIONS"))
+    CUDAAnalysis::tokenize(list, names, ",");
+  else
+    names.assign(std::begin(defaults), std::end(defaults));
+  for (auto &name : names)
+    if (name != "none")
+      mathFunctions.insert(name);
+}
+
+/* Returns the name of the math function called by inst (the name of the
+double version, plus "f" for float), or an empty string */
+std::string CPUFPInstrumentation::getMathFunction(const Instruction *inst)
+{
+  const CallInst *call = dyn_cast<CallInst>(inst);
+  if (call == nullptr || call->getCalledFunction() == nullptr || mathFunctions.empty())
+    return "";
+  Type *type = call->getType()->getScalarType();
+  if (!type->isFloatTy() && !type->isDoubleTy())
+    return "";
+
+  std::string name = call->getCalledFunction()->getName().str();
+  if (name.rfind("llvm.", 0) == 0) {
+    // llvm.<name>.<type>
+    name = name.substr(5, name.find('.', 5) - 5);
+  } else if (name.rfind("_ZGV", 0) == 0) {
+    // libmvec: _ZGV<isa><mask><lanes><parameters>_<name>
+    size_t pos = name.find('_', 4);
+    if (pos == std::string::npos)
+      return "";
+    name = name.substr(pos + 1);
+  } else if (name.rfind("__svml_", 0) == 0) {
+    // SVML: __svml_<name><lanes>, e.g., __svml_logf8
+    name = name.substr(7);
+    while (!name.empty() && isdigit(name.back()))
+      name.pop_back();
+  }
+
+  std::string base = name;
+  if (type->isFloatTy() && base.size() > 1 && base.back() == 'f' &&
+      mathFunctions.count(base) == 0)
+    base.pop_back();
+  if (mathFunctions.count(base) == 0)
+    return "";
+  return type->isFloatTy() ? base + "f" : base;
+}
+
+/**
+ * Reduced-precision emulation
+ * ----------------------------
+ * FPC_EMULATE=fp32|bf16|fp16 (at compile time) rounds the operands and the
+ * results of the selected double operations (and of float operations, for
+ * bf16 and fp16) to that format in software, so the program runs as if
+ * they were computed in that format (see _FPC_EMULATE_OP_). Operations are
+ * selected with comma-separated lists:
+ *   FPC_EMULATE_FILES      file names (suffixes), e.g., kernel.cpp
+ *   FPC_EMULATE_FUNCTIONS  function names, mangled or not, e.g., axpy
+ *   FPC_EMULATE_SITES      sites, e.g., kernel.cpp:42
+ * An operation is emulated if it matches any list; without lists, all the
+ * operations of the file are emulated. Comparisons are not emulated.
+ **/
+void CPUFPInstrumentation::readEmulationOptions()
+{
+  const char *format = getenv("FPC_EMULATE");
+  if (format == nullptr || format[0] == '\0')
+    return;
+
+  std::string name(format);
+  if (name == "fp32" || name == "float")
+    emulatedFormat = 0;
+  else if (name == "bf16" || name == "bfloat16")
+    emulatedFormat = 1;
+  else if (name == "fp16" || name == "half")
+    emulatedFormat = 2;
+  else {
+    std::string out = "Invalid FPC_EMULATE format: " + name;
+    CUDAAnalysis::Logging::error(out.c_str());
+    return;
+  }
+
+  if (const char *files = getenv("FPC_EMULATE_FILES"))
+    CUDAAnalysis::tokenize(files, emulatedFiles, ",");
+  if (const char *functions = getenv("FPC_EMULATE_FUNCTIONS"))
+    CUDAAnalysis::tokenize(functions, emulatedFunctions, ",");
+  if (const char *sites = getenv("FPC_EMULATE_SITES")) {
+    std::vector<std::string> tokens;
+    CUDAAnalysis::tokenize(sites, tokens, ",");
+    for (auto &t : tokens) {
+      size_t pos = t.rfind(':');
+      if (pos == std::string::npos)
+        continue;
+      emulatedSites.push_back(std::make_pair(t.substr(0, pos), atoi(t.substr(pos+1).c_str())));
+    }
+  }
+}
+
+static bool endsWith(const std::string &str, const std::string &suffix)
+{
+  return str.size() >= suffix.size() &&
+      str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool CPUFPInstrumentation::isEmulated(Instruction *inst, Function *f,
+    const std::string &fileName, int line)
+{
+  if (emulatedFormat == -1 || isCmpEqual(inst))
+    return false;
+  // A float operation is already computed in fp32
+  if (isSingleFPOperation(inst) && emulatedFormat == 0)
+    return false;
+  if (emulatedFiles.empty() && emulatedFunctions.empty() && emulatedSites.empty())
+    return true;
+
+  for (auto &file : emulatedFiles)
+    if (endsWith(fileName, file))
+      return true;
+
+  std::string mangled = f->getName().str();
+  std::string demangled = demangle(mangled);
+  for (auto &name : emulatedFunctions)
+    if (mangled == name || demangled == name || demangled.rfind(name + "(", 0) == 0)
+      return true;
+
+  for (auto &site : emulatedSites)
+    if (site.second == line && endsWith(fileName, site.first))
+      return true;
+  return false;
+}
+
+/* Calls the emulation function after inst and replaces the uses of inst
+with the emulated result, including the check of inst. */
+void CPUFPInstrumentation::emulateOperation(Instruction *inst, Value *fileName, ConstantInt *locId, ConstantInt *opType, CallInst *checkCall)
+{
+  Function *emulate = isSingleFPOperation(inst) ? fp32_emulate_function : fp64_emulate_function;
+  assert(emulate && "Emulation function not initialized!");
+
+  IRBuilder<> builder(inst->getNextNode());
+  std::vector<Value *> args;
+  args.push_back(inst);
+  args.push_back(inst->getOperand(0));
+  args.push_back(inst->getOperand(1));
+  args.push_back(locId);
+  args.push_back(fileName);
+  args.push_back(opType);
+  args.push_back(ConstantInt::get(mod->getContext(), APInt(32, emulatedFormat, true)));
+  CallInst *callInst = builder.CreateCall(emulate, ArrayRef<Value *>(args));
+  assert(callInst && "Invalid call instruction!");
+  callInst->setDebugLoc(checkCall->getDebugLoc());
+
+  inst->replaceUsesWithIf(callInst, [callInst](Use &U) { return U.getUser() != callInst; });
+  emulatedOps++;
+}
+
+/**
+ * Rounding perturbation
+ * ----------------------
+ * FPC_PERTURB=1 (at compile time) replaces the results of the scalar
+ * additions, subtractions, multiplications and divisions with the exact
+ * results rounded up or down at random (see _FPC_PERTURB_FP64_), like
+ * emulateOperation. Operations that are emulated (FPC_EMULATE) and the
+ * extended operations (vectors, FMAs, other formats) are not perturbed.
+ * Running the program several times with different seeds (fpc-perturb)
+ * shows the sites whose results depend on the rounding, and so on the
+ * order of the operations.
+ **/
+void CPUFPInstrumentation::perturbOperation(Instruction *inst, Value *fileName, ConstantInt *locId, ConstantInt *opType, CallInst *checkCall)
+{
+  Function *perturb = isSingleFPOperation(inst) ? fp32_perturb_function : fp64_perturb_function;
+  assert(perturb && "Perturbation function not initialized!");
+
+  IRBuilder<> builder(inst->getNextNode());
+  std::vector<Value *> args;
+  args.push_back(inst);
+  args.push_back(inst->getOperand(0));
+  args.push_back(inst->getOperand(1));
+  args.push_back(locId);
+  args.push_back(fileName);
+  args.push_back(opType);
+  CallInst *callInst = builder.CreateCall(perturb, ArrayRef<Value *>(args));
+  assert(callInst && "Invalid call instruction!");
+  callInst->setDebugLoc(checkCall->getDebugLoc());
+
+  inst->replaceUsesWithIf(callInst, [callInst](Use &U) { return U.getUser() != callInst; });
+  perturbedOps++;
+}
+
+/* Is call the emulation or perturbation of inst, which replaces its result? */
+bool CPUFPInstrumentation::isReplacementCall(const CallInst *call, const Value *inst)
+{
+  const Function *callee = call->getCalledFunction();
+  return callee != nullptr && call->getArgOperand(0) == inst &&
+      (callee == fp32_emulate_function || callee == fp64_emulate_function ||
+       callee == fp32_perturb_function || callee == fp64_perturb_function);
+}
+
+/**
+ * File names
+ * -----------
+ * The runtime identifies a site by the address of its file name and its
+ * line. Each source file has one constant string, _FPC_FILE_<MD5 of the
+ * path>, with linkonce_odr linkage, so the linker keeps a single copy: the
+ * sites of a file have the same file name in every translation unit, and
+ * the copies of a line made by inlining (from a header, or from another
+ * module with LTO) are one site, attributed to the file of the line.
+ **/
+Constant *CPUFPInstrumentation::getFileNameString(Instruction *inst, std::string &fileName)
+{
+  fileName = getFileName(inst);
+  MD5 hash;
+  hash.update(fileName);
+  MD5::MD5Result result;
+  hash.final(result);
+  std::string name = "_FPC_FILE_" + result.digest().str().str();
+
+  GlobalVariable *str = mod->getGlobalVariable(name);
+  if (str == nullptr) {
+    Constant *c = ConstantDataArray::getString(mod->getContext(), fileName);
+    str = new GlobalVariable(*mod, c->getType(), true,
+        GlobalValue::LinkageTypes::LinkOnceODRLinkage, c, name);
+  }
+  return ConstantExpr::getPointerCast(str, Type::getInt8PtrTy(mod->getContext()));
+}
+
 void CPUFPInstrumentation::instrumentFunction(Function *f, long int *c)
 {
 	if (CUDAAnalysis::CodeMatching::isUnwantedFunction(f))
@@ -176,13 +764,18 @@ void CPUFPInstrumentation::instrumentFunction(Function *f, long int *c)
   CUDAAnalysis::Logging::info("Entering main loop in instrumentFunction");
 #endif
 
-	long int instrumentedOps = 0;
-	for (auto bb=f->begin(), end=f->end(); bb != end; ++bb) {
-		for (auto i=bb->begin(), bend=bb->end(); i != bend; ++i) {
-			Instruction *inst = &(*i);
+	// The operations are collected first, since checking atomic and vector
+	// operations adds FP operations that must not be checked
+	std::vector<Instruction *> operations;
+	for (auto bb=f->begin(), end=f->end(); bb != end; ++bb)
+		for (auto i=bb->begin(), bend=bb->end(); i != bend; ++i)
+			if (isFPOperation(&(*i)) || isFMAOperation(&(*i)) || isAtomicFPOperation(&(*i)) ||
+			    isConversionOperation(&(*i)) || !getMathFunction(&(*i)).empty())
+				operations.push_back(&(*i));
 
-			if (isFPOperation(inst) && 
-        (isSingleFPOperation(inst) || isDoubleFPOperation(inst))) {
+	long int instrumentedOps = 0;
+	for (Instruction *inst : operations) {
+		if (isSingleFPOperation(inst) || isDoubleFPOperation(inst)) {
 				DebugLoc loc = inst->getDebugLoc();
 
 				// Create builder to add stuff after the instruction
@@ -204,43 +797,27 @@ void CPUFPInstrumentation::instrumentFunction(Function *f, long int *c)
 				args.push_back(inst->getOperand(1));
 
 				// Push location parameter (line number)
-				int lineNumber = CUDAAnalysis::getLineOfCode(inst);
-        // Discard if line number is invalid (no debug info for inst)
-        if (lineNumber == -1)
-          continue;
+				int lineNumber = getLine(inst);
+        if (!inst->getDebugLoc())
+          unlocatedOps++;
 				ConstantInt* locId = ConstantInt::get(mod->getContext(),
 				    APInt(32, lineNumber, true));
 				args.push_back(locId);
 
 				// Push file name
-				// Get global fileName pointer
-        GlobalVariable *fName = nullptr;
-        fName = mod->getGlobalVariable("_ZL15_FPC_FILE_NAME_", true); // C++ binding
-        if (fName==nullptr)
-          fName = mod->getGlobalVariable("_FPC_FILE_NAME_", true); // try C binding
-        assert((fName!=nullptr) && "Global filename var not found");
-        auto loadInst = builder.CreateAlignedLoad(fName, MaybeAlign(), "my");
-
-        std::string fileName = CUDAAnalysis::getFileNameFromInstruction(inst);
-        Constant *c = builder.CreateGlobalStringPtr(fileName);
-        fName->setInitializer(NULL);
-        fName->setInitializer(c);
-        args.push_back(loadInst);
+        std::string fileName;
+        Constant *fileNameStr = getFileNameString(inst, fileName);
+        args.push_back(fileNameStr);
 
         // Push operation type
-        int operationType = 0;
-        if      (inst->getOpcode() == Instruction::FAdd) operationType=0;
-        else if (inst->getOpcode() == Instruction::FSub) operationType=1;
-        else if (inst->getOpcode() == Instruction::FMul) operationType=2;
-        else if (inst->getOpcode() == Instruction::FDiv) operationType=3;
-        else if (isCmpEqual(inst))                       operationType=4;
-        else if (inst->getOpcode() == Instruction::FRem) operationType=5;
-        else operationType=-1;
+        int operationType = getOperationType(inst);
         assert(operationType >=0 && "Unknown operation");
 
         ConstantInt* opType = ConstantInt::get(mod->getContext(),
             APInt(32, operationType, true));
-        args.push_back(opType);
+        // The check also takes the fast-math flags of the instruction
+        args.push_back(ConstantInt::get(mod->getContext(),
+            APInt(32, operationType | (getFastMathFlags(inst) << 8), true)));
 
         // Check if instruction is selected based on a condition
         Instruction *select_inst = nullptr;
@@ -305,7 +882,13 @@ void CPUFPInstrumentation::instrumentFunction(Function *f, long int *c)
       
 				assert(callInst && "Invalid call instruction!");
         setFakeDebugLocation(inst, callInst, f);
-			}
+
+        if (isEmulated(inst, f, fileName, lineNumber))
+          emulateOperation(inst, fileNameStr, locId, opType, callInst);
+        else if (perturbMode && !isCmpEqual(inst) && operationType != 5)
+          perturbOperation(inst, fileNameStr, locId, opType, callInst);
+		} else {
+			instrumentedOps += instrumentExtendedOperation(inst, f);
 		}
 	}
 
@@ -318,6 +901,346 @@ void CPUFPInstrumentation::instrumentFunction(Function *f, long int *c)
   *c = instrumentedOps;
 }
 
+/**
+ * Extended operations
+ * --------------------
+ * Operations that are not a single scalar instruction are checked here:
+ *  - fused multiply-adds (llvm.fma and llvm.fmuladd, e.g., from
+ *    -ffp-contract=fast) call _FPC_FP32/64_FMA_CHECK_ with the three
+ *    operands;
+ *  - atomic additions and subtractions (atomicrmw fadd/fsub, e.g., from
+ *    OpenMP reductions) return the old value, so the stored value is
+ *    computed again and checked as old +/- operand;
+ *  - calls to math functions (see readMathFunctions) call
+ *    _FPC_FP32/64_CALL_CHECK_ with the name of the function and its first
+ *    one or two floating-point arguments;
+ *  - narrowing conversions (fptrunc, fptosi and fptoui) call
+ *    _FPC_FP64/FP16/BF16_TRUNC_CHECK_ with the result and the value, or
+ *    _FPC_FP32/64/FP16/BF16_TOINT_CHECK_ with the value and the integer type;
+ *  - operations on half, bfloat, x86_fp80 and fp128 call
+ *    _FPC_FP16/BF16/FP80/FP128_CHECK_; half and bfloat values are extended
+ *    to float. Fused multiply-adds in these formats are not checked;
+ *  - operations on vectors are checked lane by lane, with the line of the
+ *    vector operation.
+ * These operations are not emulated or shadowed. Returns the number of
+ * checks inserted.
+ **/
+long int CPUFPInstrumentation::instrumentExtendedOperation(Instruction *inst, Function *f)
+{
+  Type *type = inst->getType();
+  if (AtomicRMWInst *atomic = dyn_cast<AtomicRMWInst>(inst))
+    type = atomic->getValOperand()->getType();
+  else if (!isa<CallInst>(inst) || isConversionOperation(inst))
+    type = inst->getOperand(0)->getType();
+
+  // Scalable vectors do not have a known number of lanes
+  if (type->isVectorTy() && !isa<FixedVectorType>(type))
+    return 0;
+  Type *elemType = type->getScalarType();
+  bool halfType = elemType->isHalfTy() || elemType->isBFloatTy();
+  bool otherType = halfType || elemType->isX86_FP80Ty() || elemType->isFP128Ty();
+  if (!elemType->isFloatTy() && !elemType->isDoubleTy() && !otherType)
+    return 0;
+  if (otherType && isFMAOperation(inst))
+    return 0;
+  int lineNumber = getLine(inst);
+  if (!inst->getDebugLoc())
+    unlocatedOps++;
+
+  IRBuilder<> builder(inst->getNextNode());
+  Value *result = inst;
+  std::vector<Value *> operands;
+  int operationType = getOperationType(inst);
+  if (AtomicRMWInst *atomic = dyn_cast<AtomicRMWInst>(inst)) {
+    operands.push_back(atomic);
+    operands.push_back(atomic->getValOperand());
+    if (operationType == 0)
+      result = builder.CreateFAdd(atomic, atomic->getValOperand(), "my");
+    else
+      result = builder.CreateFSub(atomic, atomic->getValOperand(), "my");
+    // The shadow computation does not record it as a site
+    cast<Instruction>(result)->setDebugLoc(DebugLoc());
+    cast<Instruction>(result)->setMetadata("fpc.recomputed", MDNode::get(mod->getContext(), {}));
+  } else if (operationType == 6) {
+    // Masked vector variants also take the mask
+    CallInst *call = cast<CallInst>(inst);
+    for (unsigned i = 0; i < call->arg_size() && operands.size() < 2; ++i)
+      if (call->getArgOperand(i)->getType() == type)
+        operands.push_back(call->getArgOperand(i));
+    if (operands.empty())
+      return 0;
+  } else if (operationType == 8 || operationType == 9) {
+    operands.push_back(inst->getOperand(0));
+  } else {
+    unsigned n = isFMAOperation(inst) ? 3 : 2;
+    for (unsigned i = 0; i < n; ++i)
+      operands.push_back(inst->getOperand(i));
+  }
+  assert(operationType >= 0 && "Unknown operation");
+
+  Function *check = nullptr;
+  if (operationType == 7)
+    check = elemType->isFloatTy() ? fp32_fma_check_function : fp64_fma_check_function;
+  else if (operationType == 6)
+    check = elemType->isFloatTy() ? fp32_call_check_function : fp64_call_check_function;
+  else if (operationType == 8 && inst->getType()->getScalarType()->isHalfTy())
+    check = fp16_trunc_check_function;
+  else if (operationType == 8 && inst->getType()->getScalarType()->isBFloatTy())
+    check = bf16_trunc_check_function;
+  else if (operationType == 8)
+    check = fp64_trunc_check_function;
+  else if (operationType == 9 && elemType->isHalfTy())
+    check = fp16_toint_check_function;
+  else if (operationType == 9 && elemType->isBFloatTy())
+    check = bf16_toint_check_function;
+  else if (operationType == 9)
+    check = elemType->isFloatTy() ? fp32_toint_check_function : fp64_toint_check_function;
+  else if (elemType->isHalfTy())
+    check = fp16_check_function;
+  else if (elemType->isBFloatTy())
+    check = bf16_check_function;
+  else if (elemType->isX86_FP80Ty())
+    check = fp80_check_function;
+  else if (elemType->isFP128Ty())
+    check = fp128_check_function;
+  else
+    check = elemType->isFloatTy() ? fp32_check_function : fp64_check_function;
+  assert(check && "Function not initialized!");
+
+  std::string fileName;
+  Constant *fileNameStr = getFileNameString(inst, fileName);
+  ConstantInt *locId = ConstantInt::get(mod->getContext(), APInt(32, lineNumber, true));
+  ConstantInt *opType = ConstantInt::get(mod->getContext(),
+      APInt(32, operationType | (getFastMathFlags(inst) << 8), true));
+  ConstantInt *fastMath = ConstantInt::get(mod->getContext(),
+      APInt(32, getFastMathFlags(inst), true));
+  ConstantInt *cond = ConstantInt::get(mod->getContext(), APInt(32, 1, true));
+  ConstantInt *numArgs = ConstantInt::get(mod->getContext(), APInt(32, operands.size(), true));
+  Value *functionName = nullptr;
+  if (operationType == 6)
+    functionName = builder.CreateGlobalStringPtr(getMathFunction(inst), "_FPC_FUNCTION_NAME_");
+
+  unsigned lanes = 1;
+  if (FixedVectorType *vecType = dyn_cast<FixedVectorType>(type))
+    lanes = vecType->getNumElements();
+  for (unsigned lane = 0; lane < lanes; ++lane) {
+    // Half and bfloat values are passed as float
+    auto getLane = [&](Value *v) -> Value * {
+      if (type->isVectorTy())
+        v = builder.CreateExtractElement(v, (uint64_t)lane, "my");
+      if (v->getType()->isHalfTy() || v->getType()->isBFloatTy())
+        v = builder.CreateFPExt(v, builder.getFloatTy(), "my");
+      return v;
+    };
+
+    std::vector<Value *> args;
+    if (isCmpEqual(inst))
+      args.push_back(halfType ? ConstantFP::get(builder.getFloatTy(), 0.0) :
+                                ConstantFP::get(elemType, 0.0));
+    else if (operationType != 9)  // the integer result is not needed
+      args.push_back(getLane(result));
+    for (Value *v : operands)
+      args.push_back(getLane(v));
+    if (operationType == 8 && check != fp64_trunc_check_function) {
+      // Truncations to half or bfloat take the value as double
+      if (elemType->isFloatTy())
+        args.back() = builder.CreateFPExt(args.back(), builder.getDoubleTy(), "my");
+      args.push_back(ConstantInt::get(mod->getContext(),
+          APInt(32, elemType->isFloatTy() ? 32 : 64, true)));
+    } else if (operationType == 6) {
+      if (operands.size() == 1)
+        args.push_back(ConstantFP::get(elemType, 0.0));
+      args.push_back(numArgs);
+    } else if (operationType == 9) {
+      args.push_back(ConstantInt::get(mod->getContext(),
+          APInt(32, inst->getType()->getScalarSizeInBits(), true)));
+      args.push_back(ConstantInt::get(mod->getContext(),
+          APInt(32, inst->getOpcode() == Instruction::FPToSI, true)));
+    }
+    args.push_back(locId);
+    args.push_back(fileNameStr);
+    if (operationType == 6)
+      args.push_back(functionName);
+    if (operationType == 6 || operationType == 7)
+      args.push_back(fastMath);
+    else if (operationType < 6)
+      args.push_back(opType);
+    args.push_back(cond);
+
+    CallInst *callInst = builder.CreateCall(check, ArrayRef<Value *>(args));
+    assert(callInst && "Invalid call instruction!");
+    setFakeDebugLocation(inst, callInst, f);
+  }
+  return lanes;
+}
+
+
+/**
+ * Shadow computation
+ * -------------------
+ * FPC_SHADOW=1 (at compile time) computes each float operation also in
+ * double, and each double operation also in quad precision (fp128). The
+ * shadow of a result is computed from the shadows of its operands, so the
+ * shadow values follow the computation through the operations, phi nodes,
+ * selects, negations and conversions of a function; values from memory,
+ * arguments, calls and constants start new shadows. The error of each
+ * result against its shadow is recorded by _FPC_SHADOW_FP32_ and
+ * _FPC_SHADOW_FP64_. This runs after instrumentFunction, so the checks
+ * are not affected by the new uses of the operations.
+ **/
+void CPUFPInstrumentation::shadowFunction(Function *f)
+{
+  if (!shadowMode || CUDAAnalysis::CodeMatching::isUnwantedFunction(f))
+    return;
+  assert(fp32_shadow_function && fp64_shadow_function && "Shadow functions not initialized!");
+
+  // Operands are visited before their uses, except through phi nodes
+  std::vector<Instruction *> insts;
+  ReversePostOrderTraversal<Function *> rpot(f);
+  for (BasicBlock *bb : rpot)
+    for (Instruction &i : *bb)
+      insts.push_back(&i);
+
+  std::map<Value *, Value *> shadows;
+  std::vector<std::pair<PHINode *, PHINode *> > phis;
+  for (Instruction *inst : insts) {
+    Type *shadowTy = getShadowType(inst->getType());
+    if (shadowTy == nullptr)
+      continue;
+
+    // Incoming shadows are added when all the blocks are shadowed
+    if (PHINode *phi = dyn_cast<PHINode>(inst)) {
+      IRBuilder<> builder(phi);
+      PHINode *s = builder.CreatePHI(shadowTy, phi->getNumIncomingValues(), "fpc_shadow");
+      shadows[phi] = s;
+      phis.push_back(std::make_pair(phi, s));
+      continue;
+    }
+
+    IRBuilder<> builder(inst->getNextNode());
+    Value *s = nullptr;
+    switch (inst->getOpcode()) {
+    case Instruction::FAdd:
+    case Instruction::FSub:
+    case Instruction::FMul:
+    case Instruction::FDiv:
+    case Instruction::FRem:
+      s = builder.CreateBinOp((Instruction::BinaryOps)inst->getOpcode(),
+          getShadow(inst->getOperand(0), shadowTy, builder, shadows),
+          getShadow(inst->getOperand(1), shadowTy, builder, shadows), "fpc_shadow");
+      break;
+    case Instruction::FNeg:
+      s = builder.CreateFNeg(getShadow(inst->getOperand(0), shadowTy, builder, shadows), "fpc_shadow");
+      break;
+    case Instruction::FPExt:
+    case Instruction::FPTrunc: {
+      Type *operandTy = getShadowType(inst->getOperand(0)->getType());
+      if (operandTy == nullptr)
+        continue;
+      s = builder.CreateFPCast(getShadow(inst->getOperand(0), operandTy, builder, shadows),
+          shadowTy, "fpc_shadow");
+      break;
+    }
+    case Instruction::Select:
+      s = builder.CreateSelect(inst->getOperand(0),
+          getShadow(inst->getOperand(1), shadowTy, builder, shadows),
+          getShadow(inst->getOperand(2), shadowTy, builder, shadows), "fpc_shadow");
+      break;
+    default:
+      continue;
+    }
+    shadows[inst] = s;
+
+    if (isFPOperation(inst) && !inst->getMetadata("fpc.recomputed"))
+      recordShadow(inst, s, builder, f);
+  }
+
+  for (auto &p : phis) {
+    PHINode *phi = p.first;
+    PHINode *s = p.second;
+    for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i) {
+      BasicBlock *bb = phi->getIncomingBlock(i);
+      // A block can appear more than once; it must have the same value
+      int index = s->getBasicBlockIndex(bb);
+      if (index >= 0) {
+        s->addIncoming(s->getIncomingValue(index), bb);
+        continue;
+      }
+      IRBuilder<> builder(bb->getTerminator());
+      s->addIncoming(getShadow(phi->getIncomingValue(i), s->getType(), builder, shadows), bb);
+    }
+  }
+}
+
+/* Shadow types: double for float and quad precision for double */
+Type *CPUFPInstrumentation::getShadowType(Type *t)
+{
+  if (t->isFloatTy())
+    return Type::getDoubleTy(t->getContext());
+  if (t->isDoubleTy())
+    return Type::getFP128Ty(t->getContext());
+  return nullptr;
+}
+
+/* Returns the shadow of v, or v extended to the shadow type at the insertion
+point of builder if v has no shadow. */
+Value *CPUFPInstrumentation::getShadow(Value *v, Type *shadowTy, IRBuilder<> &builder,
+    std::map<Value *, Value *> &shadows)
+{
+  auto it = shadows.find(v);
+  if (it != shadows.end())
+    return it->second;
+
+  // The result of an emulated (FPC_EMULATE) or perturbed (FPC_PERTURB)
+  // operation has the shadow of the operation
+  if (CallInst *call = dyn_cast<CallInst>(v)) {
+    if (call->arg_size() > 0 && isReplacementCall(call, call->getArgOperand(0))) {
+      it = shadows.find(call->getArgOperand(0));
+      if (it != shadows.end())
+        return it->second;
+    }
+  }
+  return builder.CreateFPCast(v, shadowTy, "fpc_shadow");
+}
+
+/* Calls the shadow function with the result of inst (or its emulated or
+perturbed result) and its shadow. */
+void CPUFPInstrumentation::recordShadow(Instruction *inst, Value *shadow,
+    IRBuilder<> &builder, Function *f)
+{
+  Value *result = inst;
+  for (User *U : inst->users()) {
+    if (CallInst *call = dyn_cast<CallInst>(U)) {
+      if (isReplacementCall(call, inst)) {
+        result = call;
+        builder.SetInsertPoint(call->getNextNode());
+      }
+    }
+  }
+
+  std::string fileName;
+  Constant *fileNameStr = getFileNameString(inst, fileName);
+
+  int operationType = 0;
+  if      (inst->getOpcode() == Instruction::FAdd) operationType=0;
+  else if (inst->getOpcode() == Instruction::FSub) operationType=1;
+  else if (inst->getOpcode() == Instruction::FMul) operationType=2;
+  else if (inst->getOpcode() == Instruction::FDiv) operationType=3;
+  else if (inst->getOpcode() == Instruction::FRem) operationType=5;
+
+  std::vector<Value *> args;
+  args.push_back(result);
+  args.push_back(shadow);
+  args.push_back(ConstantInt::get(mod->getContext(),
+      APInt(32, getLine(inst), true)));
+  args.push_back(fileNameStr);
+  args.push_back(ConstantInt::get(mod->getContext(), APInt(32, operationType, true)));
+  Function *record = inst->getType()->isFloatTy() ? fp32_shadow_function : fp64_shadow_function;
+  CallInst *callInst = builder.CreateCall(record, ArrayRef<Value *>(args));
+  assert(callInst && "Invalid call instruction!");
+  setFakeDebugLocation(inst, callInst, f);
+  shadowedOps++;
+}
 
 // We check if the instruction inst is used only by a select instruction.
 // If that is the case, we set the condition value and select instruction.
@@ -373,6 +1296,72 @@ bool CPUFPInstrumentation::isFPOperation(const Instruction *inst)
 				 );
 }
 
+bool CPUFPInstrumentation::isFMAOperation(const Instruction *inst)
+{
+  if (const IntrinsicInst *call = dyn_cast<IntrinsicInst>(inst))
+    return (call->getIntrinsicID() == Intrinsic::fma ||
+            call->getIntrinsicID() == Intrinsic::fmuladd);
+  return false;
+}
+
+/* fptrunc from double to float and from float or double to half or bfloat,
+and fptosi and fptoui from float, double, half or bfloat (or vectors of
+them) to integers of up to 64 bits */
+bool CPUFPInstrumentation::isConversionOperation(const Instruction *inst)
+{
+  Type *from = inst->getOperand(0)->getType()->getScalarType();
+  Type *to = inst->getType()->getScalarType();
+  if (inst->getOpcode() == Instruction::FPTrunc) {
+    if (to->isHalfTy() || to->isBFloatTy())
+      return from->isFloatTy() || from->isDoubleTy();
+    return from->isDoubleTy() && to->isFloatTy();
+  }
+  if (inst->getOpcode() == Instruction::FPToSI || inst->getOpcode() == Instruction::FPToUI)
+    return !from->isX86_FP80Ty() && !from->isFP128Ty() && to->getScalarSizeInBits() <= 64;
+  return false;
+}
+
+bool CPUFPInstrumentation::isAtomicFPOperation(const Instruction *inst)
+{
+  if (const AtomicRMWInst *atomic = dyn_cast<AtomicRMWInst>(inst))
+    return (atomic->getOperation() == AtomicRMWInst::FAdd ||
+            atomic->getOperation() == AtomicRMWInst::FSub);
+  return false;
+}
+
+/* Operation type of the runtime (see the operations table in
+Runtime_cpu.h), or -1 */
+int CPUFPInstrumentation::getOperationType(const Instruction *inst)
+{
+  if (const AtomicRMWInst *atomic = dyn_cast<AtomicRMWInst>(inst))
+    return (atomic->getOperation() == AtomicRMWInst::FAdd) ? 0 : 1;
+  if (isFMAOperation(inst))                         return 7;
+  if (isa<CallInst>(inst))                          return 6; // math functions
+  if (inst->getOpcode() == Instruction::FPTrunc)    return 8;
+  if (inst->getOpcode() == Instruction::FPToSI ||
+      inst->getOpcode() == Instruction::FPToUI)     return 9;
+  if      (inst->getOpcode() == Instruction::FAdd) return 0;
+  else if (inst->getOpcode() == Instruction::FSub) return 1;
+  else if (inst->getOpcode() == Instruction::FMul) return 2;
+  else if (inst->getOpcode() == Instruction::FDiv) return 3;
+  else if (isCmpEqual(inst))                       return 4;
+  else if (inst->getOpcode() == Instruction::FRem) return 5;
+  return -1;
+}
+
+/* Fast-math flags of an instruction, with bit i for flag i of
+_FPC_FAST_MATH_NAMES_ (FPC_Hashtable.h) */
+int CPUFPInstrumentation::getFastMathFlags(const Instruction *inst)
+{
+  if (!isa<FPMathOperator>(inst))
+    return 0;
+  FastMathFlags fmf = inst->getFastMathFlags();
+  return (fmf.allowReassoc()    ? 1  : 0) | (fmf.noNaNs()          ? 2  : 0) |
+         (fmf.noInfs()          ? 4  : 0) | (fmf.noSignedZeros()   ? 8  : 0) |
+         (fmf.allowReciprocal() ? 16 : 0) | (fmf.allowContract()   ? 32 : 0) |
+         (fmf.approxFunc()      ? 64 : 0);
+}
+
 bool CPUFPInstrumentation::isDoubleFPOperation(const Instruction *inst)
 {
 	if (!isFPOperation(inst))
@@ -389,6 +1378,42 @@ bool CPUFPInstrumentation::isSingleFPOperation(const Instruction *inst)
 	return inst->getOperand(0)->getType()->isFloatTy();
 }
 
+/**
+ * Locations
+ * ----------
+ * The sites are identified by the file and line of the debug location of
+ * the operation; the wrappers build with -gline-tables-only, which is
+ * enough, unless the command has its own -g flag. When an operation does
+ * not have a location (e.g., the file is built with -g0, or a pass dropped
+ * it), the line of the function (DISubprogram) is used, or 0 if the
+ * function has no debug information, and the file is the file of the
+ * function or of the module. The checks are then reported per function or
+ * per file instead of per line.
+ **/
+int CPUFPInstrumentation::getLine(const Instruction *inst)
+{
+  if (DILocation *loc = inst->getDebugLoc())
+    return (int)loc->getLine();
+  if (DISubprogram *sp = inst->getFunction()->getSubprogram())
+    return (int)sp->getLine();
+  return 0;
+}
+
+std::string CPUFPInstrumentation::getFileName(const Instruction *inst)
+{
+  if (inst->getDebugLoc())
+    return CUDAAnalysis::getFileNameFromInstruction(inst);
+  if (DISubprogram *sp = inst->getFunction()->getSubprogram())
+    return sp->getDirectory().str() + "/" + sp->getFilename().str();
+  SmallString<256> path(mod->getSourceFileName());
+  sys::fs::make_absolute(path);
+  return path.str().str();
+}
+
+/* Copies the location of old_inst, or of another instruction of f, to
+new_inst. In a function with debug information, calls to inlinable
+functions must have a location, so the line of the function is used if
+no instruction has one. */
 void CPUFPInstrumentation::setFakeDebugLocation(Instruction *old_inst, Instruction *new_inst, Function *f) {
   auto di = old_inst->getDebugLoc();
   if (!di) { // couldn't find debug info
@@ -407,8 +1432,8 @@ void CPUFPInstrumentation::setFakeDebugLocation(Instruction *old_inst, Instructi
     return;
   }
   // IF we reach it, it means we couldn't find debug information
-  //new_inst->eraseFromParent();
-  assert(new_inst->getDebugLoc() && "Invalid debug loc! Please use -g");
+  if (DISubprogram *sp = f->getSubprogram())
+    new_inst->setDebugLoc(DILocation::get(f->getContext(), sp->getLine(), 0, sp));
 }
 
 //void CPUFPInstrumentation::setFakeDebugLocation(Function *f, Instruction *inst)
@@ -483,15 +1508,7 @@ void CPUFPInstrumentation::instrumentMainFunction(Function *f)
   assert(callInst && "Invalid call instruction!");
  
   // Set debug location 
-  for (auto i=bb->begin(), bend=bb->end(); i != bend; ++i) {
-    Instruction *inst = &(*i);
-    if (inst->getDebugLoc()) {
-      callInst->setDebugLoc(inst->getDebugLoc());
-      break;
-    }
-  }
-  //callInst->setDebugLoc(inst->getDebugLoc());
-  assert(callInst->getDebugLoc() && "Invalid debug loc! Please use -g");
+  setFakeDebugLocation(inst, callInst, f);
 
 
   /// ------------------ END ----------------------------
@@ -505,8 +1522,7 @@ void CPUFPInstrumentation::instrumentMainFunction(Function *f)
         IRBuilder<> builder(inst);
         auto callInst = builder.CreateCall(fpc_print_locations, args_ref);
         assert(callInst && "Invalid call instruction!");
-        callInst->setDebugLoc(inst->getDebugLoc());
-        assert(callInst->getDebugLoc() && "Invalid debug loc! Please use -g");
+        setFakeDebugLocation(inst, callInst, f);
       }
     }
   }
@@ -5,7 +5,10 @@
 
 #include "CommonTypes.h"
 #include "llvm/IR/IRBuilder.h"
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 using namespace llvm;
 
@@ -19,10 +22,55 @@ private:
 
   Function *fp32_check_function;
   Function *fp64_check_function;
+  Function *fp32_fma_check_function;
+  Function *fp64_fma_check_function;
+  Function *fp32_call_check_function;
+  Function *fp64_call_check_function;
+  Function *fp64_trunc_check_function;
+  Function *fp32_toint_check_function;
+  Function *fp64_toint_check_function;
+  Function *fp16_check_function;
+  Function *bf16_check_function;
+  Function *fp80_check_function;
+  Function *fp128_check_function;
+  Function *fp16_trunc_check_function;
+  Function *bf16_trunc_check_function;
+  Function *fp16_toint_check_function;
+  Function *bf16_toint_check_function;
   //Function *fpc_init_htable;
   Function *fpc_init;
   Function *fpc_init_args;
   Function *fpc_print_locations;
+  Function *fp32_emulate_function;
+  Function *fp64_emulate_function;
+  Function *fp32_shadow_function;
+  Function *fp64_shadow_function;
+  Function *fp32_perturb_function;
+  Function *fp64_perturb_function;
+
+  // Reduced-precision emulation (FPC_EMULATE): format and selected code
+  int emulatedFormat;
+  std::vector<std::string> emulatedFiles;
+  std::vector<std::string> emulatedFunctions;
+  std::vector<std::pair<std::string, int> > emulatedSites;
+  long int emulatedOps;
+
+  // Math functions whose calls are checked (FPC_MATH_FUNCTIONS)
+  std::set<std::string> mathFunctions;
+
+  // Shadow computation in higher precision (FPC_SHADOW)
+  bool shadowMode;
+  long int shadowedOps;
+
+  // Rounding perturbation (FPC_PERTURB)
+  bool perturbMode;
+  long int perturbedOps;
+
+  // Operations without a debug location (no -g or -gline-tables-only)
+  long int unlocatedOps;
+
+  // Instrumentation at link time (FPC_LTO)
+  bool ltoMode;
 
   // maximum number for a code line
   //int maxNumLocations = 0;
@@ -33,8 +81,25 @@ private:
   //IRBuilder<> createBuilderAfter(Instruction *inst);
   //IRBuilder<> createBuilderBefore(Instruction *inst);
   void setFakeDebugLocation(Instruction *old_inst, Instruction *new_inst, Function *f);
+  int getLine(const Instruction *inst);
+  std::string getFileName(const Instruction *inst);
   Instruction* firstInstrution();
   bool selectedBasedOnCondition(Instruction *inst, Function *f, Instruction **select_inst, Value **condition, int *inv);
+  Constant *getFileNameString(Instruction *inst, std::string &fileName);
+  long int instrumentExtendedOperation(Instruction *inst, Function *f);
+  void readMathFunctions();
+  std::string getMathFunction(const Instruction *inst);
+  void readEmulationOptions();
+  bool isEmulated(Instruction *inst, Function *f, const std::string &fileName, int line);
+  void emulateOperation(Instruction *inst, Value *fileName, ConstantInt *locId,
+      ConstantInt *opType, CallInst *checkCall);
+  void perturbOperation(Instruction *inst, Value *fileName, ConstantInt *locId,
+      ConstantInt *opType, CallInst *checkCall);
+  bool isReplacementCall(const CallInst *call, const Value *inst);
+  static Type *getShadowType(Type *t);
+  Value *getShadow(Value *v, Type *shadowTy, IRBuilder<> &builder,
+      std::map<Value *, Value *> &shadows);
+  void recordShadow(Instruction *inst, Value *shadow, IRBuilder<> &builder, Function *f);
 
   //GlobalVariable* generateIntArrayGlobalVariable(ArrayType *arrType);
   //void createReadFunctionForGlobalArray(GlobalVariable *arr, ArrayType *arrType, std::string funcName);
@@ -44,6 +109,12 @@ public:
   CPUFPInstrumentation(Module *M);
   void instrumentFunction(Function *f, long int *c);
   void instrumentMainFunction(Function *f);
+  void shadowFunction(Function *f);
+  void prepareForLTO();
+  long int getEmulatedOperations() { return emulatedOps; }
+  long int getShadowedOperations() { return shadowedOps; }
+  long int getPerturbedOperations() { return perturbedOps; }
+  long int getUnlocatedOperations() { return unlocatedOps; }
   //void generateCodeForInterruption();
   //void instrumentErrorArray();
   //void instrumentEndOfKernel(Function *f);
@@ -54,6 +125,11 @@ public:
   static bool isFPOperation(const Instruction *inst);
   static bool isDoubleFPOperation(const Instruction *inst);
   static bool isSingleFPOperation(const Instruction *inst);
+  static bool isFMAOperation(const Instruction *inst);
+  static bool isAtomicFPOperation(const Instruction *inst);
+  static bool isConversionOperation(const Instruction *inst);
+  static int getOperationType(const Instruction *inst);
+  static int getFastMathFlags(const Instruction *inst);
   //static bool isMainFunction(Function *f);
   //bool errorsDontAbortMode();
   static bool isCmpEqual(const Instruction *inst);
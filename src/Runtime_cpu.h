@@ -3,25 +3,45 @@
 #define SRC_RUNTIME_CPU_H_
 
 #include "FPC_Hashtable.h"
+#include "FPC_MergeTable.h"
 #include <stdio.h>
 #include <math.h>
+#include <float.h>
 #include <signal.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
-
-#ifdef FPC_MULTI_THREADED
 #include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
+
+// The runtime is included in every file of the program, so the headers of
+// optional features are only included when they are built
+#ifdef FPC_STAGING
+#include <dirent.h>
+#include <sys/file.h>
+#endif
+#ifdef FPC_COLLECTD
+#include <sys/socket.h>
+#include <sys/un.h>
 #endif
 
 #define FPC_MAX(a,b) (((a)>(b))?(a):(b))
 
+/* The runtime is compiled with the floating-point options of the files of
+ * the program. Its own computations (emulation, shadow errors, rounding
+ * errors of the perturbation, products of fused multiply-adds) are kept
+ * precise in -ffast-math builds; values are classified on their bits
+ * (see _FPC_FP32_IS_ZERO_), since precise mode does not restore NaN and
+ * infinity semantics (-ffinite-math-only). */
+#if defined(__clang__)
+#pragma float_control(precise, on, push)
+#endif
+
 /*----------------------------------------------------------------------------*/
 /* Global data                                                                */
 /*----------------------------------------------------------------------------*/
 
-/** We store the file name and directory in this variable **/
-__attribute__((used)) static char *_FPC_FILE_NAME_;
-
 /** Hash table pointer **/
 _FPC_HTABLE_T *_FPC_HTABLE_;
 
@@ -39,10 +59,1057 @@ pthread_mutex_t fpc_lock;
 int _FPC_PROG_INPUTS;
 char ** _FPC_PROG_ARGS;
 
+/** Runtime options (see _FPC_INIT_OPTIONS_) **/
+typedef struct _FPC_OPTIONS_S_ {
+  int site_mode;          // sites are looked up on every execution
+  int profile;            // count executions and cycles per site
+  int binary_traces;      // write traces in the binary format
+  int staging;            // pid counted in the node-local run directory (FPC_LOCAL_DIR)
+  int capture;            // occurrences saved per site and event (FPC_CAPTURE_OCCURRENCES)
+  int ranges;             // profile the exponents of each site (FPC_PROFILE_RANGES)
+  int denormals;          // count the subnormal numbers of each site (FPC_PROFILE_DENORMALS)
+  int ftz_daz;            // subnormals are flushed to zero (FPC_FTZ_DAZ)
+  int perturb;            // rounding of FPC_PERTURB builds: 0 off, 1 random, 2 average
+  uint64_t perturb_seed;  // seed of the random rounding (FPC_PERTURB_SEED)
+  int rank;               // MPI rank of the process, or -1
+  uint64_t start_time;    // nanoseconds (CLOCK_MONOTONIC) at initialization
+} _FPC_OPTIONS_T_;
+
+_FPC_OPTIONS_T_ _FPC_OPTIONS_;
+
+/** Overhead budget state (see _FPC_BUDGET_INIT_) **/
+typedef struct _FPC_BUDGET_S_ {
+  double budget;          // target overhead, e.g., 0.1; 0 means disabled
+  uint64_t period;        // 1 out of period executions of hot sites is checked
+  uint64_t samples;       // timed calls
+  uint64_t cycles;        // estimated cycles in the checking functions (window)
+  uint64_t total_cycles;  // estimated cycles in the checking functions
+  uint64_t window;        // cycle count at the beginning of the window
+  uint64_t start;         // cycle count at initialization
+} _FPC_BUDGET_T_;
+
+_FPC_BUDGET_T_ _FPC_BUDGET_;
+
+/** Trace flushing state (see _FPC_FLUSH_INIT_) **/
+typedef struct _FPC_FLUSH_S_ {
+  int interval;                 // seconds between periodic flushes; 0 means none
+  int thread_running;
+  int finalized;                // traces were written by _FPC_PRINT_LOCATIONS_
+  int busy;                     // a flush is in progress
+  pthread_t thread;
+  sem_t wakeup;                 // wakes up the writer thread (signals or finalization)
+  uint64_t requests;            // flushes requested by the signal handler
+  uint64_t flushed;             // requests served by the writer thread
+  _FPC_ITEM_T_ *buffers[2];     // snapshots of the table (double buffering)
+  uint64_t sizes[2];
+  uint64_t capacities[2];
+  int current;                  // buffer with the snapshot on disk
+  struct sigaction old_term;
+  struct sigaction old_abrt;
+  struct sigaction old_usr1;
+} _FPC_FLUSH_T_;
+
+_FPC_FLUSH_T_ _FPC_FLUSH_;
+
+#ifdef FPC_RECORDER_SIZE
+#define _FPC_RECORDER_SIZE_ FPC_RECORDER_SIZE
+#else
+#define _FPC_RECORDER_SIZE_ 64      // events kept per thread; a power of 2
+#endif
+#define _FPC_RECORDER_SIGNALS_ 5
+#define _FPC_RECORDER_SIGNAL_LIST_ { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT }
+
+/** Event recorded by the flight recorder (see _FPC_RECORDER_ADD_) **/
+typedef struct _FPC_RECORD_S_ {
+  char *file_name;
+  double values[4];     // result and operands
+  uint64_t time;        // nanoseconds since the program started
+  uint32_t line;
+  uint16_t events;      // bit i: event i of _FPC_ITEM_T_
+  uint8_t op;
+  uint8_t bits;
+  uint8_t num_operands;
+} _FPC_RECORD_T_;
+
+/** Ring of the last events of a thread **/
+typedef struct _FPC_RECORDER_S_ {
+  uint64_t head;                    // events recorded by the thread
+  uint64_t thread;                  // pthread_self()
+  struct _FPC_RECORDER_S_ *next;    // recorder of another thread
+  _FPC_RECORD_T_ records[_FPC_RECORDER_SIZE_];
+} _FPC_RECORDER_T_;
+
+/** Flight recorder state (see _FPC_RECORDER_INIT_) **/
+typedef struct _FPC_RECORDERS_S_ {
+  int enabled;
+  int dumped;                       // the recorders were written
+  _FPC_RECORDER_T_ *threads;        // recorders of all the threads
+  struct sigaction old_actions[_FPC_RECORDER_SIGNALS_];
+  char dir_name[4096];              // trace directory
+  char file_name[4096];             // trace path without the pid and extension
+} _FPC_RECORDERS_T_;
+
+/** Buffered output of the flight recorder (see _FPC_RECORDER_WRITE_) **/
+typedef struct _FPC_RECORDER_OUT_S_ {
+  int fd;
+  size_t len;
+  char buf[4096];
+} _FPC_RECORDER_OUT_T_;
+
+_FPC_RECORDERS_T_ _FPC_RECORDERS_;
+__thread _FPC_RECORDER_T_ *_FPC_THREAD_RECORDER_;
+
+#define _FPC_SITE_TIMING_PERIOD_    16      // time 1 out of 16 executions of a site
+#define _FPC_BUDGET_ADJUST_PERIOD_  256     // adjust sampling every 256 timed executions
+#define _FPC_BUDGET_MAX_PERIOD_     65536
+#ifdef FPC_BUDGET_HOT_SITE
+#define _FPC_BUDGET_HOT_SITE_ FPC_BUDGET_HOT_SITE
+#else
+#define _FPC_BUDGET_HOT_SITE_ 1000      // executions before a site is hot
+#endif
+
+/*----------------------------------------------------------------------------*/
+/* Cycle counter                                                              */
+/*----------------------------------------------------------------------------*/
+
+uint64_t _FPC_READ_CYCLES_() {
+#if defined(__x86_64__) || defined(__i386__)
+  return (uint64_t)__builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+  uint64_t val;
+  __asm__ __volatile__("mrs %0, cntvct_el0" : "=r" (val));
+  return val;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
 /*----------------------------------------------------------------------------*/
 /* Initialize                                                                 */
 /*----------------------------------------------------------------------------*/
 
+/**
+ * Overhead budget
+ * ----------------
+ * FPC_OVERHEAD_BUDGET=10% (or 0.1) bounds the time spent in the checking
+ * functions to a fraction of the time spent in the program. Time in the
+ * checks is estimated by timing 1 out of _FPC_SITE_TIMING_PERIOD_ executions
+ * of each site. Every _FPC_BUDGET_ADJUST_PERIOD_ timed executions the
+ * sampling period of hot sites
+ * (more than _FPC_BUDGET_HOT_SITE_ executions) is doubled if the overhead
+ * is above the budget, or halved if it is below half of the budget.
+ * Cold sites are always checked.
+ **/
+void _FPC_BUDGET_INIT_() {
+  memset((void *)&_FPC_BUDGET_, 0, sizeof(_FPC_BUDGET_));
+  _FPC_BUDGET_.period = 1;
+
+  char *budget = getenv("FPC_OVERHEAD_BUDGET");
+  if (budget == NULL)
+    return;
+
+  char *end = NULL;
+  double val = strtod(budget, &end);
+  if (end == budget || val <= 0.0) {
+    printf("#FPCHECKER: Invalid overhead budget: %s\n", budget);
+    return;
+  }
+  if (*end == '%' || val > 1.0)
+    val = val / 100.0;
+
+  _FPC_BUDGET_.budget = val;
+  _FPC_BUDGET_.start = _FPC_READ_CYCLES_();
+  _FPC_BUDGET_.window = _FPC_BUDGET_.start;
+  printf("#FPCHECKER: Overhead budget: %.1f%%\n", _FPC_BUDGET_.budget*100.0);
+}
+
+#define _FPC_CAPTURE_MAX_  64
+
+uint64_t _FPC_TIME_NS_() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/** MPI rank set by the launcher, or -1. The rank is known before
+ * MPI_Init, and programs do not need to be built with mpicc-fpchecker. **/
+int _FPC_PROCESS_RANK_() {
+  const char *vars[] = { "OMPI_COMM_WORLD_RANK", "PMI_RANK", "PMIX_RANK",
+                         "MV2_COMM_WORLD_RANK", "SLURM_PROCID" };
+  for (unsigned i = 0; i < sizeof(vars) / sizeof(vars[0]); ++i) {
+    char *rank = getenv(vars[i]);
+    if (rank != NULL && rank[0] != '\0')
+      return atoi(rank);
+  }
+  return -1;
+}
+
+/**
+ * Runtime options
+ * ----------------
+ * FPC_PROFILE_SITES=1 counts the dynamic executions of each site and
+ * estimates the cycles spent checking it (1 out of _FPC_SITE_TIMING_PERIOD_
+ * executions is timed). Sites without events are also saved in the traces.
+ *
+ * FPC_TRACE_FORMAT=binary writes the traces in the binary format of
+ * FPC_TraceFormat.h instead of JSON (see fpc-convert).
+ *
+ * FPC_LOCAL_DIR writes the traces to node-local storage in programs built
+ * with -DFPC_STAGING (see _FPC_STAGE_INIT_).
+ *
+ * FPC_COLLECTOR sends the traces to fpc-collectd in programs built with
+ * -DFPC_COLLECTD (see _FPC_COLLECTOR_INIT_).
+ *
+ * FPC_CAPTURE_OCCURRENCES=K saves the first K occurrences of each event at
+ * each site (see _FPC_CAPTURE_RECORD_).
+ *
+ * FPC_PROFILE_RANGES=1 profiles the exponents of the results and operands
+ * of each site (see _FPC_RANGE_UPDATE_).
+ *
+ * FPC_PROFILE_DENORMALS=1 counts the subnormal operands and results of
+ * each site (see _FPC_DENORMAL_UPDATE_).
+ *
+ * FPC_FTZ_DAZ=1 flushes subnormal results and operands to zero (see
+ * _FPC_SET_FTZ_DAZ_).
+ *
+ * FPC_PERTURB_MODE=random|average|off selects the rounding of programs
+ * built with FPC_PERTURB=1 (default: random), and FPC_PERTURB_SEED the
+ * seed of the random numbers (default: the time). See _FPC_PERTURB_FP64_.
+ **/
+void _FPC_STAGE_INIT_();
+void _FPC_COLLECTOR_INIT_();
+int _FPC_SET_FTZ_DAZ_();
+
+void _FPC_INIT_OPTIONS_() {
+  memset((void *)&_FPC_OPTIONS_, 0, sizeof(_FPC_OPTIONS_));
+  if (getenv("FPC_PROFILE_SITES") != NULL)
+    _FPC_OPTIONS_.profile = 1;
+  if (getenv("FPC_PROFILE_RANGES") != NULL)
+    _FPC_OPTIONS_.ranges = 1;
+  if (getenv("FPC_PROFILE_DENORMALS") != NULL)
+    _FPC_OPTIONS_.denormals = 1;
+  char *ftz = getenv("FPC_FTZ_DAZ");
+  if (ftz != NULL && strcmp(ftz, "0") != 0) {
+    _FPC_OPTIONS_.ftz_daz = _FPC_SET_FTZ_DAZ_();
+    if (_FPC_OPTIONS_.ftz_daz)
+      printf("#FPCHECKER: Subnormals are flushed to zero (FTZ/DAZ)\n");
+    else
+      printf("#FPCHECKER: FTZ/DAZ is not supported on this architecture\n");
+  }
+
+  char *format = getenv("FPC_TRACE_FORMAT");
+  if (format != NULL) {
+    if (strcmp(format, "binary") == 0)
+      _FPC_OPTIONS_.binary_traces = 1;
+    else if (strcmp(format, "json") != 0)
+      printf("#FPCHECKER: Invalid trace format: %s\n", format);
+  }
+
+  _FPC_OPTIONS_.perturb = 1;
+  char *perturb = getenv("FPC_PERTURB_MODE");
+  if (perturb != NULL) {
+    if (strcmp(perturb, "off") == 0 || strcmp(perturb, "0") == 0)
+      _FPC_OPTIONS_.perturb = 0;
+    else if (strcmp(perturb, "average") == 0)
+      _FPC_OPTIONS_.perturb = 2;
+    else if (strcmp(perturb, "random") != 0)
+      printf("#FPCHECKER: Invalid perturbation mode: %s\n", perturb);
+  }
+  char *seed = getenv("FPC_PERTURB_SEED");
+  if (seed != NULL)
+    _FPC_OPTIONS_.perturb_seed = strtoull(seed, NULL, 10);
+  else
+    _FPC_OPTIONS_.perturb_seed = _FPC_TIME_NS_() ^ (uint64_t)getpid();
+
+  _FPC_OPTIONS_.start_time = _FPC_TIME_NS_();
+  _FPC_OPTIONS_.rank = _FPC_PROCESS_RANK_();
+  char *capture = getenv("FPC_CAPTURE_OCCURRENCES");
+  if (capture != NULL) {
+    _FPC_OPTIONS_.capture = atoi(capture);
+    if (_FPC_OPTIONS_.capture < 0 || _FPC_OPTIONS_.capture > _FPC_CAPTURE_MAX_) {
+      printf("#FPCHECKER: Invalid number of occurrences: %s (max: %d)\n", capture, _FPC_CAPTURE_MAX_);
+      _FPC_OPTIONS_.capture = 0;
+    }
+  }
+
+  _FPC_BUDGET_INIT_();
+  _FPC_OPTIONS_.site_mode = (_FPC_OPTIONS_.profile || _FPC_OPTIONS_.ranges ||
+                             _FPC_OPTIONS_.denormals || _FPC_BUDGET_.budget > 0.0);
+  _FPC_STAGE_INIT_();
+  _FPC_COLLECTOR_INIT_();
+}
+
+/*----------------------------------------------------------------------------*/
+/* Node-local staging                                                         */
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Node-local staging
+ * ----------------
+ * On parallel file systems, a trace per process stresses the metadata
+ * servers at scale. With FPC_LOCAL_DIR (e.g., /tmp or a burst buffer),
+ * processes write binary traces to the node-local run directory
+ * $FPC_LOCAL_DIR/fpc_<FPC_RUN_ID>. The last process of the run to finish
+ * on a node (crashed processes are not waited for) merges the traces of
+ * the run directory into a single trace, <shared dir>/fpc_<run id>_<node>.json,
+ * with the sum, minimum and maximum of the counters over the processes
+ * (see FPC_MergeTable.h). fpc-run sets the variables and stages the traces
+ * of processes that did not finish.
+ *
+ * Staging is built with -DFPC_STAGING (in all the files of the program),
+ * since it needs system headers that are otherwise kept out of the files
+ * of the program. Other builds write the traces to the shared directory.
+ **/
+#ifdef FPC_STAGING
+
+/** Adds (add = 1) or removes this process from the processes of the run
+ * on this node (<run dir>/.processes, one pid per line). Processes that
+ * are no longer running (e.g., they crashed) are removed too. Returns the
+ * locked file, or -1; close() unlocks it. **/
+int _FPC_STAGE_PROCESSES_(int add, int *count) {
+  char fileName[5000];
+  _FPC_TRACE_DIR_(fileName, 1);
+  strcat(fileName, "/.processes");
+
+  int fd = open(fileName, O_RDWR | O_CREAT, 0664);
+  if (fd == -1)
+    return -1;
+  struct stat st;
+  if (flock(fd, LOCK_EX) == -1 || fstat(fd, &st) == -1) {
+    close(fd);
+    return -1;
+  }
+
+  char *buf = (char *)malloc((size_t)st.st_size + 32);
+  if (buf == NULL) {
+    close(fd);
+    return -1;
+  }
+  ssize_t len = pread(fd, buf, (size_t)st.st_size, 0);
+  buf[(len > 0) ? len : 0] = '\0';
+
+  // Pids are rewritten in place: the list only shrinks until this pid is added
+  int pid = (int)getpid();
+  char *out = buf;
+  char *p = buf;
+  *count = 0;
+  while (*p != '\0') {
+    char *end;
+    long other = strtol(p, &end, 10);
+    if (end == p) {
+      p++;
+      continue;
+    }
+    p = end;
+    if (other <= 0 || other == pid || (kill((pid_t)other, 0) == -1 && errno == ESRCH))
+      continue;
+    out += sprintf(out, "%ld\n", other);
+    (*count)++;
+  }
+  if (add) {
+    out += sprintf(out, "%d\n", pid);
+    (*count)++;
+  }
+
+  if (ftruncate(fd, 0) == -1 || pwrite(fd, buf, (size_t)(out - buf), 0) != (out - buf))
+    printf("#FPCHECKER: could not update: %s\n", fileName);
+  free(buf);
+  return fd;
+}
+
+void _FPC_STAGE_INIT_() {
+  char *local_dir = getenv("FPC_LOCAL_DIR");
+  if (local_dir == NULL || local_dir[0] == '\0')
+    return;
+
+  int count = 0;
+  int fd = _FPC_STAGE_PROCESSES_(1, &count);
+  if (fd == -1) {
+    printf("#FPCHECKER: Could not use the local directory: %s\n", local_dir);
+    return;
+  }
+  close(fd);
+  _FPC_OPTIONS_.staging = (int)getpid();
+  _FPC_OPTIONS_.binary_traces = 1;
+}
+
+/** Merges the traces of the run directory into the trace of the node.
+ * Returns the number of traces. **/
+int _FPC_STAGE_MERGE_() {
+  char dirName[5000];
+  _FPC_TRACE_DIR_(dirName, 1);
+  DIR *dir = opendir(dirName);
+  if (dir == NULL)
+    return 0;
+
+  _FPC_MERGE_TABLE_T_ table;
+  _FPC_MERGE_INIT_(&table, 0);
+  int traces = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    size_t ext = strlen(_FPC_TRACE_EXTENSION_);
+    if (strncmp(entry->d_name, "fpc_", 4) != 0 || len <= ext ||
+        strcmp(entry->d_name + len - ext, _FPC_TRACE_EXTENSION_) != 0)
+      continue;
+    char fileName[5300];
+    snprintf(fileName, sizeof(fileName), "%s/%s", dirName, entry->d_name);
+    if (_FPC_MERGE_BINARY_TRACE_(&table, fileName))
+      traces++;
+  }
+  closedir(dir);
+
+  if (traces > 0) {
+    char fileName[5000];
+    _FPC_TRACE_PATH_(fileName, 0, 0, ".json");
+    _FPC_MERGE_WRITE_TRACE_(&table, fileName, 0);
+    printf("#FPCHECKER: Staged %d traces to %s\n", traces, fileName);
+  }
+  _FPC_MERGE_FREE_(&table);
+  return traces;
+}
+
+/** Called after the trace of this process is written. Traces stay in the
+ * run directory, so processes of later steps of the run are merged with
+ * them. **/
+void _FPC_STAGE_TRACES_() {
+  // Forked processes were not counted
+  if (_FPC_OPTIONS_.staging != (int)getpid())
+    return;
+  _FPC_OPTIONS_.staging = 0;
+
+  int count = 0;
+  int fd = _FPC_STAGE_PROCESSES_(0, &count);
+  if (fd == -1)
+    return;
+  if (count == 0)
+    _FPC_STAGE_MERGE_();
+  close(fd);
+}
+
+#else
+
+void _FPC_STAGE_INIT_() {
+  char *local_dir = getenv("FPC_LOCAL_DIR");
+  if (local_dir != NULL && local_dir[0] != '\0')
+    printf("#FPCHECKER: FPC_LOCAL_DIR needs a build with -DFPC_STAGING\n");
+}
+
+void _FPC_STAGE_TRACES_() {}
+
+#endif // FPC_STAGING
+
+/*----------------------------------------------------------------------------*/
+/* Collector                                                                  */
+/*----------------------------------------------------------------------------*/
+
+/** Connection to fpc-collectd (see _FPC_COLLECTOR_INIT_) **/
+typedef struct _FPC_COLLECTOR_S_ {
+  int fd;                     // socket, or -1
+  int used;                   // the collector received deltas
+  _FPC_MERGE_TABLE_T_ sent;   // counters received by the collector
+} _FPC_COLLECTOR_T_;
+
+_FPC_COLLECTOR_T_ _FPC_COLLECTOR_;
+
+/**
+ * Collector
+ * ----------------
+ * Task farms run thousands of short processes, each leaving a trace. With
+ * FPC_COLLECTOR=<socket>, processes send the counters of each site to the
+ * fpc-collectd daemon listening on that Unix socket, which merges them in
+ * memory and writes a single trace per campaign. Only the changes since
+ * the last message (deltas) are sent, at the end of the program and on
+ * every flush (see _FPC_FLUSH_TRACES_). A message is a binary trace (see
+ * FPC_TraceFormat.h) with the deltas of the changed sites; the collector
+ * replies with one byte after merging it.
+ *
+ * When no collector is running, or the connection is lost, traces are
+ * written to files as usual, with the counters the collector did not
+ * receive.
+ *
+ * The collector is built with -DFPC_COLLECTD (in all the files of the
+ * program), since it needs the socket headers. Other builds write the
+ * traces to files.
+ **/
+#ifdef FPC_COLLECTD
+
+void _FPC_COLLECTOR_INIT_() {
+  _FPC_COLLECTOR_.fd = -1;
+  _FPC_COLLECTOR_.used = 0;
+  char *path = getenv("FPC_COLLECTOR");
+  if (path == NULL || path[0] == '\0')
+    return;
+
+  struct sockaddr_un addr;
+  memset((void *)&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    printf("#FPCHECKER: Invalid collector socket: %s\n", path);
+    return;
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1)
+    return;
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    printf("#FPCHECKER: No collector at %s, writing traces to files\n", path);
+    close(fd);
+    return;
+  }
+  struct timeval timeout = {5, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  _FPC_COLLECTOR_.fd = fd;
+  _FPC_COLLECTOR_.used = 1;
+  _FPC_MERGE_INIT_(&(_FPC_COLLECTOR_.sent), 0);
+}
+
+/** Sets the deltas of the sites since the last message. With all, sites
+ * without changes are included too. current keeps the file names of the
+ * deltas. Returns the number of deltas; the caller frees them. **/
+uint64_t _FPC_COLLECTOR_DELTAS_(_FPC_ITEM_T_ *items, uint64_t n, int all,
+                                _FPC_MERGE_TABLE_T_ *current, _FPC_ITEM_T_ **deltas) {
+  _FPC_MERGE_INIT_(current, 0);
+  _FPC_MERGE_ITEMS_(current, items, n, 0);
+
+  *deltas = (_FPC_ITEM_T_ *)calloc(current->n + 1, sizeof(_FPC_ITEM_T_));
+  if (*deltas == NULL) {
+    printf("#FPCHECKER: collector out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+
+  uint64_t m = 0;
+  for (uint64_t k = 0; k < current->n; ++k) {
+    uint64_t *site = _FPC_MERGE_SITE_(current, k);
+    char *file_name = current->strings.data + site[0];
+    uint64_t *sent = _FPC_MERGE_GET_SITE_(&(_FPC_COLLECTOR_.sent), file_name, site[1]);
+    uint64_t d[_FPC_MERGE_COUNTERS_];
+    int changed = 0;
+    for (int c = 0; c < _FPC_MERGE_COUNTERS_; ++c) {
+      d[c] = _FPC_MERGE_SUM_(site)[c] - _FPC_MERGE_SUM_(sent)[c];
+      changed |= (d[c] != 0);
+    }
+    if (!changed && !all)
+      continue;
+
+    _FPC_ITEM_T_ *item = &((*deltas)[m++]);
+    item->file_name = file_name;
+    item->line = site[1];
+    item->infinity_pos = d[0];
+    item->infinity_neg = d[1];
+    item->nan = d[2];
+    item->division_zero = d[3];
+    item->cancellation = d[4];
+    item->comparison = d[5];
+    item->underflow = d[6];
+    item->latent_infinity_pos = d[7];
+    item->latent_infinity_neg = d[8];
+    item->latent_underflow = d[9];
+    item->absorption = d[10];
+    item->executions = d[11];
+    item->cycles = d[12];
+  }
+  return m;
+}
+
+/** Sends the deltas to the collector. Returns 0 if the connection is lost. **/
+int _FPC_COLLECTOR_SEND_(_FPC_ITEM_T_ *deltas, uint64_t n) {
+  uint64_t size = 0;
+  char *buffer = _FPC_BUILD_BINARY_TRACE_(deltas, n, &size);
+  uint64_t sent = 0;
+  while (sent < size) {
+    ssize_t ret = send(_FPC_COLLECTOR_.fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+    if (ret <= 0)
+      break;
+    sent += (uint64_t)ret;
+  }
+  free(buffer);
+
+  // The collector acknowledges each message once it merged it
+  char ack = 0;
+  if (sent < size || recv(_FPC_COLLECTOR_.fd, &ack, 1, 0) != 1)
+    return 0;
+
+  _FPC_MERGE_ITEMS_(&(_FPC_COLLECTOR_.sent), deltas, n, 0);
+  return 1;
+}
+
+/** Sends the changes of the sites to the collector. If it cannot, the
+ * trace file gets the counters the collector did not receive. **/
+void _FPC_COLLECTOR_WRITE_(_FPC_ITEM_T_ *items, uint64_t n, int binary) {
+  _FPC_MERGE_TABLE_T_ current;
+  _FPC_ITEM_T_ *deltas = NULL;
+  int connected = (_FPC_COLLECTOR_.fd != -1);
+  uint64_t m = _FPC_COLLECTOR_DELTAS_(items, n, !connected, &current, &deltas);
+
+  if (connected && (m == 0 || _FPC_COLLECTOR_SEND_(deltas, m))) {
+    free(deltas);
+    _FPC_MERGE_FREE_(&current);
+    return;
+  }
+
+  if (connected) {
+    printf("#FPCHECKER: Lost the collector, writing traces to files\n");
+    close(_FPC_COLLECTOR_.fd);
+    _FPC_COLLECTOR_.fd = -1;
+    free(deltas);
+    _FPC_MERGE_FREE_(&current);
+    m = _FPC_COLLECTOR_DELTAS_(items, n, 1, &current, &deltas);
+  }
+
+  if (binary)
+    _FPC_WRITE_BINARY_TRACE_(deltas, m);
+  else
+    _FPC_WRITE_JSON_TRACE_(deltas, m);
+  free(deltas);
+  _FPC_MERGE_FREE_(&current);
+}
+
+#else
+
+void _FPC_COLLECTOR_INIT_() {
+  _FPC_COLLECTOR_.fd = -1;
+  _FPC_COLLECTOR_.used = 0;
+  char *path = getenv("FPC_COLLECTOR");
+  if (path != NULL && path[0] != '\0')
+    printf("#FPCHECKER: FPC_COLLECTOR needs a build with -DFPC_COLLECTD\n");
+}
+
+void _FPC_COLLECTOR_WRITE_(_FPC_ITEM_T_ *items, uint64_t n, int binary) {}
+
+#endif // FPC_COLLECTD
+
+/*----------------------------------------------------------------------------*/
+/* Trace flushing                                                             */
+/*----------------------------------------------------------------------------*/
+
+void _FPC_PRINT_LOCATIONS_();
+
+void _FPC_WRITE_TRACE_(_FPC_ITEM_T_ *items, uint64_t n) {
+  if (_FPC_COLLECTOR_.used)
+    _FPC_COLLECTOR_WRITE_(items, n, _FPC_OPTIONS_.binary_traces);
+  else if (_FPC_OPTIONS_.binary_traces)
+    _FPC_WRITE_BINARY_TRACE_(items, n);
+  else
+    _FPC_WRITE_JSON_TRACE_(items, n);
+}
+
+/** Writes a snapshot of the table if it changed since the last flush. The
+ * snapshot is taken into one buffer and compared with the previous one in
+ * the other buffer, so only the table is read while the program runs and
+ * unchanged tables are not rewritten. The optional objects of the locations
+ * (occurrences, ranges, etc.) are behind pointers that do not change, so
+ * snapshots with them are always written. With wait, it waits (up to 1 sec)
+ * for a flush in progress in another thread. **/
+void _FPC_FLUSH_TRACES_(int wait) {
+  if (_FPC_HTABLE_ == NULL || __atomic_load_n(&_FPC_FLUSH_.finalized, __ATOMIC_ACQUIRE))
+    return;
+
+  int tries = 0;
+  while (__atomic_exchange_n(&_FPC_FLUSH_.busy, 1, __ATOMIC_ACQUIRE)) {
+    if (!wait || ++tries > 100)
+      return;
+    struct timespec ts = {0, 10000000};
+    nanosleep(&ts, NULL);
+  }
+
+  int prev = _FPC_FLUSH_.current;
+  int next = 1 - prev;
+  uint64_t n = _FPC_HT_SNAPSHOT_(_FPC_HTABLE_, &(_FPC_FLUSH_.buffers[next]),
+                                 &(_FPC_FLUSH_.capacities[next]));
+  int changed = (n != _FPC_FLUSH_.sizes[prev]);
+  if (!changed && n > 0)
+    changed = memcmp((void *)_FPC_FLUSH_.buffers[next], (void *)_FPC_FLUSH_.buffers[prev],
+                     sizeof(_FPC_ITEM_T_) * n) != 0;
+  for (uint64_t i = 0; !changed && i < n; ++i)
+    changed = _FPC_ITEM_HAS_EXTENSIONS_(&(_FPC_FLUSH_.buffers[next][i]));
+  if (changed) {
+    _FPC_WRITE_TRACE_(_FPC_FLUSH_.buffers[next], n);
+    _FPC_FLUSH_.sizes[next] = n;
+    _FPC_FLUSH_.current = next;
+  }
+
+  __atomic_store_n(&_FPC_FLUSH_.busy, 0, __ATOMIC_RELEASE);
+}
+
+void *_FPC_FLUSH_THREAD_(void *arg) {
+  (void)arg;
+  // Signals are handled by the program threads
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGTERM);
+  sigaddset(&set, SIGABRT);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  while (!__atomic_load_n(&_FPC_FLUSH_.finalized, __ATOMIC_ACQUIRE)) {
+    if (_FPC_FLUSH_.interval > 0) {
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_sec += _FPC_FLUSH_.interval;
+      sem_timedwait(&_FPC_FLUSH_.wakeup, &ts);
+    } else {
+      sem_wait(&_FPC_FLUSH_.wakeup);
+    }
+    // Requests received before the snapshot is taken are served by it
+    uint64_t requests = __atomic_load_n(&_FPC_FLUSH_.requests, __ATOMIC_ACQUIRE);
+    _FPC_FLUSH_TRACES_(1);
+    __atomic_store_n(&_FPC_FLUSH_.flushed, requests, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+/** Stops the writer thread. _FPC_FLUSH_.finalized must be set. **/
+void _FPC_FLUSH_STOP_() {
+  if (!_FPC_FLUSH_.thread_running)
+    return;
+  sem_post(&_FPC_FLUSH_.wakeup);
+  pthread_join(_FPC_FLUSH_.thread, NULL);
+  __atomic_store_n(&_FPC_FLUSH_.thread_running, 0, __ATOMIC_RELEASE);
+}
+
+/** Programs that call exit() do not return from main **/
+void _FPC_FLUSH_AT_EXIT_() {
+  if (_FPC_HTABLE_ != NULL && !__atomic_load_n(&_FPC_FLUSH_.finalized, __ATOMIC_ACQUIRE))
+    _FPC_PRINT_LOCATIONS_();
+}
+
+/** Only async-signal-safe functions are called here: the snapshot is written
+ * by the writer thread, since writing it allocates memory and uses stdio,
+ * which may be in use by the interrupted thread. **/
+void _FPC_FLUSH_SIGNAL_HANDLER_(int sig) {
+  uint64_t request = 0;
+  if (__atomic_load_n(&_FPC_FLUSH_.thread_running, __ATOMIC_ACQUIRE)) {
+    request = __atomic_add_fetch(&_FPC_FLUSH_.requests, 1, __ATOMIC_ACQ_REL);
+    sem_post(&_FPC_FLUSH_.wakeup);
+  }
+  if (sig == SIGUSR1)
+    return;
+
+  // The process terminates: wait (up to 1 sec) for the snapshot and run
+  // the previous handler. The wait is bounded because the writer thread may
+  // need a lock held by the interrupted thread.
+  for (int tries = 0; request > 0 && tries < 100; ++tries) {
+    if (__atomic_load_n(&_FPC_FLUSH_.flushed, __ATOMIC_ACQUIRE) >= request ||
+        __atomic_load_n(&_FPC_FLUSH_.finalized, __ATOMIC_ACQUIRE))
+      break;
+    struct timespec ts = {0, 10000000};
+    nanosleep(&ts, NULL);
+  }
+  if (sig == SIGTERM)
+    sigaction(SIGTERM, &_FPC_FLUSH_.old_term, NULL);
+  else
+    sigaction(SIGABRT, &_FPC_FLUSH_.old_abrt, NULL);
+  raise(sig);
+}
+
+/**
+ * Trace flushing
+ * ----------------
+ * Traces are written when main returns. So that events are not lost when
+ * the program calls exit(), is killed, or traps, snapshots of the table
+ * are also written:
+ *   - at exit and before a trap raises SIGABRT,
+ *   - every FPC_FLUSH_INTERVAL seconds, and
+ *   - with FPC_FLUSH_SIGNALS=1, on SIGTERM and SIGABRT (before the previous
+ *     handler runs) and on SIGUSR1.
+ * Periodic and signal snapshots are written by a writer thread, which is
+ * only created for them; the signal handlers only wake it up, and only the
+ * handlers of SIGTERM and SIGABRT wait for it (up to 1 sec). The program
+ * threads never wait for the writer thread. Traces are replaced
+ * atomically, so the trace on disk is always a complete snapshot.
+ **/
+void _FPC_FLUSH_INIT_() {
+  memset((void *)&_FPC_FLUSH_, 0, sizeof(_FPC_FLUSH_));
+  sem_init(&_FPC_FLUSH_.wakeup, 0, 0);
+  atexit(_FPC_FLUSH_AT_EXIT_);
+
+  char *interval = getenv("FPC_FLUSH_INTERVAL");
+  if (interval != NULL) {
+    _FPC_FLUSH_.interval = atoi(interval);
+    if (_FPC_FLUSH_.interval <= 0) {
+      printf("#FPCHECKER: Invalid flush interval: %s\n", interval);
+      _FPC_FLUSH_.interval = 0;
+    }
+  }
+
+  char *signals = getenv("FPC_FLUSH_SIGNALS");
+  int handlers = (signals != NULL && strcmp(signals, "0") != 0);
+  if (handlers || _FPC_FLUSH_.interval > 0) {
+    if (pthread_create(&_FPC_FLUSH_.thread, NULL, _FPC_FLUSH_THREAD_, NULL) == 0) {
+      __atomic_store_n(&_FPC_FLUSH_.thread_running, 1, __ATOMIC_RELEASE);
+      if (_FPC_FLUSH_.interval > 0)
+        printf("#FPCHECKER: Flushing traces every %d seconds\n", _FPC_FLUSH_.interval);
+    } else {
+      printf("#FPCHECKER: Could not create the trace writer thread\n");
+    }
+  }
+
+  if (handlers) {
+    struct sigaction action;
+    memset((void *)&action, 0, sizeof(action));
+    action.sa_handler = _FPC_FLUSH_SIGNAL_HANDLER_;
+    sigemptyset(&action.sa_mask);
+
+    // Ignored signals stay ignored; SIGUSR1 is only used if the program does not use it
+    sigaction(SIGTERM, NULL, &_FPC_FLUSH_.old_term);
+    if (_FPC_FLUSH_.old_term.sa_handler != SIG_IGN)
+      sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGABRT, NULL, &_FPC_FLUSH_.old_abrt);
+    if (_FPC_FLUSH_.old_abrt.sa_handler != SIG_IGN)
+      sigaction(SIGABRT, &action, NULL);
+    sigaction(SIGUSR1, NULL, &_FPC_FLUSH_.old_usr1);
+    if (_FPC_FLUSH_.old_usr1.sa_handler == SIG_DFL)
+      sigaction(SIGUSR1, &action, NULL);
+  }
+}
+
+/*----------------------------------------------------------------------------*/
+/* Flight recorder                                                            */
+/*----------------------------------------------------------------------------*/
+
+/** Creates the recorder of this thread. Recorders are never freed, so the
+ * events of threads that finished are also written. **/
+_FPC_RECORDER_T_ *_FPC_RECORDER_CREATE_() {
+  _FPC_RECORDER_T_ *r = (_FPC_RECORDER_T_ *)calloc(1, sizeof(_FPC_RECORDER_T_));
+  if (r == NULL)
+    return NULL;
+  r->thread = (uint64_t)pthread_self();
+  r->next = __atomic_load_n(&_FPC_RECORDERS_.threads, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&_FPC_RECORDERS_.threads, &(r->next), r, 1,
+                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+  _FPC_THREAD_RECORDER_ = r;
+  return r;
+}
+
+/** Records an event in the ring of this thread: a few stores, without
+ * locks or allocation (except for the first event of a thread). **/
+void _FPC_RECORDER_ADD_(_FPC_ITEM_T_ *item, double x, const double *operands, int n,
+                        int op, int bits) {
+  _FPC_RECORDER_T_ *r = _FPC_THREAD_RECORDER_;
+  if (r == NULL) {
+    if (!_FPC_RECORDERS_.enabled || (r = _FPC_RECORDER_CREATE_()) == NULL)
+      return;
+  }
+
+  _FPC_RECORD_T_ *e = &(r->records[r->head & (_FPC_RECORDER_SIZE_ - 1)]);
+  e->file_name = item->file_name;
+  e->line = (uint32_t)item->line;
+  e->values[0] = x;
+  for (int i = 0; i < n; ++i)
+    e->values[i + 1] = operands[i];
+  e->num_operands = (uint8_t)n;
+  e->time = _FPC_TIME_NS_() - _FPC_OPTIONS_.start_time;
+  e->events = (uint16_t)(
+      (item->infinity_pos != 0)             | ((item->infinity_neg != 0) << 1) |
+      ((item->nan != 0) << 2)               | ((item->division_zero != 0) << 3) |
+      ((item->cancellation != 0) << 4)      | ((item->comparison != 0) << 5) |
+      ((item->underflow != 0) << 6)         | ((item->latent_infinity_pos != 0) << 7) |
+      ((item->latent_infinity_neg != 0) << 8) | ((item->latent_underflow != 0) << 9) |
+      ((item->absorption != 0) << 10));
+  e->op = (uint8_t)op;
+  e->bits = (uint8_t)bits;
+  __atomic_store_n(&(r->head), r->head + 1, __ATOMIC_RELEASE);
+}
+
+/** Formats v in base 10 or 16 with at least min_digits digits. Returns
+ * the end of the string. **/
+char *_FPC_RECORDER_FORMAT_(char *s, uint64_t v, unsigned base, int min_digits) {
+  char digits[64];
+  int n = 0;
+  do {
+    digits[n++] = "0123456789abcdef"[v % base];
+    v /= base;
+  } while (v != 0 || n < min_digits);
+  while (n > 0)
+    *s++ = digits[--n];
+  *s = '\0';
+  return s;
+}
+
+void _FPC_RECORDER_FLUSH_(_FPC_RECORDER_OUT_T_ *out) {
+  const char *p = out->buf;
+  while (out->len > 0) {
+    ssize_t written = write(out->fd, p, out->len);
+    if (written == -1 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      break;
+    p += written;
+    out->len -= (size_t)written;
+  }
+  out->len = 0;
+}
+
+void _FPC_RECORDER_WRITE_(_FPC_RECORDER_OUT_T_ *out, const char *s) {
+  for (; *s != '\0'; ++s) {
+    if (out->len == sizeof(out->buf))
+      _FPC_RECORDER_FLUSH_(out);
+    out->buf[out->len++] = *s;
+  }
+}
+
+void _FPC_RECORDER_WRITE_NUMBER_(_FPC_RECORDER_OUT_T_ *out, uint64_t v, unsigned base,
+                                 int min_digits) {
+  char s[72];
+  _FPC_RECORDER_FORMAT_(s, v, base, min_digits);
+  _FPC_RECORDER_WRITE_(out, s);
+}
+
+/** Writes the last events of all the threads, oldest first, to
+ * <trace dir>/fpc_<node>_<pid>.flight.txt. It is written once.
+ *
+ * It runs in signal handlers, so it only uses async-signal-safe calls:
+ * the path is set by _FPC_RECORDER_INIT_, numbers are formatted by
+ * _FPC_RECORDER_FORMAT_ and the file is written with write(2). Values are
+ * written as their bits in hex (of a float in 32-bit operations, of a
+ * double otherwise). **/
+void _FPC_RECORDER_DUMP_(const char *reason) {
+  if (!_FPC_RECORDERS_.enabled ||
+      __atomic_exchange_n(&_FPC_RECORDERS_.dumped, 1, __ATOMIC_ACQ_REL))
+    return;
+
+  const char *events[] = { _FPC_TRACE_FIELDS_ };
+  const char *ops[] = { "add", "sub", "mul", "div", "cmp", "rem", "call", "fma",
+                        "trunc", "toint" };
+  char fileName[4200];
+  char *end = fileName;
+  for (const char *p = _FPC_RECORDERS_.file_name; *p != '\0'; ++p)
+    *end++ = *p;
+  *end++ = '_';
+  end = _FPC_RECORDER_FORMAT_(end, (uint64_t)getpid(), 10, 1);
+  strcpy(end, ".flight.txt");
+
+  // The directory may have been removed since the start
+  mkdir(_FPC_RECORDERS_.dir_name, 0775);
+  _FPC_RECORDER_OUT_T_ out;
+  out.len = 0;
+  out.fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+  if (out.fd == -1)
+    return;
+
+  _FPC_RECORDER_WRITE_(&out, "# FPChecker flight recorder: ");
+  _FPC_RECORDER_WRITE_(&out, reason);
+  _FPC_RECORDER_WRITE_(&out, "\n# pid: ");
+  _FPC_RECORDER_WRITE_NUMBER_(&out, (uint64_t)getpid(), 10, 1);
+  _FPC_RECORDER_WRITE_(&out, ", rank: ");
+  if (_FPC_OPTIONS_.rank < 0)
+    _FPC_RECORDER_WRITE_(&out, "-1");
+  else
+    _FPC_RECORDER_WRITE_NUMBER_(&out, (uint64_t)_FPC_OPTIONS_.rank, 10, 1);
+  _FPC_RECORDER_WRITE_(&out, "\n");
+  _FPC_RECORDER_T_ *r = __atomic_load_n(&_FPC_RECORDERS_.threads, __ATOMIC_ACQUIRE);
+  for (; r != NULL; r = r->next) {
+    uint64_t head = __atomic_load_n(&(r->head), __ATOMIC_ACQUIRE);
+    uint64_t n = (head < _FPC_RECORDER_SIZE_) ? head : _FPC_RECORDER_SIZE_;
+    _FPC_RECORDER_WRITE_(&out, "\n# thread 0x");
+    _FPC_RECORDER_WRITE_NUMBER_(&out, r->thread, 16, 1);
+    if (r == _FPC_THREAD_RECORDER_)
+      _FPC_RECORDER_WRITE_(&out, " (this thread)");
+    _FPC_RECORDER_WRITE_(&out, ": last ");
+    _FPC_RECORDER_WRITE_NUMBER_(&out, n, 10, 1);
+    _FPC_RECORDER_WRITE_(&out, " of ");
+    _FPC_RECORDER_WRITE_NUMBER_(&out, head, 10, 1);
+    _FPC_RECORDER_WRITE_(&out, " events\n");
+    _FPC_RECORDER_WRITE_(&out, "# time_ns location op bits result operands events\n");
+    for (uint64_t i = head - n; i < head; ++i) {
+      _FPC_RECORD_T_ *e = &(r->records[i & (_FPC_RECORDER_SIZE_ - 1)]);
+      _FPC_RECORDER_WRITE_NUMBER_(&out, e->time, 10, 1);
+      _FPC_RECORDER_WRITE_(&out, " ");
+      _FPC_RECORDER_WRITE_(&out, e->file_name);
+      _FPC_RECORDER_WRITE_(&out, ":");
+      _FPC_RECORDER_WRITE_NUMBER_(&out, e->line, 10, 1);
+      _FPC_RECORDER_WRITE_(&out, " ");
+      _FPC_RECORDER_WRITE_(&out, (e->op < 10) ? ops[e->op] : "?");
+      _FPC_RECORDER_WRITE_(&out, " ");
+      _FPC_RECORDER_WRITE_NUMBER_(&out, e->bits, 10, 1);
+      for (int j = 0; j <= e->num_operands; ++j) {
+        _FPC_RECORDER_WRITE_(&out, " 0x");
+        if (e->bits == 32) {
+          float f = (float)e->values[j];
+          uint32_t u;
+          memcpy(&u, &f, sizeof(u));
+          _FPC_RECORDER_WRITE_NUMBER_(&out, u, 16, 8);
+        } else {
+          uint64_t u;
+          memcpy(&u, &(e->values[j]), sizeof(u));
+          _FPC_RECORDER_WRITE_NUMBER_(&out, u, 16, 16);
+        }
+      }
+      _FPC_RECORDER_WRITE_(&out, " ");
+      int first = 1;
+      for (int j = 0; j < _FPC_NUM_EVENTS_; ++j) {
+        if (e->events & (1 << j)) {
+          if (!first)
+            _FPC_RECORDER_WRITE_(&out, ",");
+          _FPC_RECORDER_WRITE_(&out, events[j + _FPC_TRACE_FIRST_EVENT_]);
+          first = 0;
+        }
+      }
+      _FPC_RECORDER_WRITE_(&out, "\n");
+    }
+  }
+  _FPC_RECORDER_FLUSH_(&out);
+  close(out.fd);
+
+  out.fd = STDOUT_FILENO;
+  _FPC_RECORDER_WRITE_(&out, "#FPCHECKER: Flight recorder written to ");
+  _FPC_RECORDER_WRITE_(&out, fileName);
+  _FPC_RECORDER_WRITE_(&out, "\n");
+  _FPC_RECORDER_FLUSH_(&out);
+}
+
+void _FPC_RECORDER_SIGNAL_HANDLER_(int sig) {
+  int saved_errno = errno;
+  char reason[32] = "signal ";
+  _FPC_RECORDER_FORMAT_(reason + 7, (uint64_t)sig, 10, 1);
+  _FPC_RECORDER_DUMP_(reason);
+
+  // Run the previous handler (e.g., the trace flush on SIGABRT)
+  const int signals[_FPC_RECORDER_SIGNALS_] = _FPC_RECORDER_SIGNAL_LIST_;
+  for (int i = 0; i < _FPC_RECORDER_SIGNALS_; ++i)
+    if (signals[i] == sig)
+      sigaction(sig, &_FPC_RECORDERS_.old_actions[i], NULL);
+  errno = saved_errno;
+  raise(sig);
+}
+
+/**
+ * Flight recorder
+ * ----------------
+ * Each thread keeps the last _FPC_RECORDER_SIZE_ events it recorded (site,
+ * operation, values, events and time) in a ring, so a trap or a crash
+ * comes with the history that led to it. The rings are written by
+ * _FPC_TRAP_HERE before the program is interrupted, and on SIGSEGV,
+ * SIGBUS, SIGFPE, SIGILL and SIGABRT. The recorder is on by default;
+ * FPC_FLIGHT_RECORDER=0 disables it. Build with -DFPC_RECORDER_SIZE=N to
+ * change the size of the rings.
+ **/
+void _FPC_RECORDER_INIT_() {
+  memset((void *)&_FPC_RECORDERS_, 0, sizeof(_FPC_RECORDERS_));
+  char *recorder = getenv("FPC_FLIGHT_RECORDER");
+  if (recorder != NULL && strcmp(recorder, "0") == 0)
+    return;
+  _FPC_RECORDERS_.enabled = 1;
+  _FPC_TRACE_DIR_(_FPC_RECORDERS_.dir_name, 0);
+  _FPC_TRACE_PATH_(_FPC_RECORDERS_.file_name, 0, 0, "");
+
+  struct sigaction action;
+  memset((void *)&action, 0, sizeof(action));
+  action.sa_handler = _FPC_RECORDER_SIGNAL_HANDLER_;
+  sigemptyset(&action.sa_mask);
+  const int signals[_FPC_RECORDER_SIGNALS_] = _FPC_RECORDER_SIGNAL_LIST_;
+  for (int i = 0; i < _FPC_RECORDER_SIGNALS_; ++i) {
+    sigaction(signals[i], NULL, &_FPC_RECORDERS_.old_actions[i]);
+    if (_FPC_RECORDERS_.old_actions[i].sa_handler != SIG_IGN)
+      sigaction(signals[i], &action, NULL);
+  }
+}
+
 void _FPC_INIT_HASH_TABLE_() {
   printf("#FPCHECKER: Initializing...\n");
   int64_t size = 1000;
@@ -58,18 +1125,52 @@ void _FPC_INIT_HASH_TABLE_() {
 void _FPC_INIT_FPCHECKER() {
   _FPC_PROG_INPUTS = 0;
   _FPC_INIT_HASH_TABLE_();
+  _FPC_INIT_OPTIONS_();
+  _FPC_FLUSH_INIT_();
+  _FPC_RECORDER_INIT_();
 }
 
 void _FPC_INIT_ARGS_FPCHECKER(int argc, char **argv) {
   _FPC_PROG_INPUTS = argc;
   _FPC_PROG_ARGS = argv;
   _FPC_INIT_HASH_TABLE_();
+  _FPC_INIT_OPTIONS_();
+  _FPC_FLUSH_INIT_();
+  _FPC_RECORDER_INIT_();
+}
+
+void _FPC_BUDGET_PRINT_SUMMARY_() {
+  uint64_t elapsed = _FPC_READ_CYCLES_() - _FPC_BUDGET_.start;
+  uint64_t total = __atomic_load_n(&_FPC_BUDGET_.total_cycles, __ATOMIC_RELAXED);
+  double overhead = 0.0;
+  if (elapsed > total)
+    overhead = (double)total / (double)(elapsed - total);
+  printf("#FPCHECKER: Overhead budget: %.1f%%, estimated overhead: %.1f%%, "
+         "sampling period of hot sites: %lu\n", _FPC_BUDGET_.budget*100.0,
+         overhead*100.0, __atomic_load_n(&_FPC_BUDGET_.period, __ATOMIC_RELAXED));
 }
 
 void _FPC_PRINT_LOCATIONS_()
 {
+  // Traces are written once; it also stops the writer thread
+  if (__atomic_exchange_n(&_FPC_FLUSH_.finalized, 1, __ATOMIC_ACQ_REL))
+    return;
+  _FPC_FLUSH_STOP_();
+
   printf("#FPCHECKER: Finalizing and writing traces...\n");
-  _FPC_PRINT_HASH_TABLE_(_FPC_HTABLE_);
+  if (_FPC_BUDGET_.budget > 0.0)
+    _FPC_BUDGET_PRINT_SUMMARY_();
+  if (_FPC_COLLECTOR_.used) {
+    _FPC_ITEM_T_ *items = NULL;
+    uint64_t capacity = 0;
+    uint64_t n = _FPC_HT_SNAPSHOT_(_FPC_HTABLE_, &items, &capacity);
+    _FPC_WRITE_TRACE_(items, n);
+    free(items);
+  } else if (_FPC_OPTIONS_.binary_traces)
+    _FPC_PRINT_HASH_TABLE_BINARY_(_FPC_HTABLE_);
+  else
+    _FPC_PRINT_HASH_TABLE_(_FPC_HTABLE_);
+  _FPC_STAGE_TRACES_();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -92,6 +1193,21 @@ uint32_t _FPC_FP32_GET_MANTISSA(float x) {
   return val;
 }
 
+/** Values are classified on their bits: in programs built with
+ * -ffast-math (-ffinite-math-only), isnan(x), isinf(x) and comparisons
+ * that assume no NaN or infinity may be folded to constants. **/
+int _FPC_FP32_IS_ZERO_(float x) {
+  uint32_t val;
+  memcpy((void *) &val, (void *) &x, sizeof(val));
+  return (val << 1) == 0;
+}
+
+int _FPC_FP32_IS_NEGATIVE_(float x) {
+  uint32_t val;
+  memcpy((void *) &val, (void *) &x, sizeof(val));
+  return (int)(val >> 31);
+}
+
 int _FPC_FP32_IS_INF(float x) {
   if  (_FPC_FP32_GET_EXPONENT(x) == (uint32_t)(255) &&
       _FPC_FP32_GET_MANTISSA(x) == (uint32_t)(0)
@@ -102,28 +1218,33 @@ int _FPC_FP32_IS_INF(float x) {
 
 int _FPC_FP32_IS_INFINITY_POS(float x) {
   if (_FPC_FP32_IS_INF(x))
-    if (x > 0)
+    if (!_FPC_FP32_IS_NEGATIVE_(x))
       return 1;
   return 0;
 }
 
 int _FPC_FP32_IS_INFINITY_NEG(float x) {
   if (_FPC_FP32_IS_INF(x))
-    if (x < 0)
+    if (_FPC_FP32_IS_NEGATIVE_(x))
       return 1;
   return 0;
 }
 
 int _FPC_FP32_IS_NAN(float x) {
-  if (isnan(x))
-      return 1;
+  if (_FPC_FP32_GET_EXPONENT(x) == (uint32_t)(255) &&
+      _FPC_FP32_GET_MANTISSA(x) != (uint32_t)(0))
+    return 1;
   return 0;
 }
 
+int _FPC_FP32_IS_FINITE_(float x) {
+  return _FPC_FP32_GET_EXPONENT(x) != (uint32_t)(255);
+}
+
 int _FPC_FP32_IS_DIVISON_ZERO(float y, float z, int op) {
   if (op == 3)
-    if (y!=0)
-      if (z==0)
+    if (!_FPC_FP32_IS_ZERO_(y))
+      if (_FPC_FP32_IS_ZERO_(z))
         return 1;
 
   return 0;
@@ -146,6 +1267,27 @@ int _FPC_FP32_IS_CANCELLATION(float x, float y, float z, int op) {
   return 0;
 }
 
+/** Absorption: the result of an addition or subtraction is an operand,
+ * although the other operand is not zero (|tiny| <= ulp(acc)/2). Returns
+ * the gap between the exponents of the operands, or 0. **/
+int _FPC_FP32_IS_ABSORPTION(float x, float y, float z, int op) {
+  if ((op != 0 && op != 1) || _FPC_FP32_IS_ZERO_(y) || _FPC_FP32_IS_ZERO_(z) ||
+      !_FPC_FP32_IS_FINITE_(x) || !_FPC_FP32_IS_FINITE_(y) || !_FPC_FP32_IS_FINITE_(z))
+    return 0;
+  // x == y or x == +/-z, compared on the bits (nonzero values)
+  uint32_t bx, by, bz;
+  memcpy((void *) &bx, (void *) &x, sizeof(bx));
+  memcpy((void *) &by, (void *) &y, sizeof(by));
+  memcpy((void *) &bz, (void *) &z, sizeof(bz));
+  if (op == 1)
+    bz ^= 0x80000000u;
+  if (bx != by && bx != bz)
+    return 0;
+  int e1 = (int)_FPC_FP32_GET_EXPONENT(y);
+  int e2 = (int)_FPC_FP32_GET_EXPONENT(z);
+  return (e1 > e2) ? e1 - e2 : e2 - e1;
+}
+
 int _FPC_FP32_IS_COMPARISON(int op) {
   if (op == 4)
     return 1;
@@ -156,7 +1298,7 @@ int _FPC_FP32_IS_COMPARISON(int op) {
 int _FPC_FP32_IS_SUBNORMAL(float x) {
   int ret = 0;
   uint32_t val = _FPC_FP32_GET_EXPONENT(x);
-  if (x != 0.0 && x != -0.0) {
+  if (!_FPC_FP32_IS_ZERO_(x)) {
     if (val == 0)
       ret = 1;
   }
@@ -166,7 +1308,7 @@ int _FPC_FP32_IS_SUBNORMAL(float x) {
 int _FPC_FP32_IS_LATENT_INFINITY(float x) {
   int ret = 0;
   uint32_t val = _FPC_FP32_GET_EXPONENT(x);
-  if (x != 0.0 && x != -0.0){
+  if (!_FPC_FP32_IS_ZERO_(x)){
     uint64_t maxVal = 256 - (uint64_t)(DANGER_ZONE_PERCENTAGE*256.0);
     if (val >= maxVal)
       ret = 1;
@@ -176,7 +1318,7 @@ int _FPC_FP32_IS_LATENT_INFINITY(float x) {
 
 int _FPC_FP32_IS_LATENT_INFINITY_POS(float x) {
   if (_FPC_FP32_IS_LATENT_INFINITY(x))
-    if (x > 0)
+    if (!_FPC_FP32_IS_NEGATIVE_(x) && !_FPC_FP32_IS_NAN(x))
       return 1;
 
   return 0;
@@ -184,7 +1326,7 @@ int _FPC_FP32_IS_LATENT_INFINITY_POS(float x) {
 
 int _FPC_FP32_IS_LATENT_INFINITY_NEG(float x) {
   if (_FPC_FP32_IS_LATENT_INFINITY(x))
-    if (x < 0)
+    if (_FPC_FP32_IS_NEGATIVE_(x) && !_FPC_FP32_IS_NAN(x))
       return 1;
 
   return 0;
@@ -193,7 +1335,7 @@ int _FPC_FP32_IS_LATENT_INFINITY_NEG(float x) {
 int _FPC_FP32_IS_LATENT_SUBNORMAL(float x) {
   int ret = 0;
   uint32_t val = _FPC_FP32_GET_EXPONENT(x);
-  if (x != 0.0 && x != -0.0) {
+  if (!_FPC_FP32_IS_ZERO_(x)) {
     uint64_t minVal = (uint64_t)(DANGER_ZONE_PERCENTAGE*256.0);
     if (val <= minVal)
       ret = 1;
@@ -201,6 +1343,38 @@ int _FPC_FP32_IS_LATENT_SUBNORMAL(float x) {
   return ret;
 }
 
+// Fast path: returns 1 if no event can occur. The result exponent is
+// compared against the latent zones, which also excludes zero, subnormal,
+// infinity and NaN results. It only uses integer operations on the exponents.
+int _FPC_FP32_FAST_PATH_(float x, float y, float z, int op) {
+  if (op == 4)
+    return 0;
+
+  int re = (int)_FPC_FP32_GET_EXPONENT(x);
+  int minVal = (int)(DANGER_ZONE_PERCENTAGE*256.0);
+  int maxVal = 256 - (int)(DANGER_ZONE_PERCENTAGE*256.0);
+  if (re <= minVal || re >= maxVal)
+    return 0;
+
+  if (op == 3 && _FPC_FP32_GET_EXPONENT(z) == 0)
+    return 0;
+
+  if (op == 0 || op == 1) {
+    int e1 = (int)_FPC_FP32_GET_EXPONENT(y);
+    int e2 = (int)_FPC_FP32_GET_EXPONENT(z);
+    if ((FPC_MAX(e1,e2) - re) > 30)
+      return 0;
+    // An operand can only be absorbed 24 or more binades below the other.
+    // The exponent of a subnormal (0) understates the gap, and the danger
+    // zone does not cover all the results that can absorb one.
+    if (!_FPC_FP32_IS_ZERO_(y) && !_FPC_FP32_IS_ZERO_(z) &&
+        (e1 == 0 || e2 == 0 || e1 - e2 >= 24 || e2 - e1 >= 24))
+      return 0;
+  }
+
+  return 1;
+}
+
 /*----------------------------------------------------------------------------*/
 /* Checking functions for events (FP64)                                       */
 /*----------------------------------------------------------------------------*/
@@ -221,6 +1395,19 @@ uint64_t _FPC_FP64_GET_MANTISSA(double x) {
   return val;
 }
 
+/** Classification on the bits (see _FPC_FP32_IS_ZERO_) **/
+int _FPC_FP64_IS_ZERO_(double x) {
+  uint64_t val;
+  memcpy((void *) &val, (void *) &x, sizeof(val));
+  return (val << 1) == 0;
+}
+
+int _FPC_FP64_IS_NEGATIVE_(double x) {
+  uint64_t val;
+  memcpy((void *) &val, (void *) &x, sizeof(val));
+  return (int)(val >> 63);
+}
+
 int _FPC_FP64_IS_INF(double x) {
   if  (_FPC_FP64_GET_EXPONENT(x) == (uint64_t)(2047) &&
       _FPC_FP64_GET_MANTISSA(x) == (uint64_t)(0)
@@ -231,28 +1418,33 @@ int _FPC_FP64_IS_INF(double x) {
 
 int _FPC_FP64_IS_INFINITY_POS(double x) {
   if (_FPC_FP64_IS_INF(x))
-    if (x > 0)
+    if (!_FPC_FP64_IS_NEGATIVE_(x))
       return 1;
   return 0;
 }
 
 int _FPC_FP64_IS_INFINITY_NEG(double x) {
   if (_FPC_FP64_IS_INF(x))
-    if (x < 0)
+    if (_FPC_FP64_IS_NEGATIVE_(x))
       return 1;
   return 0;
 }
 
 int _FPC_FP64_IS_NAN(double x) {
-  if (isnan(x))
-      return 1;
+  if (_FPC_FP64_GET_EXPONENT(x) == (uint64_t)(2047) &&
+      _FPC_FP64_GET_MANTISSA(x) != (uint64_t)(0))
+    return 1;
   return 0;
 }
 
+int _FPC_FP64_IS_FINITE_(double x) {
+  return _FPC_FP64_GET_EXPONENT(x) != (uint64_t)(2047);
+}
+
 int _FPC_FP64_IS_DIVISON_ZERO(double y, double z, int op) {
   if (op == 3)
-    if (y!=0)
-      if (z==0)
+    if (!_FPC_FP64_IS_ZERO_(y))
+      if (_FPC_FP64_IS_ZERO_(z))
         return 1;
 
   return 0;
@@ -277,6 +1469,27 @@ int _FPC_FP64_IS_CANCELLATION(double x, double y, double z, int op) {
   return 0;
 }
 
+/** Absorption: the result of an addition or subtraction is an operand,
+ * although the other operand is not zero (|tiny| <= ulp(acc)/2). Returns
+ * the gap between the exponents of the operands, or 0. **/
+int _FPC_FP64_IS_ABSORPTION(double x, double y, double z, int op) {
+  if ((op != 0 && op != 1) || _FPC_FP64_IS_ZERO_(y) || _FPC_FP64_IS_ZERO_(z) ||
+      !_FPC_FP64_IS_FINITE_(x) || !_FPC_FP64_IS_FINITE_(y) || !_FPC_FP64_IS_FINITE_(z))
+    return 0;
+  // x == y or x == +/-z, compared on the bits (nonzero values)
+  uint64_t bx, by, bz;
+  memcpy((void *) &bx, (void *) &x, sizeof(bx));
+  memcpy((void *) &by, (void *) &y, sizeof(by));
+  memcpy((void *) &bz, (void *) &z, sizeof(bz));
+  if (op == 1)
+    bz ^= 0x8000000000000000ull;
+  if (bx != by && bx != bz)
+    return 0;
+  int e1 = (int)_FPC_FP64_GET_EXPONENT(y);
+  int e2 = (int)_FPC_FP64_GET_EXPONENT(z);
+  return (e1 > e2) ? e1 - e2 : e2 - e1;
+}
+
 int _FPC_FP64_IS_COMPARISON(int op) {
   if (op == 4)
     return 1;
@@ -291,7 +1504,7 @@ int _FPC_FP64_IS_SUBNORMAL(double x)
   //memcpy((void *) &val, (void *) &x, sizeof(val));
   //val = val << 1;   // get rid of sign bit
   //val = val >> 53;  // get rid of the mantissa bits
-  if (x != 0.0 && x != -0.0)
+  if (!_FPC_FP64_IS_ZERO_(x))
   {
     if (val == 0)
       ret = 1;
@@ -303,7 +1516,7 @@ int _FPC_FP64_IS_LATENT_INFINITY(double x)
 {
   int ret = 0;
   uint64_t val = _FPC_FP64_GET_EXPONENT(x);
-  if (x != 0.0 && x != -0.0) {
+  if (!_FPC_FP64_IS_ZERO_(x)) {
     uint64_t maxVal = 2048 - (uint64_t)(DANGER_ZONE_PERCENTAGE*2048.0);
     if (val >= maxVal)
       ret = 1;
@@ -313,7 +1526,7 @@ int _FPC_FP64_IS_LATENT_INFINITY(double x)
 
 int _FPC_FP64_IS_LATENT_INFINITY_POS(double x) {
   if (_FPC_FP64_IS_LATENT_INFINITY(x))
-    if (x > 0)
+    if (!_FPC_FP64_IS_NEGATIVE_(x) && !_FPC_FP64_IS_NAN(x))
       return 1;
 
   return 0;
@@ -321,7 +1534,7 @@ int _FPC_FP64_IS_LATENT_INFINITY_POS(double x) {
 
 int _FPC_FP64_IS_LATENT_INFINITY_NEG(double x) {
   if (_FPC_FP64_IS_LATENT_INFINITY(x))
-    if (x < 0)
+    if (_FPC_FP64_IS_NEGATIVE_(x) && !_FPC_FP64_IS_NAN(x))
       return 1;
 
   return 0;
@@ -330,7 +1543,7 @@ int _FPC_FP64_IS_LATENT_INFINITY_NEG(double x) {
 int _FPC_FP64_IS_LATENT_SUBNORMAL(double x) {
   int ret = 0;
   uint64_t val = _FPC_FP64_GET_EXPONENT(x);
-  if (x != 0.0 && x != -0.0) {
+  if (!_FPC_FP64_IS_ZERO_(x)) {
     uint64_t minVal = (uint64_t)(DANGER_ZONE_PERCENTAGE*2048.0);
     if (val <= minVal)
       ret = 1;
@@ -338,10 +1551,39 @@ int _FPC_FP64_IS_LATENT_SUBNORMAL(double x) {
   return ret;
 }
 
-/*----------------------------------------------------------------------------*/
-/* Trap functions                                                             */
-/*----------------------------------------------------------------------------*/
-
+// Fast path: returns 1 if no event can occur. The result exponent is
+// compared against the latent zones, which also excludes zero, subnormal,
+// infinity and NaN results. It only uses integer operations on the exponents.
+int _FPC_FP64_FAST_PATH_(double x, double y, double z, int op) {
+  if (op == 4)
+    return 0;
+
+  int re = (int)_FPC_FP64_GET_EXPONENT(x);
+  int minVal = (int)(DANGER_ZONE_PERCENTAGE*2048.0);
+  int maxVal = 2048 - (int)(DANGER_ZONE_PERCENTAGE*2048.0);
+  if (re <= minVal || re >= maxVal)
+    return 0;
+
+  if (op == 3 && _FPC_FP64_GET_EXPONENT(z) == 0)
+    return 0;
+
+  if (op == 0 || op == 1) {
+    int e1 = (int)_FPC_FP64_GET_EXPONENT(y);
+    int e2 = (int)_FPC_FP64_GET_EXPONENT(z);
+    if ((FPC_MAX(e1,e2) - re) > 30)
+      return 0;
+    // An operand can only be absorbed 53 or more binades below the other
+    if (!_FPC_FP64_IS_ZERO_(y) && !_FPC_FP64_IS_ZERO_(z) && (e1 - e2 >= 53 || e2 - e1 >= 53))
+      return 0;
+  }
+
+  return 1;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Trap functions                                                             */
+/*----------------------------------------------------------------------------*/
+
 /**
  * Trap options and id
  * --------------------
@@ -355,6 +1597,7 @@ int _FPC_FP64_IS_LATENT_SUBNORMAL(double x) {
  *  FPC_TRAP_LATENT_INF_POS   8
  *  FPC_TRAP_LATENT_INF_NEG   9
  *  FPC_TRAP_LATENT_UNDERFLOW 10
+ *  FPC_TRAP_ABSORPTION       11
  *  FPC_TRAP_FILE
  *  FPC_TRAP_LINE
  **/
@@ -372,6 +1615,14 @@ void _FPC_TRAP_HERE(const char *trap_name, int loc, char *file_name) {
     pid_t pid = getpid();
     printf("HOST: %s, PID: %d\n", host_name, pid);
   }
+
+  char reason[256];
+  snprintf(reason, sizeof(reason), "trap %s at %s:%d", trap_name, file_name, loc);
+  _FPC_RECORDER_DUMP_(reason);
+
+  // Save the events before interrupting (not in a signal handler, so the
+  // snapshot is written here)
+  _FPC_FLUSH_TRACES_(1);
   
   if (getenv("FPC_TRAPS_HANG")) {
     sleep(3600);
@@ -424,6 +1675,7 @@ void _FPC_CHECK_AND_TRAP(_FPC_ITEM_T_ *item, int loc, char *file_name) {
     if (getenv("FPC_TRAP_LATENT_INF_POS")   != NULL && item->latent_infinity_pos) _FPC_TRAP_HERE("latent infinity(+)", loc, file_name);
     if (getenv("FPC_TRAP_LATENT_INF_NEG")   != NULL && item->latent_infinity_neg) _FPC_TRAP_HERE("latent infinity(-)", loc, file_name);
     if (getenv("FPC_TRAP_LATENT_UNDERFLOW") != NULL && item->latent_underflow)    _FPC_TRAP_HERE("latent underflow", loc, file_name);
+    if (getenv("FPC_TRAP_ABSORPTION")       != NULL && item->absorption)          _FPC_TRAP_HERE("absorption", loc, file_name);
   }
 }
 
@@ -431,19 +1683,714 @@ void _FPC_CHECK_AND_TRAP(_FPC_ITEM_T_ *item, int loc, char *file_name) {
 /* Generic checking functions                                                 */
 /*----------------------------------------------------------------------------*/
 
-int _FPC_EVENT_OCURRED(_FPC_ITEM_T_ *item) {
-  return (
-      item->infinity_pos ||
-      item->infinity_neg ||
-      item->nan ||
-      item->division_zero ||
-      item->cancellation ||
-      item->comparison ||
-      item->underflow ||
-      item->latent_infinity_pos ||
-      item->latent_infinity_neg ||
-      item->latent_underflow
-      );
+/** Returns the item of a location, inserting an empty one if needed **/
+_FPC_ITEM_T_ *_FPC_HT_GET_(_FPC_HTABLE_T *hashtable, char *file_name, uint64_t line) {
+  _FPC_ITEM_T_ *item = _FPC_HT_FIND_(hashtable, file_name, line);
+  if (item != NULL)
+    return item;
+
+  _FPC_ITEM_T_ empty;
+  memset((void *)&empty, 0, sizeof(empty));
+  empty.file_name = file_name;
+  empty.line = line;
+#ifdef FPC_MULTI_THREADED
+  pthread_mutex_lock(&fpc_lock);
+#endif
+  _FPC_HT_SET_(hashtable, &empty);
+#ifdef FPC_MULTI_THREADED
+  pthread_mutex_unlock(&fpc_lock);
+#endif
+  return _FPC_HT_FIND_(hashtable, file_name, line);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Overhead budget                                                            */
+/*----------------------------------------------------------------------------*/
+
+/** Changes the sampling period of hot sites based on the last window. The
+ * window and the period are only changed under the lock; cycles are added
+ * and the period is read by the other threads without it. **/
+void _FPC_BUDGET_ADJUST_() {
+#ifdef FPC_MULTI_THREADED
+  pthread_mutex_lock(&fpc_lock);
+#endif
+  uint64_t now = _FPC_READ_CYCLES_();
+  uint64_t elapsed = now - _FPC_BUDGET_.window;
+  uint64_t checking = __atomic_exchange_n(&_FPC_BUDGET_.cycles, 0, __ATOMIC_RELAXED);
+  _FPC_BUDGET_.window = now;
+
+  uint64_t period = _FPC_BUDGET_.period;
+  double overhead = (elapsed > checking) ?
+      (double)checking / (double)(elapsed - checking) : _FPC_BUDGET_.budget + 1.0;
+  if (overhead > _FPC_BUDGET_.budget) {
+    if (period < _FPC_BUDGET_MAX_PERIOD_)
+      period *= 2;
+  } else if (overhead < _FPC_BUDGET_.budget / 2.0) {
+    if (period > 1)
+      period /= 2;
+  }
+  __atomic_store_n(&_FPC_BUDGET_.period, period, __ATOMIC_RELAXED);
+#ifdef FPC_MULTI_THREADED
+  pthread_mutex_unlock(&fpc_lock);
+#endif
+}
+
+void _FPC_BUDGET_ACCOUNT_(uint64_t cycles) {
+  _FPC_FETCH_ADD_(&_FPC_BUDGET_.cycles, cycles);
+  _FPC_FETCH_ADD_(&_FPC_BUDGET_.total_cycles, cycles);
+  uint64_t samples = _FPC_FETCH_ADD_(&_FPC_BUDGET_.samples, 1) + 1;
+  if ((samples % _FPC_BUDGET_ADJUST_PERIOD_) == 0)
+    _FPC_BUDGET_ADJUST_();
+}
+
+/*----------------------------------------------------------------------------*/
+/* First occurrences                                                          */
+/*----------------------------------------------------------------------------*/
+
+_FPC_CAPTURE_T_ *_FPC_CAPTURE_CREATE_() {
+  uint64_t k = (uint64_t)_FPC_OPTIONS_.capture;
+  _FPC_CAPTURE_T_ *captures = (_FPC_CAPTURE_T_ *)calloc(1,
+      sizeof(_FPC_CAPTURE_T_) + sizeof(_FPC_OCCURRENCE_T_) * (_FPC_NUM_EVENTS_ * k - 1));
+  if (captures == NULL) {
+    printf("#FPCHECKER: hash table out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  captures->k = k;
+  return captures;
+}
+
+/**
+ * First occurrences
+ * ----------------
+ * With FPC_CAPTURE_OCCURRENCES=K, the first K occurrences of each event at
+ * a site are saved in the traces with the result, the operands, the thread,
+ * the MPI rank and the time, so the values that produced the event are
+ * known without running the program again in a debugger. A slot is claimed
+ * with an atomic counter; once K occurrences are saved, recording only
+ * reads the counter.
+ **/
+void _FPC_CAPTURE_RECORD_(_FPC_CAPTURE_T_ *captures, _FPC_ITEM_T_ *events,
+                          double x, const double *operands, int n, int bits) {
+  uint64_t e[_FPC_NUM_EVENTS_] = {
+    events->infinity_pos, events->infinity_neg, events->nan, events->division_zero,
+    events->cancellation, events->comparison, events->underflow,
+    events->latent_infinity_pos, events->latent_infinity_neg, events->latent_underflow,
+    events->absorption };
+
+  uint64_t thread = 0, time = 0;
+  for (int i = 0; i < _FPC_NUM_EVENTS_; ++i) {
+    if (!e[i] || __atomic_load_n(&(captures->count[i]), __ATOMIC_RELAXED) >= captures->k)
+      continue;
+    uint64_t slot = _FPC_FETCH_ADD_(&(captures->count[i]), 1);
+    if (slot >= captures->k)
+      continue;
+    if (time == 0) {
+      thread = (uint64_t)pthread_self();
+      time = _FPC_TIME_NS_() - _FPC_OPTIONS_.start_time;
+    }
+
+    _FPC_OCCURRENCE_T_ *o = &(captures->occurrences[i * captures->k + slot]);
+    o->result = x;
+    for (int j = 0; j < n; ++j)
+      o->operands[j] = operands[j];
+    o->num_operands = (uint8_t)n;
+    o->thread = thread;
+    o->time = time;
+    o->rank = _FPC_OPTIONS_.rank;
+    o->bits = (uint16_t)bits;
+    __atomic_store_n(&(o->ready), 1, __ATOMIC_RELEASE);
+  }
+}
+
+/** Saves the events of an operation in the table **/
+void _FPC_SAVE_EVENTS_(_FPC_ITEM_T_ *item, double x, const double *operands, int n, int bits) {
+#ifdef FPC_MULTI_THREADED
+  pthread_mutex_lock(&fpc_lock);
+#endif
+  _FPC_ITEM_T_ *site = _FPC_HT_SET_(_FPC_HTABLE_, item);
+  if (_FPC_OPTIONS_.capture > 0 && site->captures == NULL)
+    __atomic_store_n(&(site->captures), _FPC_CAPTURE_CREATE_(), __ATOMIC_RELEASE);
+#ifdef FPC_MULTI_THREADED
+  pthread_mutex_unlock(&fpc_lock);
+#endif
+  _FPC_CAPTURE_T_ *captures = __atomic_load_n(&(site->captures), __ATOMIC_ACQUIRE);
+  if (captures != NULL)
+    _FPC_CAPTURE_RECORD_(captures, item, x, operands, n, bits);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Exponent ranges                                                            */
+/*----------------------------------------------------------------------------*/
+
+_FPC_RANGE_T_ *_FPC_RANGE_CREATE_(_FPC_ITEM_T_ *site, int bits) {
+  _FPC_RANGE_T_ *r = (_FPC_RANGE_T_ *)calloc(1, sizeof(_FPC_RANGE_T_));
+  if (r == NULL) {
+    printf("#FPCHECKER: hash table out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  r->bits = bits;
+  r->result_min = r->operand_min = INT32_MAX;
+  r->result_max = r->operand_max = INT32_MIN;
+
+  // Another thread may have created the ranges of the site
+  _FPC_RANGE_T_ *expected = NULL;
+  if (!__atomic_compare_exchange_n(&(site->ranges), &expected, r, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free(r);
+    return expected;
+  }
+  return r;
+}
+
+void _FPC_ATOMIC_MIN_(int32_t *ptr, int32_t val) {
+  int32_t current = __atomic_load_n(ptr, __ATOMIC_RELAXED);
+  while (val < current &&
+         !__atomic_compare_exchange_n(ptr, &current, val, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+void _FPC_ATOMIC_MAX_(int32_t *ptr, int32_t val) {
+  int32_t current = __atomic_load_n(ptr, __ATOMIC_RELAXED);
+  while (val > current &&
+         !__atomic_compare_exchange_n(ptr, &current, val, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+/** Biased exponent of a double; 0 for zero, 2047 for infinity and NaN **/
+int _FPC_RANGE_EXPONENT_(double x) {
+  return _FPC_FP64_IS_ZERO_(x) ? 0 : (int)_FPC_FP64_GET_EXPONENT(x);
+}
+
+/** Adds the operand exponent (biased) e to the range **/
+void _FPC_RANGE_OPERAND_(_FPC_RANGE_T_ *r, int e) {
+  if (e == 0 || e == 2047)
+    return;
+  _FPC_ATOMIC_MIN_(&(r->operand_min), e - 1023);
+  _FPC_ATOMIC_MAX_(&(r->operand_max), e - 1023);
+}
+
+/**
+ * Exponent ranges
+ * ----------------
+ * With FPC_PROFILE_RANGES=1, every checked execution of a site updates the
+ * minimum and maximum exponents of its results and operands, a histogram
+ * of the result exponents and the maximum number of bits cancelled in
+ * additions and subtractions (an exact zero cancels all the bits). These
+ * show which sites could be computed in FP32 or BF16 (see fpc-create-report
+ * -p). The ranges of a site are allocated on its first execution; updates
+ * are O(1) and do not allocate. Zeros, infinities and NaNs are not
+ * counted; subnormal doubles have exponent -1023.
+ **/
+void _FPC_RANGE_UPDATE_(_FPC_ITEM_T_ *site, double x, double y, double z, int op, int bits) {
+  _FPC_RANGE_T_ *r = __atomic_load_n(&(site->ranges), __ATOMIC_ACQUIRE);
+  if (r == NULL)
+    r = _FPC_RANGE_CREATE_(site, bits);
+
+  int ey = _FPC_RANGE_EXPONENT_(y);
+  int ez = _FPC_RANGE_EXPONENT_(z);
+  _FPC_RANGE_OPERAND_(r, ey);
+  _FPC_RANGE_OPERAND_(r, ez);
+  if (op == 4)  // comparisons do not have a floating-point result
+    return;
+
+  int ex = _FPC_RANGE_EXPONENT_(x);
+  if (ex != 2047 && (op == 0 || op == 1)) {
+    int cancelled = (ex == 0) ? ((bits == 32) ? 24 : 53) : FPC_MAX(ey, ez) - ex;
+    if (FPC_MAX(ey, ez) != 0 && cancelled > 0)
+      _FPC_ATOMIC_MAX_(&(r->max_cancellation), cancelled);
+  }
+  if (ex == 0 || ex == 2047)
+    return;
+  _FPC_ATOMIC_MIN_(&(r->result_min), ex - 1023);
+  _FPC_ATOMIC_MAX_(&(r->result_max), ex - 1023);
+  _FPC_FETCH_ADD_(&(r->histogram[ex >> 6]), 1);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Subnormal numbers                                                          */
+/*----------------------------------------------------------------------------*/
+
+/** Subnormal checks on the bits; comparisons with zero do not work when
+ * the operands are flushed to zero (DAZ) **/
+int _FPC_FP32_IS_DENORMAL_(float x) {
+  uint32_t bits;
+  memcpy((void *)&bits, (void *)&x, sizeof(bits));
+  return (bits & 0x7f800000u) == 0 && (bits & 0x007fffffu) != 0;
+}
+
+int _FPC_FP64_IS_DENORMAL_(double x) {
+  uint64_t bits;
+  memcpy((void *)&bits, (void *)&x, sizeof(bits));
+  return (bits & 0x7ff0000000000000ull) == 0 && (bits & 0x000fffffffffffffull) != 0;
+}
+
+/** Sets flush-to-zero and denormals-are-zero for this thread (and the
+ * threads it creates). Returns 0 if the architecture is not supported. **/
+int _FPC_SET_FTZ_DAZ_() {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int csr;
+  __asm__ __volatile__("stmxcsr %0" : "=m"(csr));
+  csr |= 0x8040;          // FTZ (bit 15) and DAZ (bit 6) of MXCSR
+  __asm__ __volatile__("ldmxcsr %0" : : "m"(csr));
+  return 1;
+#elif defined(__aarch64__)
+  uint64_t fpcr;
+  __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+  fpcr |= (1ull << 24);   // FZ flushes both operands and results
+  __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+_FPC_DENORMAL_T_ *_FPC_DENORMAL_CREATE_(_FPC_ITEM_T_ *site) {
+  _FPC_DENORMAL_T_ *d = (_FPC_DENORMAL_T_ *)calloc(1, sizeof(_FPC_DENORMAL_T_));
+  if (d == NULL) {
+    printf("#FPCHECKER: hash table out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  d->ftz_daz = _FPC_OPTIONS_.ftz_daz;
+
+  _FPC_DENORMAL_T_ *expected = NULL;
+  if (!__atomic_compare_exchange_n(&(site->denormals), &expected, d, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free(d);
+    return expected;
+  }
+  return d;
+}
+
+/**
+ * Subnormal numbers
+ * ------------------
+ * On x86, operations with subnormal operands or results may take a
+ * microcode assist that is ~100 times slower than the operation, unless
+ * subnormals are flushed to zero (FTZ/DAZ). With FPC_PROFILE_DENORMALS=1,
+ * every checked execution of a site counts its subnormal operands and
+ * results; operations with either are counted as assists, an estimate of
+ * the slow path hits (see fpc-create-report -d), except with FPC_FTZ_DAZ.
+ * The underflow event only looks at the results.
+ **/
+void _FPC_DENORMAL_UPDATE_(_FPC_ITEM_T_ *site, int operand, int result) {
+  if (!operand && !result)
+    return;
+  _FPC_DENORMAL_T_ *d = __atomic_load_n(&(site->denormals), __ATOMIC_ACQUIRE);
+  if (d == NULL)
+    d = _FPC_DENORMAL_CREATE_(site);
+  if (operand)
+    _FPC_FETCH_ADD_(&(d->operands), 1);
+  if (result)
+    _FPC_FETCH_ADD_(&(d->results), 1);
+  // Operands flushed to zero do not take the slow path
+  if (!d->ftz_daz)
+    _FPC_FETCH_ADD_(&(d->assists), 1);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Reduced-precision emulation                                                */
+/*----------------------------------------------------------------------------*/
+
+/** Floating-point formats: significand bits and exponents of the normal
+ * numbers. _FPC_FORMATS_ are the emulated formats, in the order of
+ * _FPC_FORMAT_NAMES_. **/
+typedef struct _FPC_FORMAT_S_ {
+  int bits;
+  int emin;
+  int emax;
+} _FPC_FORMAT_T_;
+
+#define _FPC_FORMAT_FP32_   {24, -126, 127}
+#define _FPC_FORMAT_BF16_   {8, -126, 127}
+#define _FPC_FORMAT_FP16_   {11, -14, 15}
+#define _FPC_FORMAT_FP80_   {64, -16382, 16383}     // x86 long double
+#define _FPC_FORMAT_FP128_  {113, -16382, 16383}
+
+#define _FPC_FORMATS_ { _FPC_FORMAT_FP32_, _FPC_FORMAT_BF16_, _FPC_FORMAT_FP16_ }
+
+/** Rounds a double to the nearest value of a format (ties to even), with
+ * the subnormals and the overflow to infinity of the format **/
+double _FPC_ROUND_TO_FORMAT_(double v, int format) {
+  const _FPC_FORMAT_T_ formats[] = _FPC_FORMATS_;
+  const _FPC_FORMAT_T_ *f = &formats[format];
+  if (_FPC_FP64_IS_ZERO_(v) || !_FPC_FP64_IS_FINITE_(v))
+    return v;
+
+  int e;
+  frexp(v, &e);
+  e = FPC_MAX(e - 1, f->emin);   // subnormals have the spacing of 2^emin
+  double quantum = ldexp(1.0, e - f->bits + 1);
+  double r = nearbyint(v / quantum) * quantum;
+  if (fabs(r) > ldexp(2.0 - ldexp(1.0, 1 - f->bits), f->emax))
+    return copysign(INFINITY, v);
+  return r;
+}
+
+_FPC_EMULATION_T_ *_FPC_EMULATION_CREATE_(_FPC_ITEM_T_ *site, int format) {
+  _FPC_EMULATION_T_ *e = (_FPC_EMULATION_T_ *)calloc(1, sizeof(_FPC_EMULATION_T_));
+  if (e == NULL) {
+    printf("#FPCHECKER: hash table out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  e->format = format;
+
+  _FPC_EMULATION_T_ *expected = NULL;
+  if (!__atomic_compare_exchange_n(&(site->emulation), &expected, e, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free(e);
+    return expected;
+  }
+  return e;
+}
+
+/** Counts the effect of the emulation of an operation: x is the result
+ * in full precision and r the emulated result. **/
+void _FPC_EMULATION_COUNT_(_FPC_ITEM_T_ *site, double x, double a, double b, double r,
+                           int op, int format) {
+  const _FPC_FORMAT_T_ formats[] = _FPC_FORMATS_;
+  _FPC_EMULATION_T_ *e = __atomic_load_n(&(site->emulation), __ATOMIC_ACQUIRE);
+  if (e == NULL)
+    e = _FPC_EMULATION_CREATE_(site, format);
+
+  _FPC_FETCH_ADD_(&(e->executions), 1);
+  if (!_FPC_FP64_IS_FINITE_(x))
+    return;
+  if (_FPC_FP64_IS_INF(r))
+    _FPC_FETCH_ADD_(&(e->overflows), 1);
+
+  // All the bits of the format cancel: max{exp(a), exp(b)} - exp(r) >= bits
+  int cancelled = 0;
+  if ((op == 0 || op == 1) && x != 0.0 && a != 0.0 && b != 0.0) {
+    int ea, eb, er;
+    frexp(a, &ea);
+    frexp(b, &eb);
+    frexp(r, &er);
+    cancelled = (r == 0.0 || FPC_MAX(ea, eb) - er >= formats[format].bits);
+  }
+  if (cancelled)
+    _FPC_FETCH_ADD_(&(e->cancellations), 1);
+  else if (x != 0.0 && fabs(r) < ldexp(1.0, formats[format].emin))
+    _FPC_FETCH_ADD_(&(e->underflows), 1);
+
+  if (x != 0.0 && _FPC_FP64_IS_FINITE_(r)) {
+    double error = fabs((r - x) / x);
+    double current;
+    __atomic_load(&(e->max_error), &current, __ATOMIC_RELAXED);
+    while (error > current &&
+           !__atomic_compare_exchange(&(e->max_error), &current, &error, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      ;
+  }
+}
+
+/**
+ * Reduced-precision emulation
+ * ----------------
+ * Operations selected at compile time with FPC_EMULATE=fp32|bf16|fp16 (see
+ * Instrumentation_cpu.cpp) call this function after they execute, and the
+ * program uses the value it returns instead of their result. The operands
+ * and the result are rounded to the format in software, so the program
+ * runs as if the operation was computed in that format. Each site counts
+ * the results that overflow, underflow or cancel in the format but not in
+ * full precision (x), and the maximum relative error of the results.
+ **/
+double _FPC_EMULATE_OP_(double x, double y, double z, int loc, char *file_name,
+                        int op, int format) {
+  double a = _FPC_ROUND_TO_FORMAT_(y, format);
+  double b = _FPC_ROUND_TO_FORMAT_(z, format);
+  double r = x;
+  if      (op == 0) r = a + b;
+  else if (op == 1) r = a - b;
+  else if (op == 2) r = a * b;
+  else if (op == 3) r = a / b;
+  else if (op == 5) r = fmod(a, b);
+  r = _FPC_ROUND_TO_FORMAT_(r, format);
+
+  if (_FPC_HTABLE_ != NULL)
+    _FPC_EMULATION_COUNT_(_FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc),
+                          x, a, b, r, op, format);
+  return r;
+}
+
+double _FPC_EMULATE_FP64_(double x, double y, double z, int loc, char *file_name,
+                          int op, int format) {
+  return _FPC_EMULATE_OP_(x, y, z, loc, file_name, op, format);
+}
+
+float _FPC_EMULATE_FP32_(float x, float y, float z, int loc, char *file_name,
+                         int op, int format) {
+  return (float)_FPC_EMULATE_OP_((double)x, (double)y, (double)z, loc, file_name, op, format);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Shadow computation in higher precision                                     */
+/*----------------------------------------------------------------------------*/
+
+/** Shadow type of double operations: quad precision **/
+#if defined(__SIZEOF_FLOAT128__)
+typedef __float128 _FPC_QUAD_T_;
+#else
+typedef long double _FPC_QUAD_T_;   // quad precision on AArch64 and POWER
+#endif
+
+_FPC_SHADOW_T_ *_FPC_SHADOW_CREATE_(_FPC_ITEM_T_ *site, int bits) {
+  _FPC_SHADOW_T_ *sh = (_FPC_SHADOW_T_ *)calloc(1, sizeof(_FPC_SHADOW_T_));
+  if (sh == NULL) {
+    printf("#FPCHECKER: hash table out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  sh->bits = bits;
+
+  _FPC_SHADOW_T_ *expected = NULL;
+  if (!__atomic_compare_exchange_n(&(site->shadow), &expected, sh, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free(sh);
+    return expected;
+  }
+  return sh;
+}
+
+void _FPC_ATOMIC_ADD_DOUBLE_(double *ptr, double val) {
+  double current;
+  __atomic_load(ptr, &current, __ATOMIC_RELAXED);
+  double next = current + val;
+  while (!__atomic_compare_exchange(ptr, &current, &next, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    next = current + val;
+}
+
+/**
+ * Shadow computation
+ * ----------------
+ * Programs built with FPC_SHADOW=1 compute each float operation also in
+ * double, and each double operation also in quad precision (see
+ * Instrumentation_cpu.cpp). Shadow values follow the results through the
+ * operations, phi nodes and selects of a function; values from memory,
+ * arguments and calls start new shadows. The relative error of a result
+ * against its shadow gives the number of incorrect bits,
+ *   bits - log2(1 / relative error),
+ * so cancellations are measured by the bits they actually lose instead of
+ * by the difference of the exponents (_FPC_FP64_IS_CANCELLATION).
+ **/
+void _FPC_SHADOW_RECORD_(int loc, char *file_name, double error, int op, int bits) {
+  if (_FPC_HTABLE_ == NULL || _FPC_FP64_IS_NAN(error))
+    return;
+  _FPC_ITEM_T_ *site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+  _FPC_SHADOW_T_ *sh = __atomic_load_n(&(site->shadow), __ATOMIC_ACQUIRE);
+  if (sh == NULL)
+    sh = _FPC_SHADOW_CREATE_(site, bits);
+
+  int error_bits = 0;
+  if (_FPC_FP64_IS_INF(error))
+    error_bits = bits;
+  else if (error > 0.0)
+    error_bits = (int)ceil((double)bits + log2(error));
+  error_bits = (error_bits < 0) ? 0 : ((error_bits > bits) ? bits : error_bits);
+
+  _FPC_FETCH_ADD_(&(sh->executions), 1);
+  _FPC_ATOMIC_MAX_(&(sh->max_error_bits), error_bits);
+  if (2 * error_bits > bits) {
+    _FPC_FETCH_ADD_(&(sh->inaccurate), 1);
+    if (op == 0 || op == 1)
+      _FPC_FETCH_ADD_(&(sh->cancellations), 1);
+  }
+  if (_FPC_FP64_IS_INF(error))
+    return;
+  _FPC_ATOMIC_ADD_DOUBLE_(&(sh->sum_error), error);
+  double current;
+  __atomic_load(&(sh->max_error), &current, __ATOMIC_RELAXED);
+  while (error > current &&
+         !__atomic_compare_exchange(&(sh->max_error), &current, &error, 1,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+/** x is the result of a float operation and shadow the result in double **/
+void _FPC_SHADOW_FP32_(float x, double shadow, int loc, char *file_name, int op) {
+  if (!_FPC_FP32_IS_FINITE_(x) || !_FPC_FP64_IS_FINITE_(shadow))
+    return;
+  double error = (shadow == 0.0) ? ((x == 0.0f) ? 0.0 : INFINITY)
+                                 : fabs(((double)x - shadow) / shadow);
+  _FPC_SHADOW_RECORD_(loc, file_name, error, op, 24);
+}
+
+/** x is the result of a double operation and shadow the result in quad **/
+void _FPC_SHADOW_FP64_(double x, _FPC_QUAD_T_ shadow, int loc, char *file_name, int op) {
+  double s = (double)shadow;
+  if (!_FPC_FP64_IS_FINITE_(x) || !_FPC_FP64_IS_FINITE_(s))
+    return;
+  double error = (shadow == 0) ? ((x == 0.0) ? 0.0 : INFINITY)
+                               : fabs((double)(((_FPC_QUAD_T_)x - shadow) / shadow));
+  _FPC_SHADOW_RECORD_(loc, file_name, error, op, 53);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Rounding perturbation                                                      */
+/*----------------------------------------------------------------------------*/
+
+/** Random numbers of the rounding perturbation (xorshift64*). Each thread
+ * seeds its state from FPC_PERTURB_SEED and the order in which the threads
+ * start, so a seed reproduces the run of a deterministic program. **/
+__thread uint64_t _FPC_PERTURB_STATE_;
+uint64_t _FPC_PERTURB_THREADS_;
+
+uint64_t _FPC_PERTURB_RANDOM_() {
+  uint64_t s = _FPC_PERTURB_STATE_;
+  if (s == 0) {
+    // splitmix64
+    s = _FPC_OPTIONS_.perturb_seed +
+        0x9E3779B97F4A7C15ULL * (_FPC_FETCH_ADD_(&_FPC_PERTURB_THREADS_, 1) + 1);
+    s = (s ^ (s >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    s = (s ^ (s >> 27)) * 0x94D049BB133111EBULL;
+    s = (s ^ (s >> 31)) | 1;
+  }
+  s ^= s >> 12;
+  s ^= s << 25;
+  s ^= s >> 27;
+  _FPC_PERTURB_STATE_ = s;
+  return s * 0x2545F4914F6CDD1DULL;
+}
+
+_FPC_PERTURBATION_T_ *_FPC_PERTURB_CREATE_(_FPC_ITEM_T_ *site, int bits) {
+  _FPC_PERTURBATION_T_ *p = (_FPC_PERTURBATION_T_ *)calloc(1, sizeof(_FPC_PERTURBATION_T_));
+  if (p == NULL) {
+    printf("#FPCHECKER: hash table out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  p->bits = bits;
+  p->mode = _FPC_OPTIONS_.perturb;
+
+  _FPC_PERTURBATION_T_ *expected = NULL;
+  if (!__atomic_compare_exchange_n(&(site->perturbation), &expected, p, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free(p);
+    return expected;
+  }
+  return p;
+}
+
+void _FPC_PERTURB_RECORD_(int loc, char *file_name, double r, int perturbed, int bits) {
+  if (_FPC_HTABLE_ == NULL)
+    return;
+  _FPC_ITEM_T_ *site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+  _FPC_PERTURBATION_T_ *p = __atomic_load_n(&(site->perturbation), __ATOMIC_ACQUIRE);
+  if (p == NULL)
+    p = _FPC_PERTURB_CREATE_(site, bits);
+  _FPC_FETCH_ADD_(&(p->executions), 1);
+  if (perturbed)
+    _FPC_FETCH_ADD_(&(p->perturbed), 1);
+  if (_FPC_FP64_IS_FINITE_(r))
+    _FPC_ATOMIC_ADD_DOUBLE_(&(p->sum), r);
+  __atomic_store(&(p->last), &r, __ATOMIC_RELAXED);
+}
+
+/** Rounding error of the result r of the operation op on a and b, rounded
+ * to nearest. The exact result is r + error for additions, subtractions
+ * (TwoSum) and multiplications (with a fused multiply-add); for divisions
+ * the error is a rounded approximation, (a - r*b) / b. **/
+double _FPC_PERTURB_ERROR_(double r, double a, double b, int op) {
+  if (op == 1) {
+    b = -b;
+    op = 0;
+  }
+  if (op == 0) {
+    double bb = r - a;
+    return (a - (r - bb)) + (b - bb);
+  }
+  if (op == 2)
+    return fma(a, b, -r);
+  if (op == 3)
+    return -fma(r, b, -a) / b;
+  return 0.0;
+}
+
+/** Rounds the exact result, r + error, to r or to next, the neighbour of
+ * r on the side of the error: with probability 1/2 (random rounding up or
+ * down, as in CESTAC), or with probability |error| / |next - r| (average,
+ * stochastic rounding, which is exact on average). **/
+double _FPC_PERTURB_ROUND_(double r, double error, double next) {
+  if (_FPC_OPTIONS_.perturb == 1)
+    return (_FPC_PERTURB_RANDOM_() >> 63) ? next : r;
+  double p = fabs(error / (next - r));
+  double u = (double)(_FPC_PERTURB_RANDOM_() >> 11) / 9007199254740992.0; // 2^53
+  return (u < p) ? next : r;
+}
+
+/**
+ * Rounding perturbation
+ * ----------------
+ * Additions, subtractions, multiplications and divisions of programs built
+ * with FPC_PERTURB=1 (see Instrumentation_cpu.cpp) call this function after
+ * they execute, and the program uses the value it returns instead of their
+ * result: the exact result rounded up or down at random (FPC_PERTURB_MODE).
+ * Exact results are not changed. Results that are sensitive to rounding,
+ * and so to the order of the operations of a reduction, differ from run to
+ * run; each site saves the sum of its results and its last result, which
+ * fpc-perturb compares over runs with different seeds, in the style of
+ * Verrou and CESTAC.
+ **/
+double _FPC_PERTURB_FP64_(double x, double y, double z, int loc, char *file_name, int op) {
+  double r = x;
+  int perturbed = 0;
+  if (_FPC_OPTIONS_.perturb != 0 && _FPC_FP64_IS_FINITE_(x) &&
+      _FPC_FP64_IS_FINITE_(y) && _FPC_FP64_IS_FINITE_(z)) {
+    double error = _FPC_PERTURB_ERROR_(x, y, z, op);
+    if (!_FPC_FP64_IS_ZERO_(error) && _FPC_FP64_IS_FINITE_(error)) {
+      r = _FPC_PERTURB_ROUND_(x, error, nextafter(x, (error > 0.0) ? INFINITY : -INFINITY));
+      perturbed = (r != x);
+    }
+  }
+  _FPC_PERTURB_RECORD_(loc, file_name, r, perturbed, 53);
+  return r;
+}
+
+/** The error of a float operation is measured against the result in
+ * double, which is exact except for some additions and divisions **/
+float _FPC_PERTURB_FP32_(float x, float y, float z, int loc, char *file_name, int op) {
+  float r = x;
+  int perturbed = 0;
+  if (_FPC_OPTIONS_.perturb != 0 && _FPC_FP32_IS_FINITE_(x) &&
+      _FPC_FP32_IS_FINITE_(y) && _FPC_FP32_IS_FINITE_(z)) {
+    double a = (double)y, b = (double)z, exact = (double)x;
+    if      (op == 0) exact = a + b;
+    else if (op == 1) exact = a - b;
+    else if (op == 2) exact = a * b;
+    else if (op == 3) exact = a / b;
+    double error = exact - (double)x;
+    if (!_FPC_FP64_IS_ZERO_(error) && _FPC_FP64_IS_FINITE_(error)) {
+      r = (float)_FPC_PERTURB_ROUND_((double)x, error,
+                                     (double)nextafterf(x, (error > 0.0) ? INFINITY : -INFINITY));
+      perturbed = (r != x);
+    }
+  }
+  _FPC_PERTURB_RECORD_(loc, file_name, (double)r, perturbed, 24);
+  return r;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Per-site execution counts and timing                                       */
+/*----------------------------------------------------------------------------*/
+
+/** Counts an execution of a site and sets start to the cycle count if the
+ * execution must be timed (or zero). Returns 1 if it must be checked. **/
+int _FPC_SITE_ENTER_(_FPC_ITEM_T_ *site, uint64_t *start) {
+  uint64_t n = _FPC_FETCH_ADD_(&(site->executions), 1);
+  *start = 0;
+  if ((n % _FPC_SITE_TIMING_PERIOD_) == 0)
+    *start = _FPC_READ_CYCLES_();
+
+  if (_FPC_BUDGET_.budget > 0.0 && n >= _FPC_BUDGET_HOT_SITE_)
+    return (n % __atomic_load_n(&_FPC_BUDGET_.period, __ATOMIC_RELAXED)) == 0;
+  return 1;
+}
+
+void _FPC_SITE_EXIT_(_FPC_ITEM_T_ *site, uint64_t start) {
+  if (!start)
+    return;
+
+  uint64_t cycles = (_FPC_READ_CYCLES_() - start) * _FPC_SITE_TIMING_PERIOD_;
+  _FPC_FETCH_ADD_(&(site->cycles), cycles);
+  if (_FPC_BUDGET_.budget > 0.0)
+    _FPC_BUDGET_ACCOUNT_(cycles);
 }
 
 /**
@@ -456,9 +2403,63 @@ int _FPC_EVENT_OCURRED(_FPC_ITEM_T_ *item) {
  * CMP = 4 (comparison)
  * REM = 5 (reminder)
  * CALL = 6 (function call)
+ * FMA = 7 (fused multiply-add)
+ * TRUNC = 8 (fptrunc)
+ * TOINT = 9 (fptosi, fptoui)
  * -------------------------
+ * The op argument of the checks also has the fast-math flags of the
+ * instruction (bit i + 8 is flag i of _FPC_FAST_MATH_NAMES_), which are
+ * saved in the locations with events.
  **/
 
+/** Sets the location and the events of an operation with result x and
+ * operands y and z **/
+void _FPC_FP32_SET_EVENTS_(_FPC_ITEM_T_ *item,
+    float x, float y, float z, int loc, char *file_name, int op) {
+  // Set file name and line
+  item->file_name = file_name;
+  item->line = (uint64_t)loc;
+  item->function = NULL;
+  item->fast_math = 0;
+  item->executions = 0;
+  item->cycles = 0;
+  item->captures = NULL;
+  item->ranges = NULL;
+  item->emulation = NULL;
+  item->shadow = NULL;
+  item->perturbation = NULL;
+  item->denormals = NULL;
+  item->conversion = NULL;
+
+  // Set events
+  item->infinity_pos         = (uint64_t)_FPC_FP32_IS_INFINITY_POS(x);
+  item->infinity_neg         = (uint64_t)_FPC_FP32_IS_INFINITY_NEG(x);
+  item->nan                  = (uint64_t)_FPC_FP32_IS_NAN(x);
+  item->division_zero        = (uint64_t)_FPC_FP32_IS_DIVISON_ZERO(y, z, op);
+  item->cancellation         = (uint64_t)_FPC_FP32_IS_CANCELLATION(x, y, z, op);
+  item->comparison           = (uint64_t)_FPC_FP32_IS_COMPARISON(op);
+  item->underflow            = (uint64_t)_FPC_FP32_IS_SUBNORMAL(x);
+  item->latent_infinity_pos  = (uint64_t)_FPC_FP32_IS_LATENT_INFINITY_POS(x);
+  item->latent_infinity_neg  = (uint64_t)_FPC_FP32_IS_LATENT_INFINITY_NEG(x);
+  item->latent_underflow     = (uint64_t)_FPC_FP32_IS_LATENT_SUBNORMAL(x);
+  item->absorption_gap       = (uint64_t)_FPC_FP32_IS_ABSORPTION(x, y, z, op);
+  item->absorption           = (item->absorption_gap > 0);
+}
+
+void _FPC_FP32_SLOW_PATH_(
+    float x, float y, float z, int loc, char *file_name, int op, int fast_math) {
+  _FPC_ITEM_T_ item;
+  _FPC_FP32_SET_EVENTS_(&item, x, y, z, loc, file_name, op);
+  item.fast_math = (uint32_t)fast_math;
+
+  if (_FPC_EVENT_OCURRED(&item)) {
+    double operands[2] = { (double)y, (double)z };
+    _FPC_RECORDER_ADD_(&item, (double)x, operands, 2, op, 32);
+    _FPC_SAVE_EVENTS_(&item, (double)x, operands, 2, 32);
+    _FPC_CHECK_AND_TRAP(&item, loc, file_name);
+  }
+}
+
 void _FPC_FP32_CHECK_(
     float x, float y, float z, int loc, char *file_name, int op, int cond) {
   /*if (!inv) {
@@ -469,31 +2470,180 @@ void _FPC_FP32_CHECK_(
   if (!cond)
     return;
 
+  int fast_math = op >> 8;
+  op &= 0xff;
+  _FPC_ITEM_T_ *site = NULL;
+  uint64_t start = 0;
+  if (_FPC_OPTIONS_.site_mode) {
+    site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+    if (!_FPC_SITE_ENTER_(site, &start)) {
+      _FPC_SITE_EXIT_(site, start);
+      return;
+    }
+    if (_FPC_OPTIONS_.ranges)
+      _FPC_RANGE_UPDATE_(site, (double)x, (double)y, (double)z, op, 32);
+    if (_FPC_OPTIONS_.denormals)
+      _FPC_DENORMAL_UPDATE_(site, _FPC_FP32_IS_DENORMAL_(y) || _FPC_FP32_IS_DENORMAL_(z),
+                            op != 4 && _FPC_FP32_IS_DENORMAL_(x));
+  }
+
+  if (!_FPC_FP32_FAST_PATH_(x, y, z, op))
+    _FPC_FP32_SLOW_PATH_(x, y, z, loc, file_name, op, fast_math);
+
+  if (site)
+    _FPC_SITE_EXIT_(site, start);
+}
+
+/**
+ * Fused multiply-adds
+ * --------------------
+ * llvm.fma and llvm.fmuladd (from -ffp-contract=fast or fma()) compute
+ * x = a*b + c with one rounding. Their events are those of the addition
+ * p + c, where p is the product rounded to the format: the cancellation
+ * and the absorption of the addend (or of the product) are the ones that
+ * matter. Occurrences and the flight recorder keep the three operands.
+ **/
+void _FPC_FP32_FMA_SLOW_PATH_(
+    float x, float a, float b, float c, float p, int loc, char *file_name, int fast_math) {
+  _FPC_ITEM_T_ item;
+  _FPC_FP32_SET_EVENTS_(&item, x, p, c, loc, file_name, 0);
+  item.fast_math = (uint32_t)fast_math;
+
+  if (_FPC_EVENT_OCURRED(&item)) {
+    double operands[3] = { (double)a, (double)b, (double)c };
+    _FPC_RECORDER_ADD_(&item, (double)x, operands, 3, 7, 32);
+    _FPC_SAVE_EVENTS_(&item, (double)x, operands, 3, 32);
+    _FPC_CHECK_AND_TRAP(&item, loc, file_name);
+  }
+}
+
+void _FPC_FP32_FMA_CHECK_(
+    float x, float a, float b, float c, int loc, char *file_name, int fast_math, int cond) {
+  if (!cond)
+    return;
+
+  float p = (float)((double)a * (double)b);
+  _FPC_ITEM_T_ *site = NULL;
+  uint64_t start = 0;
+  if (_FPC_OPTIONS_.site_mode) {
+    site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+    if (!_FPC_SITE_ENTER_(site, &start)) {
+      _FPC_SITE_EXIT_(site, start);
+      return;
+    }
+    if (_FPC_OPTIONS_.ranges)
+      _FPC_RANGE_UPDATE_(site, (double)x, (double)p, (double)c, 0, 32);
+    if (_FPC_OPTIONS_.denormals)
+      _FPC_DENORMAL_UPDATE_(site, _FPC_FP32_IS_DENORMAL_(a) || _FPC_FP32_IS_DENORMAL_(b) ||
+                            _FPC_FP32_IS_DENORMAL_(c), _FPC_FP32_IS_DENORMAL_(x));
+  }
+
+  if (!_FPC_FP32_FAST_PATH_(x, p, c, 0))
+    _FPC_FP32_FMA_SLOW_PATH_(x, a, b, c, p, loc, file_name, fast_math);
+
+  if (site)
+    _FPC_SITE_EXIT_(site, start);
+}
+
+/**
+ * Math function calls
+ * --------------------
+ * Calls to math functions (exp, log, pow, sqrt, ..., their llvm intrinsics
+ * and their vector variants; see Instrumentation_cpu.cpp) are checked as
+ * operation CALL: the result goes through the same fast path as the other
+ * operations, and the name of the function is saved in the site (e.g.,
+ * "function": "log"). y and z are the first n floating-point arguments
+ * (n is 1 or 2).
+ **/
+void _FPC_FP32_CALL_SLOW_PATH_(
+    float x, float y, float z, int n, int loc, char *file_name, char *function, int fast_math) {
   _FPC_ITEM_T_ item;
+  _FPC_FP32_SET_EVENTS_(&item, x, y, z, loc, file_name, 6);
+  item.function = function;
+  item.fast_math = (uint32_t)fast_math;
+
+  if (_FPC_EVENT_OCURRED(&item)) {
+    double operands[2] = { (double)y, (double)z };
+    _FPC_RECORDER_ADD_(&item, (double)x, operands, n, 6, 32);
+    _FPC_SAVE_EVENTS_(&item, (double)x, operands, n, 32);
+    _FPC_CHECK_AND_TRAP(&item, loc, file_name);
+  }
+}
+
+void _FPC_FP32_CALL_CHECK_(
+    float x, float y, float z, int n, int loc, char *file_name, char *function, int fast_math,
+    int cond) {
+  if (!cond)
+    return;
+
+  _FPC_ITEM_T_ *site = NULL;
+  uint64_t start = 0;
+  if (_FPC_OPTIONS_.site_mode) {
+    site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+    if (__atomic_load_n(&(site->function), __ATOMIC_RELAXED) == NULL)
+      __atomic_store_n(&(site->function), function, __ATOMIC_RELAXED);
+    if (!_FPC_SITE_ENTER_(site, &start)) {
+      _FPC_SITE_EXIT_(site, start);
+      return;
+    }
+    if (_FPC_OPTIONS_.ranges)
+      _FPC_RANGE_UPDATE_(site, (double)x, (double)y, (double)z, 6, 32);
+    if (_FPC_OPTIONS_.denormals)
+      _FPC_DENORMAL_UPDATE_(site, _FPC_FP32_IS_DENORMAL_(y) || _FPC_FP32_IS_DENORMAL_(z),
+                            _FPC_FP32_IS_DENORMAL_(x));
+  }
+
+  if (!_FPC_FP32_FAST_PATH_(x, y, z, 6))
+    _FPC_FP32_CALL_SLOW_PATH_(x, y, z, n, loc, file_name, function, fast_math);
+
+  if (site)
+    _FPC_SITE_EXIT_(site, start);
+}
+
+/** Sets the location and the events of an operation with result x and
+ * operands y and z **/
+void _FPC_FP64_SET_EVENTS_(_FPC_ITEM_T_ *item,
+    double x, double y, double z, int loc, char *file_name, int op) {
   // Set file name and line
-  item.file_name = file_name;
-  item.line = (uint64_t)loc;
+  item->file_name = file_name;
+  item->line = (uint64_t)loc;
+  item->function = NULL;
+  item->fast_math = 0;
+  item->executions = 0;
+  item->cycles = 0;
+  item->captures = NULL;
+  item->ranges = NULL;
+  item->emulation = NULL;
+  item->shadow = NULL;
+  item->perturbation = NULL;
+  item->denormals = NULL;
+  item->conversion = NULL;
 
   // Set events
-  item.infinity_pos         = (uint64_t)_FPC_FP32_IS_INFINITY_POS(x);
-  item.infinity_neg         = (uint64_t)_FPC_FP32_IS_INFINITY_NEG(x);
-  item.nan                  = (uint64_t)_FPC_FP32_IS_NAN(x);
-  item.division_zero        = (uint64_t)_FPC_FP32_IS_DIVISON_ZERO(y, z, op);
-  item.cancellation         = (uint64_t)_FPC_FP32_IS_CANCELLATION(x, y, z, op);
-  item.comparison           = (uint64_t)_FPC_FP32_IS_COMPARISON(op);
-  item.underflow            = (uint64_t)_FPC_FP32_IS_SUBNORMAL(x);
-  item.latent_infinity_pos  = (uint64_t)_FPC_FP32_IS_LATENT_INFINITY_POS(x);
-  item.latent_infinity_neg  = (uint64_t)_FPC_FP32_IS_LATENT_INFINITY_NEG(x);
-  item.latent_underflow     = (uint64_t)_FPC_FP32_IS_LATENT_SUBNORMAL(x);
-
- if (_FPC_EVENT_OCURRED(&item)) {
-#ifdef FPC_MULTI_THREADED
-    pthread_mutex_lock(&fpc_lock);
-#endif
-    _FPC_HT_SET_(_FPC_HTABLE_, &item);
-#ifdef FPC_MULTI_THREADED
-    pthread_mutex_unlock(&fpc_lock);
-#endif
+  item->infinity_pos         = (uint64_t)_FPC_FP64_IS_INFINITY_POS(x);
+  item->infinity_neg         = (uint64_t)_FPC_FP64_IS_INFINITY_NEG(x);
+  item->nan                  = (uint64_t)_FPC_FP64_IS_NAN(x);
+  item->division_zero        = (uint64_t)_FPC_FP64_IS_DIVISON_ZERO(y, z, op);
+  item->cancellation         = (uint64_t)_FPC_FP64_IS_CANCELLATION(x, y, z, op);
+  item->comparison           = (uint64_t)_FPC_FP64_IS_COMPARISON(op);
+  item->underflow            = (uint64_t)_FPC_FP64_IS_SUBNORMAL(x);
+  item->latent_infinity_pos  = (uint64_t)_FPC_FP64_IS_LATENT_INFINITY_POS(x);
+  item->latent_infinity_neg  = (uint64_t)_FPC_FP64_IS_LATENT_INFINITY_NEG(x);
+  item->latent_underflow     = (uint64_t)_FPC_FP64_IS_LATENT_SUBNORMAL(x);
+  item->absorption_gap       = (uint64_t)_FPC_FP64_IS_ABSORPTION(x, y, z, op);
+  item->absorption           = (item->absorption_gap > 0);
+}
+
+void _FPC_FP64_SLOW_PATH_(
+    double x, double y, double z, int loc, char *file_name, int op, int fast_math) {
+  _FPC_ITEM_T_ item;
+  _FPC_FP64_SET_EVENTS_(&item, x, y, z, loc, file_name, op);
+  item.fast_math = (uint32_t)fast_math;
+
+  if (_FPC_EVENT_OCURRED(&item)) {
+    double operands[2] = { (double)y, (double)z };
+    _FPC_RECORDER_ADD_(&item, (double)x, operands, 2, op, 64);
+    _FPC_SAVE_EVENTS_(&item, (double)x, operands, 2, 64);
     _FPC_CHECK_AND_TRAP(&item, loc, file_name);
   }
 }
@@ -508,34 +2658,588 @@ void _FPC_FP64_CHECK_(
   if (!cond)
     return;
 
+  int fast_math = op >> 8;
+  op &= 0xff;
+  _FPC_ITEM_T_ *site = NULL;
+  uint64_t start = 0;
+  if (_FPC_OPTIONS_.site_mode) {
+    site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+    if (!_FPC_SITE_ENTER_(site, &start)) {
+      _FPC_SITE_EXIT_(site, start);
+      return;
+    }
+    if (_FPC_OPTIONS_.ranges)
+      _FPC_RANGE_UPDATE_(site, (double)x, (double)y, (double)z, op, 64);
+    if (_FPC_OPTIONS_.denormals)
+      _FPC_DENORMAL_UPDATE_(site, _FPC_FP64_IS_DENORMAL_(y) || _FPC_FP64_IS_DENORMAL_(z),
+                            op != 4 && _FPC_FP64_IS_DENORMAL_(x));
+  }
+
+  if (!_FPC_FP64_FAST_PATH_(x, y, z, op))
+    _FPC_FP64_SLOW_PATH_(x, y, z, loc, file_name, op, fast_math);
+
+  if (site)
+    _FPC_SITE_EXIT_(site, start);
+}
+
+void _FPC_FP64_FMA_SLOW_PATH_(
+    double x, double a, double b, double c, double p, int loc, char *file_name, int fast_math) {
   _FPC_ITEM_T_ item;
-  // Set file name and line
-  item.file_name = file_name;
-  item.line = (uint64_t)loc;
+  _FPC_FP64_SET_EVENTS_(&item, x, p, c, loc, file_name, 0);
+  item.fast_math = (uint32_t)fast_math;
 
-  // Set events
-  item.infinity_pos         = (uint64_t)_FPC_FP64_IS_INFINITY_POS(x);
-  item.infinity_neg         = (uint64_t)_FPC_FP64_IS_INFINITY_NEG(x);
-  item.nan                  = (uint64_t)_FPC_FP64_IS_NAN(x);
-  item.division_zero        = (uint64_t)_FPC_FP64_IS_DIVISON_ZERO(y, z, op);
-  item.cancellation         = (uint64_t)_FPC_FP64_IS_CANCELLATION(x, y, z, op);
-  item.comparison           = (uint64_t)_FPC_FP64_IS_COMPARISON(op);
-  item.underflow            = (uint64_t)_FPC_FP64_IS_SUBNORMAL(x);
-  item.latent_infinity_pos  = (uint64_t)_FPC_FP64_IS_LATENT_INFINITY_POS(x);
-  item.latent_infinity_neg  = (uint64_t)_FPC_FP64_IS_LATENT_INFINITY_NEG(x);
-  item.latent_underflow     = (uint64_t)_FPC_FP64_IS_LATENT_SUBNORMAL(x);
-
-   if (_FPC_EVENT_OCURRED(&item)) {
-#ifdef FPC_MULTI_THREADED
-    pthread_mutex_lock(&fpc_lock);
+  if (_FPC_EVENT_OCURRED(&item)) {
+    double operands[3] = { (double)a, (double)b, (double)c };
+    _FPC_RECORDER_ADD_(&item, (double)x, operands, 3, 7, 64);
+    _FPC_SAVE_EVENTS_(&item, (double)x, operands, 3, 64);
+    _FPC_CHECK_AND_TRAP(&item, loc, file_name);
+  }
+}
+
+void _FPC_FP64_FMA_CHECK_(
+    double x, double a, double b, double c, int loc, char *file_name, int fast_math, int cond) {
+  if (!cond)
+    return;
+
+  double p = a * b;
+  _FPC_ITEM_T_ *site = NULL;
+  uint64_t start = 0;
+  if (_FPC_OPTIONS_.site_mode) {
+    site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+    if (!_FPC_SITE_ENTER_(site, &start)) {
+      _FPC_SITE_EXIT_(site, start);
+      return;
+    }
+    if (_FPC_OPTIONS_.ranges)
+      _FPC_RANGE_UPDATE_(site, (double)x, (double)p, (double)c, 0, 64);
+    if (_FPC_OPTIONS_.denormals)
+      _FPC_DENORMAL_UPDATE_(site, _FPC_FP64_IS_DENORMAL_(a) || _FPC_FP64_IS_DENORMAL_(b) ||
+                            _FPC_FP64_IS_DENORMAL_(c), _FPC_FP64_IS_DENORMAL_(x));
+  }
+
+  if (!_FPC_FP64_FAST_PATH_(x, p, c, 0))
+    _FPC_FP64_FMA_SLOW_PATH_(x, a, b, c, p, loc, file_name, fast_math);
+
+  if (site)
+    _FPC_SITE_EXIT_(site, start);
+}
+
+void _FPC_FP64_CALL_SLOW_PATH_(
+    double x, double y, double z, int n, int loc, char *file_name, char *function, int fast_math) {
+  _FPC_ITEM_T_ item;
+  _FPC_FP64_SET_EVENTS_(&item, x, y, z, loc, file_name, 6);
+  item.function = function;
+  item.fast_math = (uint32_t)fast_math;
+
+  if (_FPC_EVENT_OCURRED(&item)) {
+    double operands[2] = { (double)y, (double)z };
+    _FPC_RECORDER_ADD_(&item, (double)x, operands, n, 6, 64);
+    _FPC_SAVE_EVENTS_(&item, (double)x, operands, n, 64);
+    _FPC_CHECK_AND_TRAP(&item, loc, file_name);
+  }
+}
+
+void _FPC_FP64_CALL_CHECK_(
+    double x, double y, double z, int n, int loc, char *file_name, char *function, int fast_math,
+    int cond) {
+  if (!cond)
+    return;
+
+  _FPC_ITEM_T_ *site = NULL;
+  uint64_t start = 0;
+  if (_FPC_OPTIONS_.site_mode) {
+    site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+    if (__atomic_load_n(&(site->function), __ATOMIC_RELAXED) == NULL)
+      __atomic_store_n(&(site->function), function, __ATOMIC_RELAXED);
+    if (!_FPC_SITE_ENTER_(site, &start)) {
+      _FPC_SITE_EXIT_(site, start);
+      return;
+    }
+    if (_FPC_OPTIONS_.ranges)
+      _FPC_RANGE_UPDATE_(site, (double)x, (double)y, (double)z, 6, 64);
+    if (_FPC_OPTIONS_.denormals)
+      _FPC_DENORMAL_UPDATE_(site, _FPC_FP64_IS_DENORMAL_(y) || _FPC_FP64_IS_DENORMAL_(z),
+                            _FPC_FP64_IS_DENORMAL_(x));
+  }
+
+  if (!_FPC_FP64_FAST_PATH_(x, y, z, 6))
+    _FPC_FP64_CALL_SLOW_PATH_(x, y, z, n, loc, file_name, function, fast_math);
+
+  if (site)
+    _FPC_SITE_EXIT_(site, start);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Narrowing conversions                                                      */
+/*----------------------------------------------------------------------------*/
+
+_FPC_CONVERSION_T_ *_FPC_CONVERSION_CREATE_(_FPC_ITEM_T_ *site, int from_bits,
+                                            int from_type, int to_bits, int to_type) {
+  _FPC_CONVERSION_T_ *c = (_FPC_CONVERSION_T_ *)calloc(1, sizeof(_FPC_CONVERSION_T_));
+  if (c == NULL) {
+    printf("#FPCHECKER: hash table out of memory error!");
+    exit(EXIT_FAILURE);
+  }
+  c->from_bits = from_bits;
+  c->from_type = from_type;
+  c->to_bits = to_bits;
+  c->to_type = to_type;
+
+  _FPC_CONVERSION_T_ *expected = NULL;
+  if (!__atomic_compare_exchange_n(&(site->conversion), &expected, c, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free(c);
+    return expected;
+  }
+  return c;
+}
+
+/**
+ * Narrowing conversions
+ * ----------------------
+ * fptrunc (double to float) is checked as operation TRUNC and fptosi and
+ * fptoui (float or double to an integer) as operation TOINT. A truncation
+ * of a finite value to infinity is an overflow, and of a nonzero value to
+ * zero or a subnormal an underflow (also counted as the underflow event).
+ * A conversion to an integer is out of range if the value rounded toward
+ * zero does not fit in the integer, or if it is NaN (undefined behavior in
+ * C and C++). The lost values of a site are counted in "conversion" (JSON
+ * traces); conversions that keep the value are not saved.
+ **/
+void _FPC_CONVERSION_UPDATE_(char *file_name, int loc, int from_bits, int from_type,
+                             int to_bits, int to_type, int overflow, int underflow,
+                             int out_of_range) {
+  _FPC_ITEM_T_ *site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+  _FPC_CONVERSION_T_ *c = __atomic_load_n(&(site->conversion), __ATOMIC_ACQUIRE);
+  if (c == NULL)
+    c = _FPC_CONVERSION_CREATE_(site, from_bits, from_type, to_bits, to_type);
+  if (overflow)
+    _FPC_FETCH_ADD_(&(c->overflows), 1);
+  if (underflow)
+    _FPC_FETCH_ADD_(&(c->underflows), 1);
+  if (out_of_range)
+    _FPC_FETCH_ADD_(&(c->out_of_range), 1);
+}
+
+void _FPC_FP64_TRUNC_SLOW_PATH_(float x, double y, int loc, char *file_name) {
+  _FPC_ITEM_T_ item;
+  _FPC_FP32_SET_EVENTS_(&item, x, 0.0f, 0.0f, loc, file_name, 8);
+
+  int overflow = _FPC_FP32_IS_INF(x) && _FPC_FP64_IS_FINITE_(y);
+  int underflow = !_FPC_FP64_IS_ZERO_(y) && (_FPC_FP32_IS_ZERO_(x) || _FPC_FP32_IS_SUBNORMAL(x));
+  if (overflow || underflow)
+    _FPC_CONVERSION_UPDATE_(file_name, loc, 64, 0, 32, 0, overflow, underflow, 0);
+  if (underflow)
+    item.underflow = 1;
+
+  if (_FPC_EVENT_OCURRED(&item)) {
+    double operands[1] = { y };
+    _FPC_RECORDER_ADD_(&item, (double)x, operands, 1, 8, 32);
+    _FPC_SAVE_EVENTS_(&item, (double)x, operands, 1, 32);
+    _FPC_CHECK_AND_TRAP(&item, loc, file_name);
+  }
+}
+
+/** x = (float)y **/
+void _FPC_FP64_TRUNC_CHECK_(float x, double y, int loc, char *file_name, int cond) {
+  if (!cond)
+    return;
+
+  _FPC_ITEM_T_ *site = NULL;
+  uint64_t start = 0;
+  if (_FPC_OPTIONS_.site_mode) {
+    site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+    if (!_FPC_SITE_ENTER_(site, &start)) {
+      _FPC_SITE_EXIT_(site, start);
+      return;
+    }
+    if (_FPC_OPTIONS_.ranges)
+      _FPC_RANGE_UPDATE_(site, (double)x, y, 0.0, 8, 32);
+    if (_FPC_OPTIONS_.denormals)
+      _FPC_DENORMAL_UPDATE_(site, _FPC_FP64_IS_DENORMAL_(y), _FPC_FP32_IS_DENORMAL_(x));
+  }
+
+  // Overflows and underflows have infinity, zero or subnormal results
+  if (!_FPC_FP32_FAST_PATH_(x, 0.0f, 0.0f, 8))
+    _FPC_FP64_TRUNC_SLOW_PATH_(x, y, loc, file_name);
+
+  if (site)
+    _FPC_SITE_EXIT_(site, start);
+}
+
+/** Returns 1 if y rounded toward zero does not fit in an integer **/
+int _FPC_IS_OUT_OF_RANGE_(double y, int bits, int is_signed) {
+  if (_FPC_FP64_IS_NAN(y))
+    return 1;
+  double t = trunc(y);
+  double max = ldexp(1.0, is_signed ? bits - 1 : bits);
+  return is_signed ? (t < -max || t >= max) : (t < 0.0 || t >= max);
+}
+
+void _FPC_TOINT_CHECK_(double y, int from_bits, int from_type, int bits, int is_signed,
+                       int loc, char *file_name) {
+  _FPC_ITEM_T_ *site = NULL;
+  uint64_t start = 0;
+  if (_FPC_OPTIONS_.site_mode) {
+    site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+    if (!_FPC_SITE_ENTER_(site, &start)) {
+      _FPC_SITE_EXIT_(site, start);
+      return;
+    }
+  }
+
+  if (_FPC_IS_OUT_OF_RANGE_(y, bits, is_signed))
+    _FPC_CONVERSION_UPDATE_(file_name, loc, from_bits, from_type, bits, is_signed ? 1 : 2,
+                            0, 0, 1);
+
+  if (site)
+    _FPC_SITE_EXIT_(site, start);
+}
+
+/** (int<bits>)y or (unsigned int<bits>)y **/
+void _FPC_FP32_TOINT_CHECK_(float y, int bits, int is_signed, int loc, char *file_name,
+                            int cond) {
+  if (cond)
+    _FPC_TOINT_CHECK_((double)y, 32, 0, bits, is_signed, loc, file_name);
+}
+
+void _FPC_FP64_TOINT_CHECK_(double y, int bits, int is_signed, int loc, char *file_name,
+                            int cond) {
+  if (cond)
+    _FPC_TOINT_CHECK_(y, 64, 0, bits, is_signed, loc, file_name);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Other formats (FP16, BF16, FP80, FP128)                                    */
+/*----------------------------------------------------------------------------*/
+
+/**
+ * Other formats
+ * --------------
+ * Operations on _Float16 (half), __bf16 (bfloat), x86 long double
+ * (x86_fp80) and __float128 (fp128) are checked for the same events as
+ * float and double. The checks of a format are generated by
+ * _FPC_DEFINE_FORMAT_CHECKS_ from its description (_FPC_FORMAT_T_) and a
+ * function that returns the biased exponent of a value in the format; the
+ * latent zones, the cancellation threshold and the absorption gap follow
+ * from the exponent range and the significand bits of the format. FP16 and
+ * BF16 values are passed widened to float, which is exact. Occurrences and
+ * the flight recorder keep the values converted to double.
+ **/
+
+/** Biased exponent of a value of a format (0 for zero and subnormals, the
+ * largest one for infinity and NaN), and whether it is zero, NaN or negative **/
+typedef struct _FPC_DECODED_S_ {
+  int exponent;
+  int zero;
+  int nan;
+  int negative;
+} _FPC_DECODED_T_;
+
+/** Number of biased exponents of a format: 2^(exponent bits) **/
+int _FPC_FORMAT_EXPONENTS_(const _FPC_FORMAT_T_ *f) {
+  return 2 * f->emax + 2;
+}
+
+/** Binades of each latent zone. Formats with few exponents (FP16) keep at
+ * least two, so that the zones are not empty. **/
+int _FPC_FORMAT_ZONE_(const _FPC_FORMAT_T_ *f) {
+  int zone = (int)(DANGER_ZONE_PERCENTAGE * (double)_FPC_FORMAT_EXPONENTS_(f));
+  return FPC_MAX(zone, 2);
+}
+
+/** Cancelled bits of a cancellation: 30, or all but one of the bits of
+ * formats with fewer bits **/
+int _FPC_FORMAT_CANCELLATION_(const _FPC_FORMAT_T_ *f) {
+  return (f->bits - 1 < 30) ? f->bits - 1 : 30;
+}
+
+/** Decodes a value of FP16 or BF16 (or a narrower format) widened to
+ * float. Values are decoded on their bits (see _FPC_FP32_IS_ZERO_). **/
+_FPC_DECODED_T_ _FPC_FLOAT_DECODE_IN_(float x, const _FPC_FORMAT_T_ *f) {
+  _FPC_DECODED_T_ d;
+  int e = (int)_FPC_FP32_GET_EXPONENT(x);
+  d.zero = _FPC_FP32_IS_ZERO_(x);
+  d.nan = _FPC_FP32_IS_NAN(x);
+  d.negative = _FPC_FP32_IS_NEGATIVE_(x);
+  if (e == 255)
+    d.exponent = _FPC_FORMAT_EXPONENTS_(f) - 1;
+  else if (e == 0)   // zero, or a subnormal of BF16
+    d.exponent = 0;
+  else
+    d.exponent = FPC_MAX(e - 127 + f->emax, 0);
+  return d;
+}
+
+_FPC_DECODED_T_ _FPC_FP16_DECODE_(float x) {
+  const _FPC_FORMAT_T_ f = _FPC_FORMAT_FP16_;
+  return _FPC_FLOAT_DECODE_IN_(x, &f);
+}
+
+_FPC_DECODED_T_ _FPC_BF16_DECODE_(float x) {
+  const _FPC_FORMAT_T_ f = _FPC_FORMAT_BF16_;
+  return _FPC_FLOAT_DECODE_IN_(x, &f);
+}
+
+/** The sign and the 15-bit exponent of x87 extended precision and quad
+ * precision are in the 16 most significant bits. The significand of x87
+ * has an explicit integer bit. **/
+#if LDBL_MANT_DIG == 64
+_FPC_DECODED_T_ _FPC_FP80_DECODE_(long double x) {
+  _FPC_DECODED_T_ d;
+  uint64_t mantissa;
+  uint16_t val;
+  memcpy((void *) &mantissa, (void *) &x, sizeof(mantissa));
+  memcpy((void *) &val, (char *) &x + 8, sizeof(val));
+  d.exponent = (int)(val & 0x7fff);
+  d.zero = (d.exponent == 0 && mantissa == 0);
+  d.nan = (d.exponent == 0x7fff && (mantissa << 1) != 0);
+  d.negative = (int)(val >> 15);
+  return d;
+}
 #endif
-    _FPC_HT_SET_(_FPC_HTABLE_, &item);
-#ifdef FPC_MULTI_THREADED
-    pthread_mutex_unlock(&fpc_lock);
+
+#if defined(__SIZEOF_FLOAT128__) || LDBL_MANT_DIG == 113
+_FPC_DECODED_T_ _FPC_FP128_DECODE_(_FPC_QUAD_T_ x) {
+  _FPC_DECODED_T_ d;
+  uint64_t words[2];
+  memcpy((void *) words, (void *) &x, sizeof(words));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  uint64_t high = words[1], low = words[0];
+#else
+  uint64_t high = words[0], low = words[1];
 #endif
-    _FPC_CHECK_AND_TRAP(&item, loc, file_name);
+  uint64_t mantissa = (high & 0xffffffffffffull) | low;
+  d.exponent = (int)((high >> 48) & 0x7fff);
+  d.zero = (d.exponent == 0 && mantissa == 0);
+  d.nan = (d.exponent == 0x7fff && mantissa != 0);
+  d.negative = (int)(high >> 63);
+  return d;
+}
+#endif
+
+// Fast path: returns 1 if no event can occur (see _FPC_FP32_FAST_PATH_)
+int _FPC_FORMAT_FAST_PATH_(const _FPC_FORMAT_T_ *f, const _FPC_DECODED_T_ *x,
+                           const _FPC_DECODED_T_ *y, const _FPC_DECODED_T_ *z, int op) {
+  if (op == 4)
+    return 0;
+
+  int zone = _FPC_FORMAT_ZONE_(f);
+  if (x->exponent <= zone || x->exponent >= _FPC_FORMAT_EXPONENTS_(f) - zone)
+    return 0;
+
+  if (op == 3 && z->exponent == 0)
+    return 0;
+
+  if (op == 0 || op == 1) {
+    int e1 = y->exponent;
+    int e2 = z->exponent;
+    if ((FPC_MAX(e1,e2) - x->exponent) > _FPC_FORMAT_CANCELLATION_(f))
+      return 0;
+    // An operand can only be absorbed f->bits or more binades below the
+    // other; the exponent of a subnormal (0) understates the gap
+    if (!y->zero && !z->zero &&
+        (e1 == 0 || e2 == 0 || e1 - e2 >= f->bits || e2 - e1 >= f->bits))
+      return 0;
   }
+
+  return 1;
+}
+
+/** Sets the location and the events of an operation with result x and
+ * operands y and z. absorbed is 1 if x is one of the operands. **/
+void _FPC_FORMAT_SET_EVENTS_(_FPC_ITEM_T_ *item, const _FPC_FORMAT_T_ *f,
+    const _FPC_DECODED_T_ *x, const _FPC_DECODED_T_ *y, const _FPC_DECODED_T_ *z,
+    int absorbed, int loc, char *file_name, int op) {
+  item->file_name = file_name;
+  item->line = (uint64_t)loc;
+  item->function = NULL;
+  item->fast_math = 0;
+  item->executions = 0;
+  item->cycles = 0;
+  item->captures = NULL;
+  item->ranges = NULL;
+  item->emulation = NULL;
+  item->shadow = NULL;
+  item->perturbation = NULL;
+  item->denormals = NULL;
+  item->conversion = NULL;
+
+  int n = _FPC_FORMAT_EXPONENTS_(f);
+  int zone = _FPC_FORMAT_ZONE_(f);
+  int inf = (x->exponent == n - 1 && !x->nan);
+  int finite = (x->exponent != n - 1 && y->exponent != n - 1 && z->exponent != n - 1);
+  int latent_inf = (!x->zero && !x->nan && x->exponent >= n - zone);
+  int gap = (y->exponent > z->exponent) ? y->exponent - z->exponent : z->exponent - y->exponent;
+
+  item->infinity_pos         = (uint64_t)(inf && !x->negative);
+  item->infinity_neg         = (uint64_t)(inf && x->negative);
+  item->nan                  = (uint64_t)x->nan;
+  item->division_zero        = (uint64_t)(op == 3 && !y->zero && z->zero);
+  item->cancellation         = (uint64_t)((op == 0 || op == 1) &&
+      (FPC_MAX(y->exponent, z->exponent) - x->exponent) > _FPC_FORMAT_CANCELLATION_(f));
+  item->comparison           = (uint64_t)(op == 4);
+  item->underflow            = (uint64_t)(!x->zero && x->exponent == 0);
+  item->latent_infinity_pos  = (uint64_t)(latent_inf && !x->negative);
+  item->latent_infinity_neg  = (uint64_t)(latent_inf && x->negative);
+  item->latent_underflow     = (uint64_t)(!x->zero && x->exponent <= zone);
+  item->absorption_gap       = (uint64_t)((absorbed && finite) ? gap : 0);
+  item->absorption           = (item->absorption_gap > 0);
+}
+
+/** Generates the checks of the format FORMAT (_FPC_FORMAT_T_) for values of
+ * type T, with bits BITS in the traces: _FPC_<NAME>_FAST_PATH_,
+ * _FPC_<NAME>_SET_EVENTS_, _FPC_<NAME>_SLOW_PATH_ and _FPC_<NAME>_CHECK_,
+ * as the ones of FP32. Values are decoded by _FPC_<NAME>_DECODE_ and
+ * compared on their first BYTES bytes. **/
+#define _FPC_DEFINE_FORMAT_CHECKS_(NAME, T, FORMAT, BITS, BYTES)                      \
+int _FPC_##NAME##_FAST_PATH_(T x, T y, T z, int op) {                                 \
+  const _FPC_FORMAT_T_ f = FORMAT;                                                     \
+  _FPC_DECODED_T_ dx = _FPC_##NAME##_DECODE_(x);                                       \
+  _FPC_DECODED_T_ dy = _FPC_##NAME##_DECODE_(y);                                       \
+  _FPC_DECODED_T_ dz = _FPC_##NAME##_DECODE_(z);                                       \
+  return _FPC_FORMAT_FAST_PATH_(&f, &dx, &dy, &dz, op);                                \
+}                                                                                      \
+                                                                                       \
+void _FPC_##NAME##_SET_EVENTS_(_FPC_ITEM_T_ *item,                                    \
+    T x, T y, T z, int loc, char *file_name, int op) {                                 \
+  const _FPC_FORMAT_T_ f = FORMAT;                                                     \
+  _FPC_DECODED_T_ dx = _FPC_##NAME##_DECODE_(x);                                       \
+  _FPC_DECODED_T_ dy = _FPC_##NAME##_DECODE_(y);                                       \
+  _FPC_DECODED_T_ dz = _FPC_##NAME##_DECODE_(z);                                       \
+  T w = (op == 0) ? z : -z;                                                            \
+  int absorbed = (op == 0 || op == 1) && !dy.zero && !dz.zero &&                       \
+                 (memcmp(&x, &y, BYTES) == 0 || memcmp(&x, &w, BYTES) == 0);           \
+  _FPC_FORMAT_SET_EVENTS_(item, &f, &dx, &dy, &dz, absorbed, loc, file_name, op);     \
+}                                                                                      \
+                                                                                       \
+void _FPC_##NAME##_SLOW_PATH_(T x, T y, T z, int loc, char *file_name, int op,       \
+                              int fast_math) {                                         \
+  _FPC_ITEM_T_ item;                                                                   \
+  _FPC_##NAME##_SET_EVENTS_(&item, x, y, z, loc, file_name, op);                       \
+  item.fast_math = (uint32_t)fast_math;                                                \
+                                                                                       \
+  if (_FPC_EVENT_OCURRED(&item)) {                                                     \
+    double operands[2] = { (double)y, (double)z };                                     \
+    _FPC_RECORDER_ADD_(&item, (double)x, operands, 2, op, BITS);                       \
+    _FPC_SAVE_EVENTS_(&item, (double)x, operands, 2, BITS);                            \
+    _FPC_CHECK_AND_TRAP(&item, loc, file_name);                                        \
+  }                                                                                    \
+}                                                                                      \
+                                                                                       \
+void _FPC_##NAME##_CHECK_(T x, T y, T z, int loc, char *file_name, int op, int cond) { \
+  if (!cond)                                                                           \
+    return;                                                                            \
+                                                                                       \
+  int fast_math = op >> 8;                                                             \
+  op &= 0xff;                                                                          \
+  _FPC_ITEM_T_ *site = NULL;                                                           \
+  uint64_t start = 0;                                                                  \
+  if (_FPC_OPTIONS_.site_mode) {                                                       \
+    site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);                       \
+    if (!_FPC_SITE_ENTER_(site, &start)) {                                             \
+      _FPC_SITE_EXIT_(site, start);                                                    \
+      return;                                                                          \
+    }                                                                                  \
+    if (_FPC_OPTIONS_.denormals) {                                                     \
+      _FPC_DECODED_T_ dx = _FPC_##NAME##_DECODE_(x);                                   \
+      _FPC_DECODED_T_ dy = _FPC_##NAME##_DECODE_(y);                                   \
+      _FPC_DECODED_T_ dz = _FPC_##NAME##_DECODE_(z);                                   \
+      _FPC_DENORMAL_UPDATE_(site, (dy.exponent == 0 && !dy.zero) ||                    \
+                            (dz.exponent == 0 && !dz.zero),                            \
+                            op != 4 && dx.exponent == 0 && !dx.zero);                  \
+    }                                                                                  \
+  }                                                                                    \
+                                                                                       \
+  if (!_FPC_##NAME##_FAST_PATH_(x, y, z, op))                                          \
+    _FPC_##NAME##_SLOW_PATH_(x, y, z, loc, file_name, op, fast_math);                  \
+                                                                                       \
+  if (site)                                                                            \
+    _FPC_SITE_EXIT_(site, start);                                                      \
 }
 
+_FPC_DEFINE_FORMAT_CHECKS_(FP16, float, _FPC_FORMAT_FP16_, 16, 4)
+_FPC_DEFINE_FORMAT_CHECKS_(BF16, float, _FPC_FORMAT_BF16_, 16, 4)
+#if LDBL_MANT_DIG == 64
+_FPC_DEFINE_FORMAT_CHECKS_(FP80, long double, _FPC_FORMAT_FP80_, 80, 10)
+#endif
+#if defined(__SIZEOF_FLOAT128__) || LDBL_MANT_DIG == 113
+_FPC_DEFINE_FORMAT_CHECKS_(FP128, _FPC_QUAD_T_, _FPC_FORMAT_FP128_, 128, 16)
+#endif
+
+/** x = (half or bfloat)y, with x widened to float. to_type is 0 (FP16) or
+ * 3 (BF16). Overflows and underflows are counted as for float. **/
+void _FPC_SMALL_TRUNC_CHECK_(float x, double y, int from_bits, int to_type,
+                             int loc, char *file_name) {
+  const _FPC_FORMAT_T_ fp16 = _FPC_FORMAT_FP16_, bf16 = _FPC_FORMAT_BF16_;
+  const _FPC_FORMAT_T_ *f = (to_type == 0) ? &fp16 : &bf16;
+  _FPC_ITEM_T_ *site = NULL;
+  uint64_t start = 0;
+  if (_FPC_OPTIONS_.site_mode) {
+    site = _FPC_HT_GET_(_FPC_HTABLE_, file_name, (uint64_t)loc);
+    if (!_FPC_SITE_ENTER_(site, &start)) {
+      _FPC_SITE_EXIT_(site, start);
+      return;
+    }
+  }
+
+  _FPC_DECODED_T_ dx = _FPC_FLOAT_DECODE_IN_(x, f), none;
+  memset(&none, 0, sizeof(none));
+  if (!_FPC_FORMAT_FAST_PATH_(f, &dx, &none, &none, 8)) {
+    _FPC_ITEM_T_ item;
+    _FPC_FORMAT_SET_EVENTS_(&item, f, &dx, &none, &none, 0, loc, file_name, 8);
+    int overflow = _FPC_FP32_IS_INF(x) && _FPC_FP64_IS_FINITE_(y);
+    int underflow = !_FPC_FP64_IS_ZERO_(y) && dx.exponent == 0;
+    if (overflow || underflow)
+      _FPC_CONVERSION_UPDATE_(file_name, loc, from_bits, 0, 16, to_type,
+                              overflow, underflow, 0);
+    if (underflow)
+      item.underflow = 1;
+
+    if (_FPC_EVENT_OCURRED(&item)) {
+      double operands[1] = { y };
+      _FPC_RECORDER_ADD_(&item, (double)x, operands, 1, 8, 16);
+      _FPC_SAVE_EVENTS_(&item, (double)x, operands, 1, 16);
+      _FPC_CHECK_AND_TRAP(&item, loc, file_name);
+    }
+  }
+
+  if (site)
+    _FPC_SITE_EXIT_(site, start);
+}
+
+void _FPC_FP16_TRUNC_CHECK_(float x, double y, int from_bits, int loc, char *file_name,
+                            int cond) {
+  if (cond)
+    _FPC_SMALL_TRUNC_CHECK_(x, y, from_bits, 0, loc, file_name);
+}
+
+void _FPC_BF16_TRUNC_CHECK_(float x, double y, int from_bits, int loc, char *file_name,
+                            int cond) {
+  if (cond)
+    _FPC_SMALL_TRUNC_CHECK_(x, y, from_bits, 3, loc, file_name);
+}
+
+/** (int<bits>)y or (unsigned int<bits>)y, with y widened to float **/
+void _FPC_FP16_TOINT_CHECK_(float y, int bits, int is_signed, int loc, char *file_name,
+                            int cond) {
+  if (cond)
+    _FPC_TOINT_CHECK_((double)y, 16, 0, bits, is_signed, loc, file_name);
+}
+
+void _FPC_BF16_TOINT_CHECK_(float y, int bits, int is_signed, int loc, char *file_name,
+                            int cond) {
+  if (cond)
+    _FPC_TOINT_CHECK_((double)y, 16, 3, bits, is_signed, loc, file_name);
+}
+
+
+#ifdef FPC_MPI
+#include "Runtime_mpi.h"
+#endif
+
+#if defined(__clang__)
+#pragma float_control(pop)
+#endif
 
 #endif /* SRC_RUNTIME_CPU_H_ */
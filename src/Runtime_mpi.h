@@ -0,0 +1,93 @@
+#ifndef SRC_RUNTIME_MPI_H_
+#define SRC_RUNTIME_MPI_H_
+
+/**
+ * MPI reduction of traces
+ * ------------------------
+ * Included by Runtime_cpu.h when FPC_MPI is defined (mpicc-fpchecker).
+ *
+ * With FPC_MPI_REDUCE=1, MPI_Finalize merges the tables of all the ranks
+ * with a binomial tree reduction keyed by (file, line), and rank 0 writes a
+ * single trace. Each location of the trace has the sum of the counters of
+ * all the ranks, as in a regular trace, plus:
+ *   "ranks": ranks that saved the location (e.g., "0-3,6")
+ *   "min", "max": minimum and maximum of each counter over those ranks
+ * Other ranks do not write traces. The tables are merged with the merge
+ * tables of FPC_MergeTable.h.
+ **/
+
+#include <mpi.h>
+
+#define _FPC_MPI_TAG_       7101
+
+/** Reduces the tables of all the ranks to rank 0. It replaces the trace
+ * of each rank, so the traces are not written again at the end of main. **/
+void _FPC_MPI_REDUCE_TRACES_() {
+  if (getenv("FPC_MPI_REDUCE") == NULL || _FPC_HTABLE_ == NULL)
+    return;
+  if (__atomic_exchange_n(&_FPC_FLUSH_.finalized, 1, __ATOMIC_ACQ_REL))
+    return;
+  _FPC_FLUSH_STOP_();
+
+  MPI_Comm comm;
+  int rank, size;
+  PMPI_Comm_dup(MPI_COMM_WORLD, &comm);
+  PMPI_Comm_rank(comm, &rank);
+  PMPI_Comm_size(comm, &size);
+
+  _FPC_MERGE_TABLE_T_ table;
+  _FPC_MERGE_INIT_(&table, size);
+  _FPC_ITEM_T_ *items = NULL;
+  uint64_t capacity = 0;
+  uint64_t n = _FPC_HT_SNAPSHOT_(_FPC_HTABLE_, &items, &capacity);
+  _FPC_MERGE_ITEMS_(&table, items, n, rank);
+  free(items);
+
+  // Binomial tree: in step k, ranks with bit k set send to rank - 2^k
+  for (int mask = 1; mask < size; mask <<= 1) {
+    if (rank & mask) {
+      uint64_t *msg = NULL;
+      uint64_t words = _FPC_MERGE_PACK_(&table, &msg);
+      PMPI_Send(&words, 1, MPI_UINT64_T, rank - mask, _FPC_MPI_TAG_, comm);
+      PMPI_Send(msg, (int)words, MPI_UINT64_T, rank - mask, _FPC_MPI_TAG_, comm);
+      free(msg);
+      break;
+    } else if (rank + mask < size) {
+      uint64_t words = 0;
+      PMPI_Recv(&words, 1, MPI_UINT64_T, rank + mask, _FPC_MPI_TAG_, comm, MPI_STATUS_IGNORE);
+      uint64_t *msg = (uint64_t *)malloc(sizeof(uint64_t) * words);
+      if (msg == NULL) {
+        printf("#FPCHECKER: MPI reduction out of memory error!");
+        exit(EXIT_FAILURE);
+      }
+      PMPI_Recv(msg, (int)words, MPI_UINT64_T, rank + mask, _FPC_MPI_TAG_, comm, MPI_STATUS_IGNORE);
+      _FPC_MERGE_UNPACK_(&table, msg);
+      free(msg);
+    }
+  }
+
+  // Traces saved by flushes (FPC_FLUSH_INTERVAL) are replaced
+  char fileName[5000];
+  _FPC_TRACE_FILE_NAME_(fileName, ".json");
+  unlink(fileName);
+  _FPC_TRACE_FILE_NAME_(fileName, _FPC_TRACE_EXTENSION_);
+  unlink(fileName);
+
+  // With FPC_LOCAL_DIR, the trace goes directly to the shared directory
+  if (rank == 0) {
+    printf("#FPCHECKER: Reducing traces of %d ranks...\n", size);
+    _FPC_TRACE_PATH_(fileName, 0, 1, ".json");
+    _FPC_MERGE_WRITE_TRACE_(&table, fileName, size);
+  }
+  _FPC_STAGE_TRACES_();
+
+  _FPC_MERGE_FREE_(&table);
+  PMPI_Comm_free(&comm);
+}
+
+int MPI_Finalize(void) {
+  _FPC_MPI_REDUCE_TRACES_();
+  return PMPI_Finalize();
+}
+
+#endif /* SRC_RUNTIME_MPI_H_ */
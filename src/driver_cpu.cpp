@@ -15,7 +15,13 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#if LLVM_VERSION_MAJOR < 16
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#endif
 #include "llvm/CodeGen/RegAllocRegistry.h"
 #include "llvm/IR/LegacyPassManager.h"
 
@@ -29,17 +35,64 @@ using namespace llvm;
 namespace CPUAnalysis
 {
 
-class CPUKernelAnalysis : public ModulePass
+/**
+ * Pipeline position
+ * ------------------
+ * The pass is loaded with -Xclang -load (legacy pass manager) or
+ * -fpass-plugin (new pass manager, llvmGetPassPluginInfo below), and
+ * FPC_PASS_POSITION selects where it runs in the optimization pipeline:
+ *  - late (default): after the optimizations and the vectorizers. The
+ *    checks see the operations that run, including vector operations
+ *    (checked lane by lane), and they don't prevent optimizations, but
+ *    inlining and other transformations can merge or move the sites;
+ *  - early: before inlining and vectorization, so the sites are the
+ *    operations of the source. The check calls then stay in the loops and
+ *    usually prevent their vectorization, which increases the overhead.
+ * At -O0, only one position runs. Both extension points can still fire for
+ * the same module (e.g., both pass managers load the plugin, or the module
+ * goes through the pipeline again in LTO), so an instrumented module is
+ * marked with the fpc.instrumented named metadata and not instrumented again.
+ *
+ * With FPC_LTO=1, the pass runs at link time instead (see prepareForLTO):
+ * at compile time the wrappers set FPC_LTO_PRELINK, and the pass only
+ * prepares the runtime; the ThinLTO backends run the optimizer-last
+ * extension point, so the position is always late.
+ **/
+static bool isSet(const char *option)
 {
-public:
-  static char ID;
+  const char *value = getenv(option);
+  return value != nullptr && std::string(value) != "0";
+}
 
-  CPUKernelAnalysis() : ModulePass(ID) {}
+static bool isEarlyPosition()
+{
+  const char *position = getenv("FPC_PASS_POSITION");
+  return position != nullptr && std::string(position) == "early" && !isSet("FPC_LTO");
+}
 
-	virtual bool runOnModule(Module &M)
-	{
+static const char *INSTRUMENTED_MD = "fpc.instrumented";
+
+/* Instruments the module; returns false if it was already instrumented */
+static bool instrumentModule(Module &M)
+{
+		if (M.getNamedMetadata(INSTRUMENTED_MD) != nullptr) {
+#ifdef FPC_DEBUG
+			CUDAAnalysis::Logging::info("Module already instrumented");
+#endif
+			return false;
+		}
 		Module *m = &M;
 		CPUFPInstrumentation *fpInstrumentation = new CPUFPInstrumentation(m);
+
+		// Compilation for LTO-time instrumentation
+		if (isSet("FPC_LTO_PRELINK")) {
+			fpInstrumentation->prepareForLTO();
+			std::string out_tmp = "Prepared for LTO @ " + m->getName().str();
+			CUDAAnalysis::Logging::info(out_tmp.c_str());
+			delete fpInstrumentation;
+			return true;
+		}
+		M.getOrInsertNamedMetadata(INSTRUMENTED_MD);
     long int instrumented = 0;
 
 #ifdef FPC_DEBUG
@@ -63,6 +116,7 @@ public:
 #endif
       long int c = 0;
       fpInstrumentation->instrumentFunction(F, &c);
+      fpInstrumentation->shadowFunction(F);
       instrumented += c;
 
       if (CUDAAnalysis::CodeMatching::isMainFunction(F)) {
@@ -73,15 +127,50 @@ public:
       }
 		}
 
-  std::string out_tmp = "Instrumented " + std::to_string(instrumented) + " @ " + m->getName().str();
+  std::string out_tmp = "Instrumented " + std::to_string(instrumented) + " @ " + m->getName().str() +
+      (isEarlyPosition() ? " (early)" : "");
   CUDAAnalysis::Logging::info(out_tmp.c_str());
+  if (fpInstrumentation->getEmulatedOperations() > 0) {
+    out_tmp = "Emulated " + std::to_string(fpInstrumentation->getEmulatedOperations()) +
+        " (" + getenv("FPC_EMULATE") + ") @ " + m->getName().str();
+    CUDAAnalysis::Logging::info(out_tmp.c_str());
+  }
+  if (fpInstrumentation->getPerturbedOperations() > 0) {
+    out_tmp = "Perturbed " + std::to_string(fpInstrumentation->getPerturbedOperations()) +
+        " @ " + m->getName().str();
+    CUDAAnalysis::Logging::info(out_tmp.c_str());
+  }
+  if (fpInstrumentation->getShadowedOperations() > 0) {
+    out_tmp = "Shadowed " + std::to_string(fpInstrumentation->getShadowedOperations()) +
+        " @ " + m->getName().str();
+    CUDAAnalysis::Logging::info(out_tmp.c_str());
+  }
+
+  if (fpInstrumentation->getUnlocatedOperations() > 0) {
+    out_tmp = "Operations without debug location: " +
+        std::to_string(fpInstrumentation->getUnlocatedOperations()) + " @ " + m->getName().str() +
+        " (reported at the line of their function; build with -gline-tables-only)";
+    CUDAAnalysis::Logging::info(out_tmp.c_str());
+  }
 
   // This emulates a failure in the pass
   if (getenv("FPC_INJECT_FAULT") != NULL)
     exit(-1);
 
 		delete fpInstrumentation;
-		return false;
+		return true;
+}
+
+class CPUKernelAnalysis : public ModulePass
+{
+public:
+  static char ID;
+
+  CPUKernelAnalysis() : ModulePass(ID) {}
+
+	virtual bool runOnModule(Module &M)
+	{
+		return instrumentModule(M);
 	}
 
 };
@@ -94,15 +183,79 @@ static RegisterPass<CPUKernelAnalysis> X(
 		false,
 		false);
 
+#if LLVM_VERSION_MAJOR < 16
 static void registerPass(const PassManagerBuilder &, legacy::PassManagerBase &PM)
 {
 	PM.add(new CPUKernelAnalysis());
 }
 
+static void registerEarlyPass(const PassManagerBuilder &B, legacy::PassManagerBase &PM)
+{
+	if (isEarlyPosition())
+		registerPass(B, PM);
+}
+
+static void registerLatePass(const PassManagerBuilder &B, legacy::PassManagerBase &PM)
+{
+	if (!isEarlyPosition())
+		registerPass(B, PM);
+}
+
 static RegisterStandardPasses
     RegisterMyPass(PassManagerBuilder::EP_EnabledOnOptLevel0,registerPass);
 static RegisterStandardPasses
-    RegisterMyPass2(PassManagerBuilder::EP_OptimizerLast,registerPass);
+    RegisterMyPass2(PassManagerBuilder::EP_OptimizerLast,registerLatePass);
+static RegisterStandardPasses
+    RegisterMyPass3(PassManagerBuilder::EP_ModuleOptimizerEarly,registerEarlyPass);
+#endif
+
+/* New pass manager */
+struct CPUKernelAnalysisPass : PassInfoMixin<CPUKernelAnalysisPass>
+{
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &)
+  {
+    return instrumentModule(M) ? PreservedAnalyses::none() : PreservedAnalyses::all();
+  }
+
+  // The pass must also run on optnone (-O0) functions
+  static bool isRequired() { return true; }
+};
+
+static void registerNewPMPass(PassBuilder &PB)
+{
+#if LLVM_VERSION_MAJOR < 12
+  PB.registerPipelineStartEPCallback([](ModulePassManager &MPM) {
+#else
+  PB.registerPipelineStartEPCallback([](ModulePassManager &MPM, auto) {
+#endif
+    if (isEarlyPosition())
+      MPM.addPass(CPUKernelAnalysisPass());
+  });
+  PB.registerOptimizerLastEPCallback([](ModulePassManager &MPM, auto) {
+    if (!isEarlyPosition())
+      MPM.addPass(CPUKernelAnalysisPass());
+  });
+#if LLVM_VERSION_MAJOR >= 15
+  // Full LTO (FPC_LTO)
+  PB.registerFullLinkTimeOptimizationLastEPCallback([](ModulePassManager &MPM, auto) {
+    MPM.addPass(CPUKernelAnalysisPass());
+  });
+#endif
+  // opt -passes=fpchecker
+  PB.registerPipelineParsingCallback(
+      [](StringRef name, ModulePassManager &MPM, ArrayRef<PassBuilder::PipelineElement>) {
+        if (name != "fpchecker")
+          return false;
+        MPM.addPass(CPUKernelAnalysisPass());
+        return true;
+      });
+}
+
+}
+
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo()
+{
+  return {LLVM_PLUGIN_API_VERSION, "FPChecker", "0.2.0", CPUAnalysis::registerNewPMPass};
 }
 
 
@@ -0,0 +1,15 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 1e20;
+  for (int i=0; i < n; ++i) {
+    double y = x[i] + 1.0;
+    res = res + y; // y < ulp(1e20)/2 is absorbed
+  }
+  return res;
+}
+
+// The subnormal z is absorbed by y = 2^-104 (23 binades above z)
+float computeSubnormal(float y, float z) {
+  return y + z;
+}
@@ -0,0 +1,4 @@
+
+double compute(double *x, int n);
+
+float computeSubnormal(float y, float z);
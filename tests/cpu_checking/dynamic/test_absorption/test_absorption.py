@@ -0,0 +1,59 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["rm -rf .fpc_logs && ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+
+    found = False
+    foundSubnormal = False
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp'):
+        assert data[i]['line'] != 6
+        if data[i]['line'] == 7:
+          assert data[i]['absorption'] == 8
+          # 1e20 is 2^66; y is at most 2^3
+          assert data[i]['absorption_gap'] >= 63
+          found = True
+        if data[i]['line'] == 14:
+          # A subnormal operand has exponent 0
+          assert data[i]['absorption'] == 1
+          assert data[i]['absorption_gap'] == 23
+          foundSubnormal = True
+    assert found
+    assert foundSubnormal
+
+    # --- absorptions are reported as an event ---
+    cmd = ["fpc-create-report -s"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    for l in cmdOutput.decode('utf-8').split('\n'):
+      if l.startswith('absorption'):
+        assert int(l.split()[1]) == 9
@@ -0,0 +1,17 @@
+#include <stdio.h>
+#include "FPC_TraceReader.h"
+
+// Prints the locations with NaN events of a binary trace
+int main(int argc, char **argv)
+{
+  if (argc != 2)
+    return 1;
+
+  FPChecker::TraceReader trace(argv[1]);
+  int nan = trace.fieldIndex("nan");
+  for (auto record : trace)
+    if (record[nan] != 0)
+      printf("%s:%lu nan: %lu\n", record.file(), record.line(), record[nan]);
+
+  return 0;
+}
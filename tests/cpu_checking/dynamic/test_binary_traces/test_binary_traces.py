@@ -0,0 +1,58 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+import sys
+import glob
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["FPC_TRACE_FORMAT=binary ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    traces = glob.glob('.fpc_logs/fpc_*.fpcb')
+    assert len(traces) == 1
+    assert report.numberReportFiles('.fpc_logs') == 0
+
+    # --- read binary trace ---
+    cmd = ["./read_trace " + traces[0]]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    assert 'compute.cpp:10 nan:' in cmdOutput.decode('utf-8')
+
+    # --- convert to json ---
+    cmd = ["fpc-convert --json"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+    found = False
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp'):
+        if data[i]['nan'] > 0:
+          if data[i]['line'] == 10:
+            found = True
+            break
+
+    assert found
@@ -0,0 +1,61 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code: keep the first 2 occurrences of each event ---
+    cmd = ["rm -rf .fpc_logs && FPC_CAPTURE_OCCURRENCES=2 ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+
+    found = False
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp') and data[i]['line'] == 9:
+        assert data[i]['nan'] == 8
+        occ = data[i]['occurrences']['nan']
+        assert len(occ) == 2
+        for o in occ:
+          assert 'nan' in o['result']
+          assert len(o['operands']) == 2
+          assert o['bits'] == 64
+        assert occ[0]['time_ns'] <= occ[1]['time_ns']
+        found = True
+    assert found
+
+    # --- the occurrences are shown in the source report ---
+    cmd = ["fpc-create-report"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    with open('fpc-report/nan/source_1.html', 'r') as fd:
+      html = fd.read()
+    assert 'First Occurrences' in html
+    assert 'No occurrences' not in html
@@ -0,0 +1,62 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+import time
+import signal
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def nanCount(fileName):
+    nan = 0
+    data = report.loadReport(fileName)
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp') and data[i]['line'] == 9:
+        nan += data[i]['nan']
+    return nan
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run 10 processes with a collector ---
+    subprocess.check_output(["rm -rf .fpc_logs fpc.sock"], shell=True)
+    collector = subprocess.Popen(['fpc-collectd', '-s', 'fpc.sock', '-c', 'test'],
+      stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    for i in range(50):
+      if os.path.exists('fpc.sock'):
+        break
+      time.sleep(0.1)
+
+    env = dict(os.environ, FPC_COLLECTOR=os.path.abspath('fpc.sock'))
+    for i in range(10):
+      subprocess.check_output(['./main'], env=env, stderr=subprocess.STDOUT)
+    collector.send_signal(signal.SIGTERM)
+    collector.wait()
+
+    # One trace for the campaign
+    assert report.numberReportFiles('.fpc_logs') == 1
+    assert os.path.exists('.fpc_logs/fpc_test.json')
+    assert nanCount('.fpc_logs/fpc_test.json') == 80
+
+def test_2():
+    # --- no collector: the trace is written to a file ---
+    subprocess.check_output(["rm -rf .fpc_logs fpc.sock"], shell=True)
+    env = dict(os.environ, FPC_COLLECTOR=os.path.abspath('fpc.sock'))
+    cmdOutput = subprocess.check_output(['./main'], env=env, stderr=subprocess.STDOUT)
+    assert b'No collector' in cmdOutput
+    assert report.numberReportFiles('.fpc_logs') == 1
+    assert nanCount(report.findReportFile('.fpc_logs')) == 8
@@ -0,0 +1,12 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    float f = (float)(x[i] * 1e300); // overflows float
+    long k = (int)(x[i] * 1e9); // out of the range of int for x >= 3
+    if (f > 1.0f)
+      res += k;
+  }
+  return res;
+}
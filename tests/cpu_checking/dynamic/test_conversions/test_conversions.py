@@ -0,0 +1,57 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["rm -rf .fpc_logs && ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+
+    found = 0
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp'):
+        if data[i]['line'] == 6:
+          assert data[i]['infinity_pos'] == 8
+          assert data[i]['conversion']['from'] == 'fp64'
+          assert data[i]['conversion']['to'] == 'fp32'
+          assert data[i]['conversion']['overflows'] == 8
+          assert data[i]['conversion']['underflows'] == 0
+          found += 1
+        if data[i]['line'] == 7:
+          assert data[i]['conversion']['to'] == 'i32'
+          assert data[i]['conversion']['out_of_range'] == 6
+          found += 1
+    assert found == 2
+
+    # --- conversions are shown by the precision report ---
+    cmd = ["fpc-create-report -p"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    out = cmdOutput.decode('utf-8')
+    assert 'compute.cpp:6 fp64 -> fp32 overflows: 8' in out
+    assert 'compute.cpp:7 fp64 -> i32' in out
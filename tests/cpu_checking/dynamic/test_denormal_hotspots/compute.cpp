@@ -0,0 +1,11 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    double tiny = x[i] * 1e-310; // subnormal result
+    double half = tiny * 0.5;    // subnormal operand
+    res = res + half * 1e300;
+  }
+  return res;
+}
@@ -0,0 +1,64 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code: count the subnormal numbers, with and without FTZ/DAZ ---
+    cmd = ["rm -rf .fpc_logs .fpc_logs_ftz && FPC_PROFILE_DENORMALS=1 ./main && " +
+           "FPC_PROFILE_DENORMALS=1 FPC_FTZ_DAZ=1 FPC_STAGE_DIR=.fpc_logs_ftz ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+
+    found = 0
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if not data[i]['file'].endswith('compute.cpp'):
+        continue
+      if data[i]['line'] == 6:
+        d = data[i]['denormals']
+        assert d['operands'] == 0 and d['results'] == 8 and d['assists'] == 8
+        found += 1
+      if data[i]['line'] == 7:
+        d = data[i]['denormals']
+        assert d['operands'] == 8 and d['assists'] == 8
+        found += 1
+    assert found == 2
+
+    # With FTZ/DAZ the operations do not take the slow path
+    fileName = report.findReportFile('.fpc_logs_ftz')
+    for r in report.loadReport(fileName):
+      if 'denormals' in r:
+        assert r['denormals']['ftz_daz'] == 1
+        assert r['denormals']['assists'] == 0
+
+    # --- hotspots and FTZ/DAZ comparison ---
+    cmd = ["fpc-create-report -d --ftz .fpc_logs_ftz .fpc_logs"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    out = cmdOutput.decode('utf-8')
+    assert 'Denormal Performance Hotspots' in out
+    assert 'compute.cpp:6 assists: 8' in out
+    assert 'FTZ/DAZ Comparison' in out
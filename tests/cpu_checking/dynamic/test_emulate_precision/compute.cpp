@@ -0,0 +1,10 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    double y = x[i] * 10000.0; // overflows in fp16
+    res = res + y;
+  }
+  return res;
+}
@@ -0,0 +1,49 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code: compute() runs in fp16 ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["rm -rf .fpc_logs && ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # The program sees the emulated results
+    assert 'Result: inf' in cmdOutput.decode('utf-8')
+
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+
+    found = False
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp') and data[i]['line'] == 6:
+        e = data[i]['emulation']
+        assert e['format'] == 'fp16'
+        assert e['executions'] == 8
+        # 70000 and 80000 overflow
+        assert e['overflows'] == 2
+        assert data[i]['infinity_pos'] == 2
+        found = True
+    assert found
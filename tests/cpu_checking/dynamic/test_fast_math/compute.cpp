@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    double a = x[i] - (double)(i+1); // x[i] is i+1 in main.cpp
+    double b = x[i] * 2.0 - (double)(2*i+2);
+    double c = a / b; // 0/0 despite nnan
+    if (c == c)
+      res += c;
+  }
+  return res;
+}
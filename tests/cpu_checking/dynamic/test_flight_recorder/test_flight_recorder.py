@@ -0,0 +1,46 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+import glob
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def run_command(cmd):
+    ret = 0
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        ret = e.returncode
+    return ret
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    run_command(cmd)
+
+    # --- the trap writes the last events of the process ---
+    cmd = ["rm -rf .fpc_logs && FPC_TRAP_NAN=1 ./main"]
+    assert run_command(cmd) != 0
+
+    files = glob.glob('.fpc_logs/*.flight.txt')
+    assert len(files) == 1
+    with open(files[0], 'r') as fd:
+      lines = fd.readlines()
+    print(lines)
+    assert 'trap nan' in lines[0] and 'compute.cpp:9' in lines[0]
+    events = [l for l in lines if not l.startswith('#') and l.strip() != '']
+    assert 'compute.cpp:9 div 64' in events[-1]
+    assert events[-1].strip().endswith('nan')
+
+    # --- the recorder can be disabled ---
+    cmd = ["rm -rf .fpc_logs && FPC_FLIGHT_RECORDER=0 FPC_TRAP_NAN=1 ./main"]
+    assert run_command(cmd) != 0
+    assert len(glob.glob('.fpc_logs/*.flight.txt')) == 0
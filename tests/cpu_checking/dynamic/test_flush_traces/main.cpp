@@ -0,0 +1,28 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "compute.h"
+
+int main(int argc, char **argv)
+{
+  int n = 8;
+  int nbytes = n*sizeof(double); 
+  double *data = (double *)malloc(nbytes);
+  for (int i=0; i < n; ++i)
+    data[i] = (double)(i+1);
+  printf("Calling kernel\n");
+  double result = compute(data, n);
+  printf("Result: %f\n", result);
+  fflush(stdout);
+
+  // Leave without returning from main
+  if (argc > 1 && strcmp(argv[1], "exit") == 0)
+    exit(0);
+  if (argc > 1 && strcmp(argv[1], "wait") == 0)
+    sleep(60);
+
+  return 0;
+}
+
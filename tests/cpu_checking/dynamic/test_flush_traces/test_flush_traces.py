@@ -0,0 +1,78 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+import sys
+import time
+import signal
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def nanFound():
+    found = False
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp'):
+        if data[i]['nan'] > 0:
+          if data[i]['line'] == 9:
+            found = True
+    return found
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code: exit() ---
+    cmd = ["rm -rf .fpc_logs && ./main exit"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    assert nanFound()
+
+def test_2():
+    # --- run code: killed by SIGTERM ---
+    subprocess.check_output(["rm -rf .fpc_logs"], shell=True)
+    env = dict(os.environ, FPC_FLUSH_INTERVAL='1')
+    proc = subprocess.Popen(['./main', 'wait'], env=env,
+      stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+
+    # The writer thread saves the events before the signal arrives
+    time.sleep(3)
+    assert report.numberReportFiles('.fpc_logs') == 1
+    proc.send_signal(signal.SIGTERM)
+    proc.wait()
+
+    assert proc.returncode == -signal.SIGTERM
+    assert nanFound()
+
+def test_3():
+    # --- run code: killed by SIGTERM, no periodic flushes ---
+    subprocess.check_output(["rm -rf .fpc_logs"], shell=True)
+    env = dict(os.environ, FPC_FLUSH_SIGNALS='1')
+    proc = subprocess.Popen(['./main', 'wait'], env=env,
+      stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+
+    # The handler wakes up the writer thread and waits for the snapshot
+    time.sleep(1)
+    proc.send_signal(signal.SIGTERM)
+    proc.wait()
+
+    assert proc.returncode == -signal.SIGTERM
+    assert nanFound()
@@ -0,0 +1,14 @@
+#include <stdio.h>
+
+typedef double double4 __attribute__((vector_size(4 * sizeof(double))));
+
+double compute(double *x, int n) {
+  double res = 0.0, sum = 0.0;
+  for (int i=0; i < n; ++i) {
+    double f = __builtin_fma(x[i], 1e308, 1e308); // llvm.fma: +inf
+    __atomic_fetch_add(&sum, 1e308, __ATOMIC_RELAXED); // atomicrmw fadd: +inf after the first
+    double4 v = (double4){x[i], x[i], x[i], x[i]} / (double4){0.0, 1.0, 0.0, 1.0};
+    res = res + f + v[1];
+  }
+  return res + sum;
+}
@@ -0,0 +1,3 @@
+
+double compute(double *x, int n);
+
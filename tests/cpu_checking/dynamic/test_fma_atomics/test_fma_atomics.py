@@ -0,0 +1,55 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["rm -rf .fpc_logs && FPC_CAPTURE_OCCURRENCES=1 ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+
+    lines = set()
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if not data[i]['file'].endswith('compute.cpp'):
+        continue
+      line = data[i]['line']
+      lines.add(line)
+      if line == 8:
+        # fused multiply-add: the three operands are kept
+        assert data[i]['infinity_pos'] == 8
+        assert len(data[i]['occurrences']['infinity_pos'][0]['operands']) == 3
+      if line == 9:
+        # 1e308 + 1e308 overflows, then inf + 1e308
+        assert data[i]['infinity_pos'] == 7
+      if line == 10:
+        # lanes 0 and 2 of each vector division
+        assert data[i]['division_zero'] == 16
+
+    assert 8 in lines
+    assert 9 in lines
+    assert 10 in lines
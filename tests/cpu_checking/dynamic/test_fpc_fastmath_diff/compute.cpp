@@ -0,0 +1,10 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    // Cancellation; reassociation folds it to x[i]
+    res = res + ((x[i] + 1e10) - 1e10);
+  }
+  return res;
+}
@@ -0,0 +1,33 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+import json
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- build and run with fast-math in one file at a time ---
+    cmd = ["fpc-fastmath-diff -b 'make clean all' -r ./main -f main.cpp,compute.cpp -j 2 -o fastmath.json"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    with open('fastmath.json', 'r') as fd:
+      result = json.load(fd)
+    print(result)
+    assert result['safe'] == ['main.cpp']
+    files = {x['file']: x for x in result['files']}
+    assert files['main.cpp']['verdict'] == 'safe'
+    assert files['compute.cpp']['verdict'] != 'safe'
+    # The cancellation of line 7 is gone
+    lost = [d for d in files['compute.cpp']['differences'] if d[0] == 'lost']
+    assert ['lost', 'compute.cpp', 7, 'cancellation'] in [d[:4] for d in lost]
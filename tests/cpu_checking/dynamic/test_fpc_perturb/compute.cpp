@@ -0,0 +1,12 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    double y = x[i] * 2.0; // exact
+    double t = x[i] * 0.1 + 1e10;
+    double z = t - 1e10; // keeps only the rounding of t
+    res = res + y + z;
+  }
+  return res;
+}
@@ -0,0 +1,37 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+import json
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- build with random rounding and compare 8 runs ---
+    cmd = ["fpc-perturb -b 'make clean all' -r ./main -n 8 -o perturb.json"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    with open('perturb.json', 'r') as fd:
+      result = json.load(fd)
+    print(result)
+    sites = {}
+    for s in result['sites']:
+      if s['file'].endswith('compute.cpp'):
+        sites[s['line']] = s
+
+    # The multiplication by 2 is exact
+    assert sites[6]['lost_digits'] == 0.0
+    assert sites[6]['reasons'] == []
+    # The subtraction returns the rounding errors of line 7
+    assert 'lost digits' in sites[8]['reasons']
+    assert sites[8]['lost_digits'] > 3.0
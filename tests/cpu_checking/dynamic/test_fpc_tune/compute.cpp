@@ -0,0 +1,18 @@
+#include <stdio.h>
+
+__attribute__((noinline)) double robust(double x) {
+  return x * 2.0 + 1.0;
+}
+
+// The result is 0 in fp32
+__attribute__((noinline)) double sensitive(double x) {
+  return (x + 1e-10) - x;
+}
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    res = res + robust(x[i]) + sensitive(x[i]) * 1e10;
+  }
+  return res;
+}
@@ -0,0 +1,30 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+import json
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- search the functions that can run in fp32 ---
+    cmd = ["fpc-tune -b 'make clean all' -t \"./main | grep -q 'Result: 88.000000'\" "
+           "-f robust,sensitive,compute -j 2 -o tune.json"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    with open('tune.json', 'r') as fd:
+      result = json.load(fd)
+    print(result)
+    assert result['format'] == 'fp32'
+    assert result['double'] == ['sensitive']
+    assert sorted(result['demoted']) == ['compute', 'robust']
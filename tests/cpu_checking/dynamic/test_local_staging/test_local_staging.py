@@ -0,0 +1,49 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+import glob
+import socket
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run 4 processes with node-local traces ---
+    cmd = ["rm -rf .fpc_logs .fpc_local && fpc-run -l .fpc_local -i test -- sh -c './main & ./main & ./main & ./main & wait'"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # A single trace for the node is staged; the local traces are removed
+    assert report.numberReportFiles('.fpc_logs') == 1
+    fileName = report.findReportFile('.fpc_logs')
+    assert os.path.basename(fileName) == 'fpc_test_' + socket.gethostname() + '.json'
+    assert len(glob.glob('.fpc_local/fpc_test/*')) == 0
+
+    found = False
+    data = report.loadReport(fileName)
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp') and data[i]['line'] == 9:
+        assert data[i]['nan'] == 32
+        assert data[i]['min']['nan'] == 8
+        assert data[i]['max']['nan'] == 8
+        found = True
+    assert found
@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+
+# Compares the overhead of the instrumentation per translation unit (at
+# compile time) and at link time (FPC_LTO=1), over the program built with
+# no instrumentation. All the variants are built with ThinLTO. Per
+# translation unit, ratio() is not inlined into the loop of main.cpp, since
+# the check calls are added before the functions of compute.cpp are
+# imported.
+#
+# Usage: ./benchmark.py [-n N] [-r REPETITIONS] [-t TIMES]
+
+import os
+import time
+import argparse
+import subprocess
+
+VARIANTS = [('base', './main_base'), ('per_tu', './main_per_tu'), ('lto', './main')]
+
+def build():
+  subprocess.check_output('make clean && make base per_tu all', stderr=subprocess.STDOUT, shell=True)
+
+# Average seconds of a run
+def runCode(app, n, reps, times):
+  allTimes = []
+  for i in range(times):
+    start = time.perf_counter()
+    subprocess.check_output([app, str(n), str(reps)], stderr=subprocess.STDOUT)
+    allTimes.append(time.perf_counter() - start)
+    subprocess.run('rm -rf .fpc_logs', shell=True)
+  return sum(allTimes) / times
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser(description='Overhead of per-TU and LTO-time instrumentation')
+  parser.add_argument('-n', type=int, default=100000, help='Elements (default: 100000).')
+  parser.add_argument('-r', '--reps', type=int, default=1000, help='Repetitions (default: 1000).')
+  parser.add_argument('-t', '--times', type=int, default=5, help='Runs of each variant (default: 5).')
+  args = parser.parse_args()
+
+  os.chdir(os.path.dirname(os.path.abspath(__file__)))
+  build()
+  # warm up
+  for (name, app) in VARIANTS:
+    runCode(app, args.n, 1, 1)
+
+  base = None
+  print('{:<10}{:>12}{:>12}'.format('Variant', 'Seconds', 'Overhead'))
+  for (name, app) in VARIANTS:
+    t = runCode(app, args.n, args.reps, args.times)
+    if base is None:
+      base = t
+    print('{:<10}{:>12.3f}{:>11.1f}x'.format(name, t, t / base))
@@ -0,0 +1,5 @@
+#include "compute.h"
+
+double ratio(double a, double b) {
+  return a / (b - 1.0); // b is 1.0 in main.cpp
+}
@@ -0,0 +1,3 @@
+
+double ratio(double a, double b);
+
@@ -0,0 +1,23 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "compute.h"
+
+// ./main [n] [repetitions] (benchmark.py uses larger inputs)
+int main(int argc, char **argv)
+{
+  int n = (argc > 1) ? atoi(argv[1]) : 8;
+  int reps = (argc > 2) ? atoi(argv[2]) : 1;
+  int nbytes = n*sizeof(double); 
+  double *data = (double *)malloc(nbytes);
+  for (int i=0; i < n; ++i)
+    data[i] = (double)(i+1);
+  printf("Calling kernel\n");
+  double result = 0.0;
+  for (int r=0; r < reps; ++r)
+    for (int i=0; i < n; ++i)
+      result += ratio(data[i], data[0]);
+  printf("Result: %f\n", result);
+
+  return 0;
+}
@@ -0,0 +1,12 @@
+#include <stdio.h>
+#include <math.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    double l = log(x[i] - 5.0);  // nan for x < 5, -inf for x == 5
+    double s = sqrt(x[i] - 6.0); // nan for x < 6
+    res = res + l + s;
+  }
+  return res;
+}
@@ -0,0 +1,54 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["rm -rf .fpc_logs && ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+
+    functions = {}
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if not data[i]['file'].endswith('compute.cpp'):
+        continue
+      if 'function' in data[i]:
+        functions[data[i]['line']] = data[i]['function']
+      if data[i]['line'] == 7 and data[i].get('function') == 'log':
+        assert data[i]['nan'] == 4
+        assert data[i]['infinity_neg'] == 1
+      if data[i]['line'] == 8 and data[i].get('function') == 'sqrt':
+        assert data[i]['nan'] == 5
+
+    assert functions.get(7) == 'log'
+    assert functions.get(8) == 'sqrt'
+
+    # --- the function is shown with the location ---
+    cmd = ["fpc-create-report -s nan"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    assert 'compute.cpp:7 (log)' in cmdOutput.decode('utf-8')
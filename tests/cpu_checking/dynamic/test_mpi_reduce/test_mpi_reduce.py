@@ -0,0 +1,49 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+import sys
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["FPC_MPI_REDUCE=1 mpirun -H localhost -np 8 --oversubscribe -x FPC_MPI_REDUCE ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # A single trace is written by rank 0
+    assert report.numberReportFiles('.fpc_logs') == 1
+
+    found = False
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp'):
+        if data[i]['line'] == 10:
+          assert data[i]['nan'] == 36
+          assert data[i]['min']['nan'] == 1
+          assert data[i]['max']['nan'] == 8
+          assert data[i]['ranks'] == '0-7'
+          found = True
+
+    assert found
@@ -0,0 +1,8 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i)
+    res += x[i] / (x[i] - (double)(i+1)); // x[i] is i+1 in main.cpp
+  return res;
+}
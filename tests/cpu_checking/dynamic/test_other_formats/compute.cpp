@@ -0,0 +1,12 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    _Float16 h = (_Float16)(x[i] * 10000.0); // overflows half for x >= 7
+    long double l = (long double)x[i] * 1e4900L; // close to the largest x87 long double
+    if (h > (_Float16)1.0 && l > 1.0L)
+      res += 1.0;
+  }
+  return res;
+}
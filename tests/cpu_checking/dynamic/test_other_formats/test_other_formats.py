@@ -0,0 +1,51 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["rm -rf .fpc_logs && ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+
+    found = 0
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp'):
+        if data[i]['line'] == 6:
+          # 70000 and 80000 are larger than 65504
+          assert data[i]['infinity_pos'] == 2
+          assert data[i]['conversion']['from'] == 'fp64'
+          assert data[i]['conversion']['to'] == 'fp16'
+          assert data[i]['conversion']['overflows'] == 2
+          found += 1
+        if data[i]['line'] == 7:
+          # Latent zone of x86_fp80: 5% of the 32768 exponents
+          assert data[i]['latent_infinity_pos'] == 8
+          assert data[i]['infinity_pos'] == 0
+          found += 1
+    assert found == 2
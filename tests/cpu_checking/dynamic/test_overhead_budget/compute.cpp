@@ -0,0 +1,17 @@
+
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    res = res + x[i % 8];
+
+    // NaN (hot site)
+    res = (res-res) / (res-res);
+  }
+
+  // Division by zero (cold site)
+  double inf = x[0] / 0.0;
+  return res + inf;
+}
+
@@ -0,0 +1,49 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+import sys
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["FPC_OVERHEAD_BUDGET=1% ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    assert 'Overhead budget: 1.0%, estimated overhead' in cmdOutput.decode('utf-8')
+
+    hot_nan = 0
+    cold_div_zero = 0
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp'):
+        if data[i]['line'] == 10:
+          hot_nan = data[i]['nan']
+        if data[i]['line'] == 14:
+          cold_div_zero = data[i]['division_zero']
+
+    # The hot site is sampled, the cold site is always checked
+    assert hot_nan > 0 and hot_nan < 1000000
+    assert cold_div_zero == 1
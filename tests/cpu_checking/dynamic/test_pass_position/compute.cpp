@@ -0,0 +1,10 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    double d = x[i] / (x[i] - (double)(i+1)); // x[i] is i+1 in main.cpp
+    res = d;
+  }
+  return res;
+}
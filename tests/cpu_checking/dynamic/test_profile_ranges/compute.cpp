@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    res = res + x[i];
+
+    // Out of the FP32 range
+    double tiny = x[i] * 1e-200;
+    res = res + tiny;
+  }
+  return res;
+}
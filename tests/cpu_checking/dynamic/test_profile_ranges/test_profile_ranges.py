@@ -0,0 +1,58 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["rm -rf .fpc_logs && FPC_PROFILE_RANGES=1 ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+
+    found = 0
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp') and data[i]['line'] == 6:
+        r = data[i]['ranges']
+        assert r['bits'] == 64
+        assert r['result_exp'][0] >= 0 and r['result_exp'][1] <= 6
+        assert sum(r['histogram']) == 8
+        found += 1
+      if data[i]['file'].endswith('compute.cpp') and data[i]['line'] == 9:
+        assert data[i]['ranges']['result_exp'][1] < -600
+        found += 1
+    assert found == 2
+
+    # --- sites that fit in FP32 ---
+    cmd = ["fpc-create-report -p"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    lines = cmdOutput.decode('utf-8').split('\n')
+    print(lines)
+    for l in lines:
+      if 'compute.cpp:6 ' in l:
+        assert 'fits: FP32,BF16' in l
+      if 'compute.cpp:9 ' in l:
+        assert 'fits: -' in l
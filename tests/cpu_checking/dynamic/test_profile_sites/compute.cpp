@@ -0,0 +1,14 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    // No event (profiled site)
+    res = res + x[i % 8] * 0.5;
+  }
+
+  // Division by zero
+  double inf = x[0] / 0.0;
+  return res + inf;
+}
+
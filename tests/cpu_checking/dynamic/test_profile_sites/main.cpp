@@ -0,0 +1,18 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "compute.h"
+
+int main(int argc, char **argv)
+{
+  int n = 1000;
+  int nbytes = 8*sizeof(double); 
+  double *data = (double *)malloc(nbytes);
+  for (int i=0; i < 8; ++i)
+    data[i] = (double)(i+1);
+  printf("Calling kernel\n");
+  double result = compute(data, n);
+  printf("Result: %f\n", result);
+
+  return 0;
+}
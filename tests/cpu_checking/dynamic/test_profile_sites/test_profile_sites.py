@@ -0,0 +1,55 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+import sys
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["FPC_PROFILE_SITES=1 ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    executions = 0
+    cycles = 0
+    div_zero = 0
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if data[i]['file'].endswith('compute.cpp'):
+        if data[i]['line'] == 7:
+          executions += data[i]['executions']
+          cycles += data[i]['cycles']
+        if data[i]['line'] == 11:
+          div_zero = data[i]['division_zero']
+
+    # Sites without events are reported when profiling
+    assert executions >= 1000
+    assert cycles > 0
+    assert div_zero == 1
+
+    # --- create report ---
+    cmd = ["fpc-create-report -s"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    assert 'Top Overhead Sites' in cmdOutput.decode('utf-8')
@@ -0,0 +1,11 @@
+#include <stdio.h>
+
+double compute(double *x, int n) {
+  double res = 0.0;
+  for (int i=0; i < n; ++i) {
+    double big = x[i] + 1e16;
+    double small = big - 1e16; // x[i] is lost when it is odd
+    res = res + small;
+  }
+  return res;
+}
@@ -0,0 +1,57 @@
+#!/usr/bin/env python
+
+import subprocess
+import os
+from dynamic import report
+
+def setup_module(module):
+    THIS_DIR = os.path.dirname(os.path.abspath(__file__))
+    os.chdir(THIS_DIR)
+
+def teardown_module(module):
+    cmd = ["make clean"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+
+def test_1():
+    # --- compile code: compute() is shadowed in quad precision ---
+    cmd = ["make"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    # --- run code ---
+    cmd = ["rm -rf .fpc_logs && ./main"]
+    try:
+        cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    except subprocess.CalledProcessError as e:
+        print(e.output)
+        exit()
+
+    fileName = report.findReportFile('.fpc_logs')
+    data = report.loadReport(fileName)
+
+    lines = set()
+    for i in range(len(data)):
+      print('i', i, data[i])
+      if not data[i]['file'].endswith('compute.cpp') or 'shadow' not in data[i]:
+        continue
+      sh = data[i]['shadow']
+      assert sh['bits'] == 53
+      assert sh['executions'] == 8
+      if data[i]['line'] == 6:
+        # Only rounded
+        assert sh['max_error_bits'] <= 1
+        assert sh['inaccurate'] == 0
+      if data[i]['line'] == 7:
+        # The shadow of big keeps x[i]: all the bits of the result are wrong
+        assert sh['max_error_bits'] >= 50
+        assert sh['cancellations'] >= 4
+      lines.add(data[i]['line'])
+    assert 6 in lines and 7 in lines
+
+    # --- the sites are ranked in the precision report ---
+    cmd = ["fpc-create-report -p"]
+    cmdOutput = subprocess.check_output(cmd, stderr=subprocess.STDOUT, shell=True)
+    assert 'Shadow Errors' in cmdOutput.decode('utf-8')